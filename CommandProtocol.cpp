@@ -0,0 +1,246 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "CommandProtocol.h"
+
+/*** Macro ***/
+#define TIME_NEVER  (1.0e12)
+
+/*** Function ***/
+CommandProtocol::CommandProtocol()
+	: m_isPendingUrgent(false)
+	, m_pendingTime(0)
+	, m_lastFrameTime(-TIME_NEVER)
+	, m_lastFeedTime(-TIME_NEVER)
+{
+	m_lastSentTimeList.fill(-TIME_NEVER);
+}
+
+void CommandProtocol::initialize(const PARAM& param)
+{
+	m_param = param;
+	m_statistics = STATISTICS();
+	m_pendingCommand.clear();
+	m_isPendingUrgent = false;
+	m_currentCommand.clear();
+	m_lastSentTimeList.fill(-TIME_NEVER);
+	m_lastFrameTime = -TIME_NEVER;
+	m_lastFeedTime = -TIME_NEVER;
+	m_inFlightList.clear();
+	m_recvBuffer.clear();
+}
+
+int32_t CommandProtocol::getClass(const std::string& command)
+{
+	if (command.compare(0, 3, "kwk") == 0 || command.compare(0, 3, "kcr") == 0 || command.compare(0, 3, "kbk") == 0) {
+		return CLASS_MOTION;
+	}
+	if (!command.empty() && command[0] == 'k') {
+		return CLASS_POSTURE;
+	}
+	return CLASS_SYSTEM;
+}
+
+std::string CommandProtocol::encode(const std::string& command)
+{
+	std::string frame = command;
+	while (!frame.empty() && (frame.back() == '\n' || frame.back() == '\r')) frame.pop_back();
+	frame.push_back('\n');
+	return frame;
+}
+
+int32_t CommandProtocol::request(const std::string& command, double now, bool isUrgent)
+{
+	if (command.empty()) return RET_ERR;
+	m_statistics.numRequested++;
+
+	if (command == m_pendingCommand) {
+		m_statistics.numDuplicated++;
+		if (isUrgent && !m_isPendingUrgent) {
+			m_isPendingUrgent = true;
+			m_pendingTime = now;
+		}
+	} else if (m_isPendingUrgent && !isUrgent) {
+		/* an urgent command is not replaced (or cancelled) by a normal one before it's sent */
+		m_statistics.numCoalesced++;
+	} else if (command == m_currentCommand) {
+		/* the robot is already in this state. a pending command is no longer needed */
+		if (!m_pendingCommand.empty()) {
+			m_pendingCommand.clear();
+			m_isPendingUrgent = false;
+			m_statistics.numCoalesced++;
+		} else {
+			m_statistics.numDuplicated++;
+		}
+	} else {
+		if (!m_pendingCommand.empty()) m_statistics.numCoalesced++;
+		m_pendingCommand = command;
+		m_isPendingUrgent = isUrgent;
+		m_pendingTime = now;
+	}
+	return RET_OK;
+}
+
+void CommandProtocol::feedWatchdog(double now)
+{
+	m_lastFeedTime = now;
+}
+
+bool CommandProtocol::isWatchdogExpired(double now) const
+{
+	/* note: the watchdog starts after the first feed, so that the robot is not stopped while starting up */
+	return m_param.watchdogTimeout > 0 && m_lastFeedTime > -TIME_NEVER && now - m_lastFeedTime > m_param.watchdogTimeout;
+}
+
+double CommandProtocol::getDueTime(double now) const
+{
+	double dueTime = TIME_NEVER;
+	const bool isExpired = isWatchdogExpired(now);
+	if (m_param.watchdogTimeout > 0 && m_lastFeedTime > -TIME_NEVER && m_currentCommand != m_param.watchdogCommand) {
+		dueTime = (std::min)(dueTime, m_lastFeedTime + m_param.watchdogTimeout);
+	}
+	if (m_isPendingUrgent) {
+		return now;
+	} else if (!m_pendingCommand.empty()) {
+		if (!isExpired) {
+			const int32_t commandClass = getClass(m_pendingCommand);
+			dueTime = (std::min)(dueTime, m_lastSentTimeList[commandClass] + m_param.minInterval[commandClass]);
+		}
+	} else if (m_param.heartbeatInterval > 0 && !m_currentCommand.empty()) {
+		/* heartbeat is merged into the other frames. it's sent only when the line is idle */
+		dueTime = (std::min)(dueTime, m_lastFrameTime + m_param.heartbeatInterval);
+	}
+	return dueTime;
+}
+
+double CommandProtocol::getWaitTime(double now) const
+{
+	return (std::max)(0.0, getDueTime(now) - now);
+}
+
+bool CommandProtocol::getFrame(double now, std::string& frame)
+{
+	expire(now);
+
+	/* Watchdog: stop now, and hold the other commands until a valid pose is fed */
+	if (isWatchdogExpired(now) && m_currentCommand != m_param.watchdogCommand && !m_isPendingUrgent) {
+		if (!m_pendingCommand.empty()) m_statistics.numCoalesced++;
+		m_pendingCommand = m_param.watchdogCommand;
+		m_isPendingUrgent = true;
+		m_pendingTime = now;
+		m_statistics.numWatchdog++;
+	}
+
+	if (now < getDueTime(now)) return false;
+
+	bool isUrgent = false;
+	if (!m_pendingCommand.empty()) {
+		frame = encode(m_pendingCommand);
+		m_lastSentTimeList[getClass(m_pendingCommand)] = now;
+		m_currentCommand = m_pendingCommand;
+		m_pendingCommand.clear();
+		if (m_isPendingUrgent) {
+			isUrgent = true;
+			const double latency = now - m_pendingTime;
+			m_statistics.numUrgent++;
+			m_statistics.sumUrgentLatency += latency;
+			m_statistics.maxUrgentLatency = (std::max)(m_statistics.maxUrgentLatency, latency);
+			m_isPendingUrgent = false;
+		}
+	} else if (!m_currentCommand.empty()) {
+		frame = encode(m_currentCommand);
+		m_statistics.numHeartbeat++;
+	} else {
+		return false;
+	}
+	record(frame, now, isUrgent);
+	return true;
+}
+
+void CommandProtocol::record(const std::string& frame, double now, bool isUrgent)
+{
+	m_statistics.numSent++;
+	m_statistics.numBytes += frame.size();
+	m_lastFrameTime = now;
+	IN_FLIGHT inFlight = { frame[0], now, isUrgent };
+	m_inFlightList.push_back(inFlight);
+	if (m_inFlightList.size() > MAX_IN_FLIGHT) {
+		m_inFlightList.pop_front();
+		m_statistics.numTimeout++;
+	}
+}
+
+void CommandProtocol::expire(double now)
+{
+	while (!m_inFlightList.empty() && now - m_inFlightList.front().time > m_param.ackTimeout) {
+		m_inFlightList.pop_front();
+		m_statistics.numTimeout++;
+	}
+}
+
+int32_t CommandProtocol::parse(const char* data, int32_t length, double now, std::vector<RESPONSE>& responseList)
+{
+	expire(now);
+	m_recvBuffer.append(data, length);
+	size_t pos;
+	while ((pos = m_recvBuffer.find('\n')) != std::string::npos || m_recvBuffer.size() > MAX_LINE_LENGTH) {
+		/* a too long line is split. don't drop the byte after it, which is data, not a newline */
+		const bool isNewLine = (pos != std::string::npos);
+		if (!isNewLine) pos = MAX_LINE_LENGTH;
+		RESPONSE response;
+		response.text = m_recvBuffer.substr(0, pos);
+		m_recvBuffer.erase(0, isNewLine ? pos + 1 : pos);
+		while (!response.text.empty() && response.text.back() == '\r') response.text.pop_back();
+		if (response.text.empty()) continue;
+
+		if (!m_inFlightList.empty() && response.text.size() == 1 && response.text[0] == m_inFlightList.front().token) {
+			const IN_FLIGHT& inFlight = m_inFlightList.front();
+			response.isAck = true;
+			response.latency = now - inFlight.time;
+			m_statistics.numAcked++;
+			m_statistics.sumAckLatency += response.latency;
+			m_statistics.maxAckLatency = (std::max)(m_statistics.maxAckLatency, response.latency);
+			if (inFlight.isUrgent) {
+				m_statistics.numUrgentAcked++;
+				m_statistics.sumUrgentAckLatency += response.latency;
+				m_statistics.maxUrgentAckLatency = (std::max)(m_statistics.maxUrgentAckLatency, response.latency);
+			}
+			m_inFlightList.pop_front();
+		}
+		responseList.push_back(response);
+	}
+	return RET_OK;
+}
+
+void CommandProtocol::printStatistics() const
+{
+	const STATISTICS& s = m_statistics;
+	printf("=== Command Protocol ===\n");
+	printf("requested = %d, duplicated = %d, coalesced = %d\n", s.numRequested, s.numDuplicated, s.numCoalesced);
+	printf("sent = %d (heartbeat = %d), %lld [bytes]\n", s.numSent, s.numHeartbeat, static_cast<long long>(s.numBytes));
+	printf("acked = %d, timeout = %d, ack latency = %.1f (max %.1f) [msec]\n", s.numAcked, s.numTimeout, (s.numAcked > 0) ? s.sumAckLatency / s.numAcked : 0.0, s.maxAckLatency);
+	printf("stop = %d (watchdog = %d), request to send = %.1f (max %.1f) [msec], ack latency = %.1f (max %.1f) [msec]\n",
+		s.numUrgent, s.numWatchdog, (s.numUrgent > 0) ? s.sumUrgentLatency / s.numUrgent : 0.0, s.maxUrgentLatency,
+		(s.numUrgentAcked > 0) ? s.sumUrgentAckLatency / s.numUrgentAcked : 0.0, s.maxUrgentAckLatency);
+}
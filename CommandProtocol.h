@@ -0,0 +1,159 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef COMMAND_PROTOCOL_
+#define COMMAND_PROTOCOL_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+
+/* Protocol layer between CommandDecider and Uart (OpenCat serial commands) */
+/* - a command is framed as "token + arguments + \n" (e.g. "kwkF\n") */
+/* - commands describe the state of the robot, so only the latest requested one is kept. a duplicated request is dropped */
+/* - commands are rate limited per class. a command requested within the interval is held and sent when the interval elapses */
+/* - the current command is re-sent as a heartbeat when nothing is sent for a while */
+/* - an urgent command (stop) preempts the held command and is sent without waiting for the interval */
+/* - watchdog: stop is sent if no valid pose is fed for a while. the other commands are held until a valid pose is fed */
+/* - OpenCat prints the token after it processes a command. the responses are parsed to measure ack latency */
+/* note: this class is not thread safe. all the functions are called from the uart thread. time is given in [msec] */
+class CommandProtocol {
+public:
+	static constexpr int32_t MAX_IN_FLIGHT = 16;
+	static constexpr int32_t MAX_LINE_LENGTH = 256;
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	enum {
+		CLASS_MOTION = 0,	// gait (kwk*, kcr*, kbk*). changed often while following
+		CLASS_POSTURE,		// posture and skill (kbalance, ksit, khi, ...). takes time on the robot
+		CLASS_SYSTEM,		// others (d = rest, g = gyro, ...)
+		CLASS_NUM,
+	};
+
+	typedef struct PARAM_ {
+		std::array<double, CLASS_NUM> minInterval;	// [msec] minimum interval from the previous command of the same class
+		double heartbeatInterval;					// [msec] re-send the current command when idle for this time (0 = disabled)
+		double ackTimeout;							// [msec] give up waiting for the response
+		double watchdogTimeout;						// [msec] send watchdogCommand if feedWatchdog() is not called for this time (0 = disabled)
+		std::string watchdogCommand;
+		PARAM_()
+			: minInterval{ { 200.0, 500.0, 0.0 } }
+			, heartbeatInterval(2000.0)
+			, ackTimeout(1000.0)
+			, watchdogTimeout(0.0)
+			, watchdogCommand("kbalance")
+		{}
+	} PARAM;
+
+	typedef struct RESPONSE_ {
+		std::string text;		// a line without newline
+		bool        isAck;		// the token of the oldest command in flight
+		double      latency;	// [msec] from sending the command (ack only)
+		RESPONSE_()
+			: isAck(false)
+			, latency(0)
+		{}
+	} RESPONSE;
+
+	typedef struct STATISTICS_ {
+		int32_t numRequested;
+		int32_t numDuplicated;	// the same as the current command
+		int32_t numCoalesced;	// replaced by a newer request before it was sent
+		int32_t numSent;		// including heartbeat
+		int32_t numHeartbeat;
+		int32_t numAcked;
+		int32_t numTimeout;
+		int64_t numBytes;
+		double  sumAckLatency;
+		double  maxAckLatency;
+		/* urgent commands (stop) are measured separately */
+		int32_t numUrgent;			// including watchdog
+		int32_t numWatchdog;
+		double  sumUrgentLatency;	// [msec] from request to send
+		double  maxUrgentLatency;
+		int32_t numUrgentAcked;
+		double  sumUrgentAckLatency;	// [msec] from send to ack
+		double  maxUrgentAckLatency;
+		STATISTICS_()
+			: numRequested(0)
+			, numDuplicated(0)
+			, numCoalesced(0)
+			, numSent(0)
+			, numHeartbeat(0)
+			, numAcked(0)
+			, numTimeout(0)
+			, numBytes(0)
+			, sumAckLatency(0)
+			, maxAckLatency(0)
+			, numUrgent(0)
+			, numWatchdog(0)
+			, sumUrgentLatency(0)
+			, maxUrgentLatency(0)
+			, numUrgentAcked(0)
+			, sumUrgentAckLatency(0)
+			, maxUrgentAckLatency(0)
+		{}
+	} STATISTICS;
+
+public:
+	CommandProtocol();
+	~CommandProtocol() {}
+	void    initialize(const PARAM& param);
+	int32_t request(const std::string& command, double now, bool isUrgent = false);
+	void    feedWatchdog(double now);
+	void    setWatchdogTimeout(double timeout) { m_param.watchdogTimeout = timeout; }
+	bool    getFrame(double now, std::string& frame);
+	double  getWaitTime(double now) const;
+	int32_t parse(const char* data, int32_t length, double now, std::vector<RESPONSE>& responseList);
+	const STATISTICS& getStatistics() const { return m_statistics; }
+	void    printStatistics() const;
+
+	static int32_t getClass(const std::string& command);
+	static std::string encode(const std::string& command);
+
+private:
+	typedef struct {
+		char   token;
+		double time;	// [msec] sent
+		bool   isUrgent;
+	} IN_FLIGHT;
+
+	double getDueTime(double now) const;
+	bool   isWatchdogExpired(double now) const;
+	void   record(const std::string& frame, double now, bool isUrgent);
+	void   expire(double now);
+
+private:
+	PARAM       m_param;
+	STATISTICS  m_statistics;
+	std::string m_pendingCommand;	// waiting for the interval. empty if none
+	bool        m_isPendingUrgent;
+	double      m_pendingTime;		// [msec] requested
+	std::string m_currentCommand;	// the last command sent
+	std::array<double, CLASS_NUM> m_lastSentTimeList;
+	double      m_lastFrameTime;	// [msec] the last time any frame is sent
+	double      m_lastFeedTime;		// [msec] the last time a valid pose is fed
+	std::deque<IN_FLIGHT> m_inFlightList;
+	std::string m_recvBuffer;
+};
+
+#endif
@@ -35,20 +35,60 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/* priority of each status. stop (including crunch-to-stop) is decided with a short window */
+const std::array<int32_t, CommandDecider::STATUS_NUM> CommandDecider::STATUS_PRIORITY_LIST = { {
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_NONE
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_MOVING_FORWARD
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_MOVING_BACKWARD
+    CommandDecider::PRIORITY_SAFETY,    // STATUS_MOVING_STOP
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_MOVING_LEFT
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_MOVING_RIGHT
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_ACTION_SIT
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_ACTION_HI
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_MOVING_COME
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_FOLLOW_KEEP
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_FOLLOW_BACKWARD
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_ACTION_STRETCH
+    CommandDecider::PRIORITY_NORMAL,    // STATUS_ACTION_PUSHUP
+} };
 
 /*** Function ***/
-std::string CommandDecider::decide(PoseAnalyzer::RESULT& poseResult)
+void CommandDecider::setTargetDistance(float distance, float margin)
 {
+    m_targetDistance = distance;
+    m_distanceMargin = margin;
+    SteeringController::PARAM param = m_steeringController.getParam();
+    param.targetDistance = distance;
+    m_steeringController.setParam(param);
+}
+
+int32_t CommandDecider::getFilteringNum(int32_t status) const
+{
+    return (STATUS_PRIORITY_LIST[status] == PRIORITY_SAFETY) ? m_config.stopFilteringNum : m_config.commandFilteringNum;
+}
+
+void CommandDecider::printStopStatistics() const
+{
+    const STOP_STATISTICS& s = m_stopStatistics;
+    if (s.numStop == 0) return;
+    PRINT("Stop reaction: %d times, %.1f (max %.1f) [msec], %.1f [frame]\n", s.numStop, s.sumReactionTime / s.numStop, s.maxReactionTime, static_cast<double>(s.sumReactionFrame) / s.numStop);
+}
+
+std::string CommandDecider::decide(PoseAnalyzer::RESULT& poseResult, const GestureRecognizer::RESULT& gestureResult)
+{
+    /* use the same config during the frame */
+    m_config = Config::get();
+
     /*** Decide a status candidate using the curent pose ***/
     int32_t status = m_status;
     switch (m_status) {
     default:
     case STATUS_NONE:
     case STATUS_MOVING_FORWARD:
-        if (poseResult.faceScore > 0.3) {
+        if (poseResult.faceScore > m_config.faceScoreThreshold) {
             status = STATUS_MOVING_FORWARD;
         }
-        if (poseResult.faceScore <= 0.3) {
+        if (poseResult.faceScore <= m_config.faceScoreThreshold) {
             status = STATUS_NONE;
         } 
         if (poseResult.x > 0.5) {
@@ -109,28 +149,128 @@ std::string CommandDecider::decide(PoseAnalyzer::RESULT& poseResult)
             }
         }
         break;
+    case STATUS_MOVING_COME:
+        status = STATUS_NONE;   // keep moving only while the gesture continues
+        break;
+    }
+
+    /*** In continuous mode, turning is done by SteeringController while following ***/
+    if (m_mode == MODE_CONTINUOUS && (status == STATUS_MOVING_LEFT || status == STATUS_MOVING_RIGHT)) {
+        status = STATUS_MOVING_FORWARD;
+    }
+
+    /*** In follow-distance mode, move forward / backward to keep the distance while following ***/
+    if (m_mode == MODE_FOLLOW_DISTANCE && poseResult.distance > 0
+        && (status == STATUS_MOVING_FORWARD || status == STATUS_FOLLOW_KEEP || status == STATUS_FOLLOW_BACKWARD)) {
+        switch (m_status) {
+        case STATUS_MOVING_FORWARD:
+            status = (poseResult.distance < m_targetDistance) ? STATUS_FOLLOW_KEEP : STATUS_MOVING_FORWARD;
+            break;
+        case STATUS_FOLLOW_BACKWARD:
+            status = (poseResult.distance > m_targetDistance) ? STATUS_FOLLOW_KEEP : STATUS_FOLLOW_BACKWARD;
+            break;
+        default:
+            status = STATUS_FOLLOW_KEEP;
+            if (poseResult.distance > m_targetDistance + m_distanceMargin) status = STATUS_MOVING_FORWARD;
+            if (poseResult.distance < m_targetDistance - m_distanceMargin) status = STATUS_FOLLOW_BACKWARD;
+            break;
+        }
+    }
+
+    /*** Motion gesture overrides status decided by static pose (but doesn't override safety status) ***/
+    /* note: waving hand looks like raised arm, and sweeping hand looks like spread arm */
+    if (STATUS_PRIORITY_LIST[status] != PRIORITY_SAFETY) {
+        switch (gestureResult.gesture) {
+        case GestureRecognizer::GESTURE_WAVE:
+            status = STATUS_ACTION_HI;
+            break;
+        case GestureRecognizer::GESTURE_BECKON:
+            status = STATUS_MOVING_COME;
+            break;
+        case GestureRecognizer::GESTURE_SWEEP_LEFT:
+            status = STATUS_MOVING_LEFT;
+            break;
+        case GestureRecognizer::GESTURE_SWEEP_RIGHT:
+            status = STATUS_MOVING_RIGHT;
+            break;
+        case GestureRecognizer::GESTURE_NONE:
+        default:
+            break;
+        }
+    }
+
+    /*** Finger count of the raised right hand (HandEngine, optional) ***/
+    /* note: the left hand is not used because raising it means moving backward */
+    switch (poseResult.fingerCountRight) {
+    case 0:     /* fist */
+        status = STATUS_MOVING_STOP;
+        break;
+    case 2:
+        if (STATUS_PRIORITY_LIST[status] != PRIORITY_SAFETY) status = STATUS_ACTION_STRETCH;
+        break;
+    case 3:
+        if (STATUS_PRIORITY_LIST[status] != PRIORITY_SAFETY) status = STATUS_ACTION_PUSHUP;
+        break;
+    default:
+        break;
     }
-    if (poseResult.faceScore < 0.3) {
+
+    /*** Attention gate: accept commands only while the person faces the robot ***/
+    /* note: face score is high even if the person looks aside */
+    if (poseResult.faceScore < m_config.faceScoreThreshold || !poseResult.isAttending) {
         status = STATUS_NONE;
     }
 
-    /*** Filter status ***/
+    /*** Filter status. the window size depends on the priority of the status ***/
+    const size_t historySize = static_cast<size_t>((std::max)(m_config.commandFilteringNum, m_config.stopFilteringNum));
     m_statusHistory.push_back(status);
-    if (m_statusHistory.size() > NUM_FILTERING) {
+    while (m_statusHistory.size() > historySize) {
         m_statusHistory.pop_front();
     }
 
-    bool isStatusStable = true;
-    for (const auto& h : m_statusHistory) {
-        if (status != h) {
+    const int32_t filteringNum = getFilteringNum(status);
+    bool isStatusStable = (m_statusHistory.size() >= static_cast<size_t>(filteringNum));
+    for (auto it = m_statusHistory.rbegin(); isStatusStable && it != m_statusHistory.rbegin() + filteringNum; ++it) {
+        if (status != *it) {
             isStatusStable = false;
-            break;
+        }
+    }
+
+    /*** Measure reaction time of stop ***/
+    if (STATUS_PRIORITY_LIST[status] == PRIORITY_SAFETY) {
+        if (m_stopCandidateTime < 0) {
+            m_stopCandidateTime = poseResult.timestamp;
+            m_stopCandidateFrame = 0;
+        }
+        m_stopCandidateFrame++;
+        if (isStatusStable && m_status != status) {
+            const double reactionTime = poseResult.timestamp - m_stopCandidateTime;
+            m_stopStatistics.numStop++;
+            m_stopStatistics.sumReactionTime += reactionTime;
+            m_stopStatistics.maxReactionTime = (std::max)(m_stopStatistics.maxReactionTime, reactionTime);
+            m_stopStatistics.sumReactionFrame += m_stopCandidateFrame;
+        }
+    } else {
+        m_stopCandidateTime = -1;
+    }
+
+    /*** Update control values every frame so that they are ready when following starts ***/
+    bool isFollowing = (m_mode == MODE_CONTINUOUS) && (m_status == STATUS_MOVING_FORWARD);
+    if (m_mode == MODE_CONTINUOUS) {
+        if (isFollowing || status == STATUS_MOVING_FORWARD) {
+            (void)m_steeringController.update(poseResult);
+        } else {
+            m_steeringController.reset();
         }
     }
 
     /*** Send command if the status stable and the status changed ***/
     if (isStatusStable /* && (m_status != status) */) {
         m_status = status;
+        m_priority = STATUS_PRIORITY_LIST[m_status];
+        if (m_mode == MODE_CONTINUOUS && m_status == STATUS_MOVING_FORWARD) {
+            return m_steeringController.getCommand();
+        }
 
         std::string cmd = "";
         switch (m_status) {
@@ -159,6 +299,21 @@ std::string CommandDecider::decide(PoseAnalyzer::RESULT& poseResult)
         case STATUS_ACTION_HI:
             cmd = "khi";
             break;
+        case STATUS_MOVING_COME:
+            cmd = "kwkF";
+            break;
+        case STATUS_FOLLOW_KEEP:
+            cmd = "kbalance";
+            break;
+        case STATUS_FOLLOW_BACKWARD:
+            cmd = "kbk";
+            break;
+        case STATUS_ACTION_STRETCH:
+            cmd = "kstr";
+            break;
+        case STATUS_ACTION_PUSHUP:
+            cmd = "kpu";
+            break;
         }
         //printf("%s\n", cmd.c_str());
         return cmd;
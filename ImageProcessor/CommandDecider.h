@@ -24,13 +24,40 @@ limitations under the License.
 #include <array>
 #include <memory>
 
+#include "Config.h"
 #include "PoseAnalyzer.h"
+#include "GestureRecognizer.h"
+#include "SteeringController.h"
 
 class CommandDecider {
 
-private:
-	static constexpr int32_t NUM_FILTERING = 10;
+public:
+	enum {
+		MODE_DISCRETE = 0,	// walk toward the person using discrete turn / forward status
+		MODE_CONTINUOUS,	// follow the person using SteeringController
+		MODE_FOLLOW_DISTANCE,	// MODE_DISCRETE + move forward / backward to keep the distance to the person
+	};
+
+	enum {
+		PRIORITY_NORMAL = 0,	// filtered by commandFilteringNum, and rate limited by CommandProtocol
+		PRIORITY_SAFETY,		// stop. filtered by stopFilteringNum (short), and sent without waiting
+	};
+
+	/* Reaction time of stop: from the first frame of stop pose to the frame stop command is decided */
+	typedef struct STOP_STATISTICS_ {
+		int32_t numStop;
+		double  sumReactionTime;	// [msec]
+		double  maxReactionTime;	// [msec]
+		int32_t sumReactionFrame;	// [frame]
+		STOP_STATISTICS_()
+			: numStop(0)
+			, sumReactionTime(0)
+			, maxReactionTime(0)
+			, sumReactionFrame(0)
+		{}
+	} STOP_STATISTICS;
 
+private:
 	enum {
 		STATUS_NONE = 0,
 		STATUS_MOVING_FORWARD,
@@ -40,19 +67,51 @@ private:
 		STATUS_MOVING_RIGHT,
 		STATUS_ACTION_SIT,
 		STATUS_ACTION_HI,
+		STATUS_MOVING_COME,
+		STATUS_FOLLOW_KEEP,
+		STATUS_FOLLOW_BACKWARD,
+		STATUS_ACTION_STRETCH,
+		STATUS_ACTION_PUSHUP,
+		STATUS_NUM,
 	};
 
 public:
 	CommandDecider() 
 		: m_status(STATUS_NONE)
+		, m_mode(MODE_DISCRETE)
+		, m_targetDistance(1.5f)
+		, m_distanceMargin(0.3f)
+		, m_priority(PRIORITY_NORMAL)
+		, m_stopCandidateTime(-1)
+		, m_stopCandidateFrame(0)
 	{}
 	~CommandDecider() {}
+
+	void setMode(int32_t mode) { m_mode = mode; }
+	void setTargetDistance(float distance, float margin);
+	SteeringController& getSteeringController() { return m_steeringController; }
 	
-	std::string decide(PoseAnalyzer::RESULT& poseResult);
+	std::string decide(PoseAnalyzer::RESULT& poseResult, const GestureRecognizer::RESULT& gestureResult = GestureRecognizer::RESULT());
+	int32_t getPriority() const { return m_priority; }	// priority of the command returned by the last decide()
+	const STOP_STATISTICS& getStopStatistics() const { return m_stopStatistics; }
+	void printStopStatistics() const;
+
+private:
+	static const std::array<int32_t, STATUS_NUM> STATUS_PRIORITY_LIST;
+	int32_t getFilteringNum(int32_t status) const;
 
 private:
+	CONFIG  m_config;	// snapshot of Config for the current frame
 	int32_t m_status;
 	std::deque<int32_t> m_statusHistory;
+	int32_t m_mode;
+	float   m_targetDistance;	// [m]
+	float   m_distanceMargin;	// [m]
+	SteeringController m_steeringController;
+	int32_t m_priority;
+	double  m_stopCandidateTime;	// [msec] the first frame of the current stop pose. -1 if not in stop pose
+	int32_t m_stopCandidateFrame;
+	STOP_STATISTICS m_stopStatistics;
 };
 
 #endif
@@ -0,0 +1,252 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/* for inotify */
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "Config.h"
+
+/*** Macro ***/
+#define TAG "Config"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+static const std::vector<std::pair<const char*, float CONFIG::*>> FLOAT_PARAM_LIST = {
+	{ "thresholdScore", &CONFIG::thresholdScore },
+	{ "armDistanceRatio", &CONFIG::armDistanceRatio },
+	{ "bodyDistanceRatio", &CONFIG::bodyDistanceRatio },
+	{ "predictionGain", &CONFIG::predictionGain },
+	{ "faceScoreThreshold", &CONFIG::faceScoreThreshold },
+	{ "attentionYawThreshold", &CONFIG::attentionYawThreshold },
+	{ "detectorThreshold", &CONFIG::detectorThreshold },
+	{ "inferenceBudget", &CONFIG::inferenceBudget },
+	{ "handWristThreshold", &CONFIG::handWristThreshold },
+	{ "handScoreThreshold", &CONFIG::handScoreThreshold },
+	{ "operatorMatchThreshold", &CONFIG::operatorMatchThreshold },
+	{ "operatorUpdateRate", &CONFIG::operatorUpdateRate },
+	{ "operatorTimeout", &CONFIG::operatorTimeout },
+	{ "traceSpikeThreshold", &CONFIG::traceSpikeThreshold },
+};
+
+static const std::vector<std::pair<const char*, int32_t CONFIG::*>> INT_PARAM_LIST = {
+	{ "poseFilteringNum", &CONFIG::poseFilteringNum },
+	{ "predictionLatency", &CONFIG::predictionLatency },
+	{ "commandFilteringNum", &CONFIG::commandFilteringNum },
+	{ "stopFilteringNum", &CONFIG::stopFilteringNum },
+	{ "idleDelay", &CONFIG::idleDelay },
+	{ "idleInterval", &CONFIG::idleInterval },
+	{ "detectorWidth", &CONFIG::detectorWidth },
+	{ "detectorCheckInterval", &CONFIG::detectorCheckInterval },
+	{ "watchdogTimeout", &CONFIG::watchdogTimeout },
+	{ "operatorAcquireFrames", &CONFIG::operatorAcquireFrames },
+	{ "operatorReleaseFrames", &CONFIG::operatorReleaseFrames },
+};
+
+/*** Global variable ***/
+static const CONFIG s_defaultConfig;
+static std::atomic<const CONFIG*> s_currentConfig(&s_defaultConfig);
+static std::mutex s_mutex;		// for writers only
+static std::vector<std::unique_ptr<CONFIG>> s_configList;	// all the loaded configs (current and retired)
+static std::thread s_watchThread;
+static std::atomic<bool> s_stopWatching(false);
+
+/*** Function ***/
+const CONFIG& Config::get()
+{
+	return *s_currentConfig.load(std::memory_order_acquire);
+}
+
+int32_t Config::load(const std::string& filename)
+{
+	CONFIG config;
+	if (parse(filename, config) != RET_OK) {
+		return RET_ERR;
+	}
+
+	set(config);
+	PRINT("Loaded %s\n", filename.c_str());
+	return RET_OK;
+}
+
+void Config::set(const CONFIG& config)
+{
+	std::unique_ptr<CONFIG> newConfig(new CONFIG(config));
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_currentConfig.store(newConfig.get(), std::memory_order_release);
+	s_configList.push_back(std::move(newConfig));
+}
+
+int32_t Config::parse(const std::string& filename, CONFIG& config)
+{
+	std::ifstream ifs(filename);
+	if (!ifs.is_open()) {
+		PRINT_E("Failed to open %s\n", filename.c_str());
+		return RET_ERR;
+	}
+
+	/* format: "key = value". '#' starts comment */
+	std::string line;
+	int32_t lineNum = 0;
+	while (std::getline(ifs, line)) {
+		lineNum++;
+		line = line.substr(0, line.find('#'));
+		size_t pos = line.find('=');
+		if (pos == std::string::npos) {
+			if (line.find_first_not_of(" \t\r") != std::string::npos) {
+				PRINT_E("Invalid line (%d): %s\n", lineNum, line.c_str());
+				return RET_ERR;
+			}
+			continue;
+		}
+		std::string key;
+		std::istringstream(line.substr(0, pos)) >> key;
+		const std::string value = line.substr(pos + 1);
+		char* end;
+		bool isFound = false;
+		for (const auto& param : FLOAT_PARAM_LIST) {
+			if (key == param.first) {
+				config.*(param.second) = strtof(value.c_str(), &end);
+				isFound = true;
+			}
+		}
+		for (const auto& param : INT_PARAM_LIST) {
+			if (key == param.first) {
+				config.*(param.second) = static_cast<int32_t>(strtol(value.c_str(), &end, 10));
+				isFound = true;
+			}
+		}
+		if (!isFound) {
+			PRINT_E("Unknown key (%d): %s\n", lineNum, key.c_str());
+			return RET_ERR;
+		}
+		if (end == value.c_str()) {
+			PRINT_E("Invalid value (%d): %s\n", lineNum, value.c_str());
+			return RET_ERR;
+		}
+	}
+
+	if (config.poseFilteringNum < 1 || config.commandFilteringNum < 1 || config.stopFilteringNum < 1 || config.detectorCheckInterval < 1
+		|| config.operatorAcquireFrames < 1 || config.operatorReleaseFrames < 1) {
+		PRINT_E("Filtering num and interval must be 1 or more\n");
+		return RET_ERR;
+	}
+	if (config.detectorWidth < 64) {
+		PRINT_E("Detector width must be 64 (HOG window) or more\n");
+		return RET_ERR;
+	}
+	if (config.watchdogTimeout < 0) {
+		PRINT_E("Watchdog timeout must be 0 or more\n");
+		return RET_ERR;
+	}
+	if (config.predictionGain < 0 || config.predictionLatency < 0) {
+		PRINT_E("Prediction gain and latency must be 0 or more\n");
+		return RET_ERR;
+	}
+	if (config.idleDelay < 0 || config.idleInterval < 0) {
+		PRINT_E("Idle delay and interval must be 0 or more\n");
+		return RET_ERR;
+	}
+	return RET_OK;
+}
+
+int32_t Config::startWatching(const std::string& filename)
+{
+#ifdef _WIN32
+	return RET_ERR;
+#else
+	if (s_watchThread.joinable()) {
+		PRINT_E("Already watching\n");
+		return RET_ERR;
+	}
+	s_stopWatching = false;
+	s_watchThread = std::thread(watch, filename);
+	return RET_OK;
+#endif
+}
+
+void Config::stopWatching()
+{
+	if (s_watchThread.joinable()) {
+		s_stopWatching = true;
+		s_watchThread.join();
+	}
+}
+
+void Config::finalize()
+{
+	stopWatching();
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_currentConfig.store(&s_defaultConfig, std::memory_order_release);
+	s_configList.clear();
+}
+
+void Config::watch(std::string filename)
+{
+#ifndef _WIN32
+	/* watch the directory because some editors replace the file instead of overwriting it */
+	size_t pos = filename.find_last_of('/');
+	const std::string dir = (pos == std::string::npos) ? "." : filename.substr(0, pos);
+	const std::string name = (pos == std::string::npos) ? filename : filename.substr(pos + 1);
+
+	int32_t fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0) {
+		PRINT_E("inotify_init1\n");
+		return;
+	}
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		PRINT_E("inotify_add_watch %s\n", dir.c_str());
+		close(fd);
+		return;
+	}
+
+	alignas(struct inotify_event) char buffer[4096];
+	while (!s_stopWatching) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 200) <= 0) continue;
+		ssize_t len = read(fd, buffer, sizeof(buffer));
+		bool isModified = false;
+		for (ssize_t i = 0; i < len; ) {
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(&buffer[i]);
+			if (event->len > 0 && name == event->name) isModified = true;
+			i += sizeof(struct inotify_event) + event->len;
+		}
+		if (isModified) {
+			(void)load(filename);	// keep the current config if the new one is invalid
+		}
+	}
+	close(fd);
+#endif
+}
@@ -0,0 +1,111 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+/* for general */
+#include <cstdint>
+#include <string>
+
+/* Parameters which can be changed without restarting. see resource/config.txt */
+typedef struct CONFIG_ {
+	/* PoseAnalyzer */
+	float   thresholdScore;			// joint whose score is lower than this is regarded as not detected
+	float   armDistanceRatio;		// threshold for arm pose = arm length * ratio
+	float   bodyDistanceRatio;		// threshold for body pose = body length * ratio
+	int32_t poseFilteringNum;		// [frame]
+	float   predictionGain;			// joints are extrapolated by gain * latency (0 = disabled, 1.0 = the whole latency)
+	int32_t predictionLatency;		// [msec] latency not measured in the frame (camera, command transfer), added to the measured one
+	/* CommandDecider */
+	int32_t commandFilteringNum;	// [frame]
+	int32_t stopFilteringNum;		// [frame] for stop (safety command)
+	float   faceScoreThreshold;		// the person is regarded as addressing the robot if face score is higher than this
+	float   attentionYawThreshold;	// [deg] and if the head faces the camera within this angle (0 = don't check)
+	/* Idle (ImageProcessor) */
+	int32_t idleDelay;				// [msec] become idle if nobody faces the robot for this time
+	int32_t idleInterval;			// [msec] interval of pose estimation while idle (0 = never idle)
+	/* PersonDetector */
+	float   detectorThreshold;		// SVM weight of HOG detector
+	int32_t detectorWidth;			// [px] frame is resized to this width. a person shorter than 128 px in the resized frame is not detected
+	int32_t detectorCheckInterval;	// [frame] run pose estimation at this interval even if the detector finds nobody
+	/* PoseEngine (model ladder) */
+	float   inferenceBudget;		// [msec] p95 of inference time to keep by switching models (0 = don't switch)
+	/* HandEngine */
+	float   handWristThreshold;		// a raised hand is inferred only if the wrist score is higher than this
+	float   handScoreThreshold;		// hand presence score of the hand landmark model
+	/* OperatorLock */
+	float   operatorMatchThreshold;	// similarity (0 - 1.0) of torso color to be regarded as the operator
+	float   operatorUpdateRate;		// the operator's signature is blended with the current one at this rate, to follow lighting change
+	float   operatorTimeout;		// [sec] release control if the operator is not seen for this time
+	int32_t operatorAcquireFrames;	// [frame] take control by facing the robot for this time
+	int32_t operatorReleaseFrames;	// [frame] release control by crossing arms for this time
+	/* Tracer (ENABLE_TRACE) */
+	float   traceSpikeThreshold;	// [msec] write spans to trace_spike_N.json if a frame takes longer than this (0 = disabled)
+	/* Watchdog (uart thread) */
+	int32_t watchdogTimeout;		// [msec] send stop if no valid pose is seen for this time (0 = disabled)
+	CONFIG_()
+		: thresholdScore(0.2f)
+		, armDistanceRatio(1.0f / 3)
+		, bodyDistanceRatio(1.0f / 2)
+		, poseFilteringNum(6)
+		, predictionGain(0)
+		, predictionLatency(50)
+		, commandFilteringNum(10)
+		, stopFilteringNum(2)
+		, faceScoreThreshold(0.3f)
+		, attentionYawThreshold(35.0f)
+		, idleDelay(5000)
+		, idleInterval(500)
+		, detectorThreshold(0.3f)
+		, detectorWidth(320)
+		, detectorCheckInterval(30)
+		, inferenceBudget(60.0f)
+		, handWristThreshold(0.4f)
+		, handScoreThreshold(0.5f)
+		, operatorMatchThreshold(0.75f)
+		, operatorUpdateRate(0.05f)
+		, operatorTimeout(30.0f)
+		, operatorAcquireFrames(10)
+		, operatorReleaseFrames(15)
+		, traceSpikeThreshold(0)
+		, watchdogTimeout(1000)
+	{}
+} CONFIG;
+
+/* Configuration shared by modules */
+/* get() is lock-free: the reloaded config is swapped by an atomic pointer (RCU-style). */
+/* Old configs are retired but not deleted until finalize(), so a reader can keep using the reference during the frame */
+class Config {
+public:
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+public:
+	static const CONFIG& get();
+	static int32_t load(const std::string& filename);
+	static void    set(const CONFIG& config);	// e.g. Tools to compare settings
+	static int32_t startWatching(const std::string& filename);	// reload when the file is modified (inotify)
+	static void    stopWatching();
+	static void    finalize();
+
+private:
+	static int32_t parse(const std::string& filename, CONFIG& config);
+	static void    watch(std::string filename);
+};
+
+#endif
@@ -0,0 +1,120 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "FramePool.h"
+
+/*** Macro ***/
+#define TAG "FramePool"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t FramePool::initialize(size_t bufferSize, int32_t numBuffer)
+{
+	if (bufferSize == 0 || numBuffer <= 0) {
+		PRINT_E("Invalid parameter (%zu, %d)\n", bufferSize, numBuffer);
+		return RET_ERR;
+	}
+
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	if (m_state->stat.numInUse > 0) {
+		PRINT_E("Frames are in use\n");
+		return RET_ERR;
+	}
+	/* round up to cache line */
+	bufferSize = (bufferSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	m_state->memoryList.clear();
+	m_state->freeList.clear();
+	for (int32_t i = 0; i < numBuffer; i++) {
+		std::unique_ptr<uint8_t[]> memory(new uint8_t[bufferSize + ALIGNMENT]);
+		const uintptr_t address = reinterpret_cast<uintptr_t>(memory.get());
+		m_state->freeList.push_back(reinterpret_cast<uint8_t*>((address + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT));
+		m_state->memoryList.push_back(std::move(memory));
+	}
+	m_state->stat = STATISTICS();
+	m_state->stat.numBuffer = numBuffer;
+	m_state->stat.bufferSize = bufferSize;
+	return RET_OK;
+}
+
+FramePool::FRAME FramePool::acquire(int32_t width, int32_t height, int32_t type)
+{
+	const size_t size = static_cast<size_t>(width) * height * CV_ELEM_SIZE(type);
+	const std::shared_ptr<STATE>& state = m_state;
+	uint8_t* data = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->stat.numAcquire++;
+		state->stat.numInUse++;
+		state->stat.peakInUse = (std::max)(state->stat.peakInUse, state->stat.numInUse);
+		if (size <= state->stat.bufferSize && !state->freeList.empty()) {
+			data = state->freeList.back();
+			state->freeList.pop_back();
+		} else {
+			state->stat.numMiss++;
+		}
+	}
+
+	FRAME frame;
+	if (data) {
+		frame.buffer.reset(data, [state](uint8_t* p) {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->freeList.push_back(p);
+			state->stat.numInUse--;
+		});
+	} else {
+		/* note: new[] is aligned only to alignof(std::max_align_t), which is enough for cv::Mat */
+		frame.buffer.reset(new uint8_t[size], [state](uint8_t* p) {
+			delete[] p;
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->stat.numInUse--;
+		});
+	}
+	frame.mat = cv::Mat(height, width, type, frame.buffer.get());
+	return frame;
+}
+
+bool FramePool::isPooled(const FRAME& frame) const
+{
+	return !frame.empty() && frame.mat.data == frame.buffer.get();
+}
+
+FramePool::STATISTICS FramePool::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return m_state->stat;
+}
+
+void FramePool::printStatistics(const std::string& name) const
+{
+	const STATISTICS stat = getStatistics();
+	PRINT("%s: buffer = %d x %zu [byte], acquire = %lld, miss = %lld, peak in use = %d, in use = %d\n",
+		name.c_str(), stat.numBuffer, stat.bufferSize, static_cast<long long>(stat.numAcquire), static_cast<long long>(stat.numMiss), stat.peakInUse, stat.numInUse);
+}
@@ -0,0 +1,81 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef FRAME_POOL_
+#define FRAME_POOL_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* Fixed number of cache-aligned frame buffers shared by capture, preprocessing and rendering */
+/* A FRAME is a reference-counted handle. The buffer returns to the pool when the last copy of the handle is released. */
+/* When no buffer is free (or the requested size is larger than the buffer), a buffer is allocated from heap and freed after use (pool miss) */
+/* note: cv::Mat in FRAME doesn't own the buffer. keep FRAME (not only mat) while using the image */
+class FramePool {
+public:
+	static constexpr size_t ALIGNMENT = 64;		// cache line
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	typedef struct FRAME_ {
+		cv::Mat mat;
+		std::shared_ptr<uint8_t> buffer;
+		bool empty() const { return !buffer; }
+	} FRAME;
+
+	typedef struct STATISTICS_ {
+		int32_t numBuffer;
+		size_t  bufferSize;		// [byte]
+		int64_t numAcquire;
+		int64_t numMiss;		// allocated from heap because no buffer is free or the size is too large
+		int32_t numInUse;
+		int32_t peakInUse;		// including miss
+		STATISTICS_() : numBuffer(0), bufferSize(0), numAcquire(0), numMiss(0), numInUse(0), peakInUse(0)
+		{}
+	} STATISTICS;
+
+public:
+	FramePool() : m_state(std::make_shared<STATE>()) {}
+	int32_t initialize(size_t bufferSize, int32_t numBuffer);	// buffers are allocated here
+	int32_t initialize(int32_t width, int32_t height, int32_t type, int32_t numBuffer) { return initialize(static_cast<size_t>(width) * height * CV_ELEM_SIZE(type), numBuffer); }
+	FRAME   acquire(int32_t width, int32_t height, int32_t type);
+	bool    isPooled(const FRAME& frame) const;	// false if mat was reallocated (e.g. by cv::resize with different size)
+	STATISTICS getStatistics() const;
+	void    printStatistics(const std::string& name) const;
+
+private:
+	/* shared with the deleter of FRAME, so that FRAME can outlive the pool */
+	typedef struct STATE_ {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<uint8_t[]>> memoryList;
+		std::vector<uint8_t*> freeList;		// aligned
+		STATISTICS stat;
+	} STATE;
+
+private:
+	std::shared_ptr<STATE> m_state;
+};
+
+#endif
@@ -0,0 +1,273 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "Config.h"
+#include "GestureRecognizer.h"
+
+/*** Macro ***/
+#define TAG "GestureRecognizer"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+#define THRESHOLD_SCORE (Config::get().thresholdScore)
+
+/* all the thresholds below are normalized by body size */
+#define HYSTERESIS_POSITION  0.15f    // movement smaller than this is regarded as noise
+#define THRESHOLD_RAISED     -0.3f    // hand is above the sholder by this
+#define THRESHOLD_LEVEL      0.5f     // hand is at the height of the sholder within this
+#define MIN_VALID_RATIO      0.7f     // ratio of valid frames in the window
+#define WAVE_NUM_REVERSAL    3
+#define WAVE_RANGE           0.4f
+#define BECKON_NUM_REVERSAL  3
+#define BECKON_RANGE         0.3f
+#define SWEEP_DISPLACEMENT   1.2f
+
+static const std::vector<std::pair<int32_t, int32_t>> SCALE_LIST = {
+    {6, 5},
+    {5, 11},
+    {12, 6},
+};
+
+/*** Function ***/
+void GestureRecognizer::Trajectory::push(bool isValid, float value)
+{
+    SAMPLE sample;
+    sample.isValid = isValid;
+    sample.isReversal = false;
+    sample.value = value;
+    sample.index = m_index++;
+
+    if (isValid) {
+        /* count direction reversal (zigzag with hysteresis) */
+        if (!m_hasExtremum) {
+            m_extremum = value;
+            m_hasExtremum = true;
+        } else if (m_direction == 0) {
+            if (value > m_extremum + m_hysteresis) {
+                m_direction = 1;
+                m_extremum = value;
+            } else if (value < m_extremum - m_hysteresis) {
+                m_direction = -1;
+                m_extremum = value;
+            }
+        } else if (m_direction > 0) {
+            if (value > m_extremum) {
+                m_extremum = value;
+            } else if (value < m_extremum - m_hysteresis) {
+                m_direction = -1;
+                m_extremum = value;
+                sample.isReversal = true;
+            }
+        } else {
+            if (value < m_extremum) {
+                m_extremum = value;
+            } else if (value > m_extremum + m_hysteresis) {
+                m_direction = 1;
+                m_extremum = value;
+                sample.isReversal = true;
+            }
+        }
+
+        /* monotonic queues for min / max in the window */
+        while (!m_minList.empty() && m_minList.back().value >= value) m_minList.pop_back();
+        m_minList.push_back(sample);
+        while (!m_maxList.empty() && m_maxList.back().value <= value) m_maxList.pop_back();
+        m_maxList.push_back(sample);
+
+        m_numValid++;
+        m_sum += value;
+        if (sample.isReversal) m_numReversal++;
+    }
+    m_sampleList.push_back(sample);
+
+    /* remove the oldest sample */
+    if (m_sampleList.size() > WINDOW_SIZE) {
+        const SAMPLE& oldest = m_sampleList.front();
+        if (oldest.isValid) {
+            m_numValid--;
+            m_sum -= oldest.value;
+            if (oldest.isReversal) m_numReversal--;
+            if (!m_minList.empty() && m_minList.front().index == oldest.index) m_minList.pop_front();
+            if (!m_maxList.empty() && m_maxList.front().index == oldest.index) m_maxList.pop_front();
+        }
+        m_sampleList.pop_front();
+    }
+}
+
+void GestureRecognizer::Trajectory::reset()
+{
+    m_sampleList.clear();
+    m_minList.clear();
+    m_maxList.clear();
+    m_numValid = 0;
+    m_numReversal = 0;
+    m_sum = 0;
+    m_hasExtremum = false;
+    m_direction = 0;
+    m_extremum = 0;
+}
+
+float GestureRecognizer::Trajectory::mean() const
+{
+    if (m_numValid == 0) return 0;
+    return static_cast<float>(m_sum / m_numValid);
+}
+
+float GestureRecognizer::Trajectory::range() const
+{
+    if (m_minList.empty() || m_maxList.empty()) return 0;
+    return m_maxList.front().value - m_minList.front().value;
+}
+
+float GestureRecognizer::Trajectory::displacement() const
+{
+    if (m_numValid == 0) return 0;
+    /* valid samples are usually found at the first few elements */
+    auto first = std::find_if(m_sampleList.begin(), m_sampleList.end(), [](const SAMPLE& s) { return s.isValid; });
+    auto last = std::find_if(m_sampleList.rbegin(), m_sampleList.rend(), [](const SAMPLE& s) { return s.isValid; });
+    return last->value - first->value;
+}
+
+GestureRecognizer::HAND_::HAND_(int32_t wrist, int32_t sholder)
+    : wristIndex(wrist)
+    , sholderIndex(sholder)
+    , x(HYSTERESIS_POSITION)
+    , y(HYSTERESIS_POSITION)
+    , raised(0)
+    , level(0)
+{}
+
+GestureRecognizer::GestureRecognizer()
+    : m_handList{ { HAND(10, 6), HAND(9, 5) } }
+{}
+
+int32_t GestureRecognizer::update(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, RESULT& result)
+{
+    /*** Calculate body size to normalize positions ***/
+    float sum = 0;
+    int32_t num = 0;
+    for (const auto& indexPair : SCALE_LIST) {
+        if (scoreList[indexPair.first] > THRESHOLD_SCORE && scoreList[indexPair.second] > THRESHOLD_SCORE) {
+            float dx = jointList[indexPair.first].first - jointList[indexPair.second].first;
+            float dy = jointList[indexPair.first].second - jointList[indexPair.second].second;
+            sum += std::sqrt(dx * dx + dy * dy);
+            num++;
+        }
+    }
+    const float scale = (num > 0) ? sum / num : -1;
+
+    /*** Add the current position to the trajectory of each hand ***/
+    for (auto& hand : m_handList) {
+        bool isValid = (scale > 0) && scoreList[hand.wristIndex] > THRESHOLD_SCORE && scoreList[hand.sholderIndex] > THRESHOLD_SCORE;
+        float x = 0;
+        float y = 0;
+        if (isValid) {
+            x = (jointList[hand.wristIndex].first - jointList[hand.sholderIndex].first) / scale;
+            y = (jointList[hand.wristIndex].second - jointList[hand.sholderIndex].second) / scale;
+        }
+        hand.x.push(isValid, x);
+        hand.y.push(isValid, y);
+        hand.raised.push(isValid, (y < THRESHOLD_RAISED) ? 1.0f : 0.0f);
+        hand.level.push(isValid, ((std::abs)(y) < THRESHOLD_LEVEL) ? 1.0f : 0.0f);
+    }
+
+    /*** Recognize gesture ***/
+    int32_t gesture = GESTURE_NONE;
+    for (const auto& hand : m_handList) {
+        gesture = recognize(hand);
+        if (gesture != GESTURE_NONE) break;
+    }
+
+    /*** Hold the event for a while ***/
+    if (gesture != GESTURE_NONE) {
+        m_result.gesture = gesture;
+        m_result.holdCount = HOLD_FRAMES;
+    } else if (m_result.holdCount > 0) {
+        m_result.holdCount--;
+        if (m_result.holdCount == 0) {
+            m_result.gesture = GESTURE_NONE;
+        }
+    }
+
+    result = m_result;
+    return RET_OK;
+}
+
+int32_t GestureRecognizer::recognize(const HAND& hand) const
+{
+    if (hand.x.numValid() < WINDOW_SIZE * MIN_VALID_RATIO) {
+        return GESTURE_NONE;
+    }
+
+    /* hand is kept above the sholder and moves left and right */
+    if (hand.raised.mean() > 0.8f && hand.x.numReversal() >= WAVE_NUM_REVERSAL && hand.x.range() > WAVE_RANGE) {
+        return GESTURE_WAVE;
+    }
+
+    /* hand is kept at the height of the sholder and moves in one direction */
+    if (hand.level.mean() > 0.8f && hand.x.numReversal() == 0) {
+        float displacement = hand.x.displacement();
+        if (displacement > SWEEP_DISPLACEMENT) return GESTURE_SWEEP_RIGHT;
+        if (displacement < -SWEEP_DISPLACEMENT) return GESTURE_SWEEP_LEFT;
+    }
+
+    /* hand is kept in front of the chest and moves up and down */
+    if (hand.raised.mean() < 0.2f && hand.y.mean() > 0 && hand.y.numReversal() >= BECKON_NUM_REVERSAL && hand.y.range() > BECKON_RANGE) {
+        return GESTURE_BECKON;
+    }
+
+    return GESTURE_NONE;
+}
+
+void GestureRecognizer::reset()
+{
+    for (auto& hand : m_handList) {
+        hand.x.reset();
+        hand.y.reset();
+        hand.raised.reset();
+        hand.level.reset();
+    }
+    m_result = RESULT();
+}
+
+const char* GestureRecognizer::getName(int32_t gesture)
+{
+    switch (gesture) {
+    case GESTURE_WAVE:
+        return "wave";
+    case GESTURE_BECKON:
+        return "beckon";
+    case GESTURE_SWEEP_LEFT:
+        return "sweep_left";
+    case GESTURE_SWEEP_RIGHT:
+        return "sweep_right";
+    case GESTURE_NONE:
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,127 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef GESTURE_RECOGNIZER_
+#define GESTURE_RECOGNIZER_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <memory>
+
+/* Recognize motion gestures from the trajectory of joints over a sliding window */
+/* note: every update is O(1) (amortized). statistics are updated incrementally when a sample enters / leaves the window */
+class GestureRecognizer {
+
+public:
+	static constexpr int32_t WINDOW_SIZE = 30;	// [frame]
+	static constexpr int32_t HOLD_FRAMES = 12;	// [frame] keep an event so that CommandDecider can see it stably
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	enum {
+		GESTURE_NONE = 0,
+		GESTURE_WAVE,			// hand above the sholder moves left and right repeatedly
+		GESTURE_BECKON,			// hand in front of the chest moves up and down repeatedly
+		GESTURE_SWEEP_LEFT,		// stretched hand moves to the left of the image
+		GESTURE_SWEEP_RIGHT,	// stretched hand moves to the right of the image
+	};
+
+	typedef struct RESULT_ {
+		int32_t gesture;
+		int32_t holdCount;	// the number of frames the gesture will be kept
+		RESULT_()
+			: gesture(GESTURE_NONE)
+			, holdCount(0)
+		{}
+	} RESULT;
+
+private:
+	/* Sliding window of a 1-D signal. min, max, valid count and direction reversals are updated incrementally */
+	class Trajectory {
+	public:
+		Trajectory(float hysteresis)
+			: m_hysteresis(hysteresis)
+			, m_numValid(0)
+			, m_numReversal(0)
+			, m_sum(0)
+			, m_hasExtremum(false)
+			, m_direction(0)
+			, m_extremum(0)
+			, m_index(0)
+		{}
+		void  push(bool isValid, float value);
+		void  reset();
+		int32_t numValid() const { return m_numValid; }
+		int32_t numReversal() const { return m_numReversal; }
+		float mean() const;
+		float range() const;
+		float displacement() const;	// the last valid value - the first valid value
+
+	private:
+		typedef struct {
+			bool    isValid;
+			bool    isReversal;
+			float   value;
+			int64_t index;
+		} SAMPLE;
+		const float m_hysteresis;
+		std::deque<SAMPLE> m_sampleList;
+		std::deque<SAMPLE> m_minList;	// monotonic queue (increasing)
+		std::deque<SAMPLE> m_maxList;	// monotonic queue (decreasing)
+		int32_t m_numValid;
+		int32_t m_numReversal;
+		double  m_sum;
+		bool    m_hasExtremum;
+		int32_t m_direction;	// -1, 0, 1
+		float   m_extremum;
+		int64_t m_index;
+	};
+
+	/* Trajectory of one hand relative to the sholder, normalized by body size */
+	typedef struct HAND_ {
+		int32_t wristIndex;
+		int32_t sholderIndex;
+		Trajectory x;
+		Trajectory y;
+		Trajectory raised;	// 1 if the hand is above the sholder
+		Trajectory level;	// 1 if the hand is at the height of the sholder
+		HAND_(int32_t wrist, int32_t sholder);
+	} HAND;
+
+public:
+	GestureRecognizer();
+	~GestureRecognizer() {}
+
+	int32_t update(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, GestureRecognizer::RESULT& result);
+	void    reset();
+	static const char* getName(int32_t gesture);
+
+private:
+	int32_t recognize(const HAND& hand) const;
+
+private:
+	std::array<HAND, 2> m_handList;
+	RESULT m_result;
+};
+
+#endif
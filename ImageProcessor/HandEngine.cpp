@@ -0,0 +1,301 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "InferenceHelper.h"
+#include "Config.h"
+#include "HandEngine.h"
+#include "Tracer.h"
+
+/*** Macro ***/
+#define TAG "HandEngine"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/* Model parameters */
+/* MediaPipe hand landmark (lite). https://github.com/google/mediapipe/tree/master/mediapipe/modules/hand_landmark */
+#define MODEL_NAME             "hand_landmark_lite.tflite"
+#define INPUT_NAME             "input_1"
+#define INPUT_SIZE             224
+#define OUTPUT_LANDMARK_NAME   "Identity"		// [1, 63] (x, y, z) x 21 in pixels of the input
+#define OUTPUT_SCORE_NAME      "Identity_1"		// [1, 1] hand presence (before sigmoid)
+
+/* Crop around the wrist. the hand is beyond the wrist along the forearm */
+#define HAND_CENTER_RATIO      0.5f		// distance from the wrist to the center of the crop = forearm * ratio
+#define HAND_CROP_RATIO        1.5f		// crop size = forearm * ratio
+#define MIN_CROP_SIZE          32		// [px] too small hand cannot be counted
+
+/*** Function ***/
+HandEngine::HandEngine()
+	: m_handList{ { HAND(10, 8), HAND(9, 7) } }
+	, m_nextHand(HAND_RIGHT)
+{
+}
+
+int32_t HandEngine::initialize(const std::string& workDir, const int32_t numThreads)
+{
+	/* Set model information */
+	std::string modelFilename = workDir + "/model/" + MODEL_NAME;
+	if (!std::ifstream(modelFilename)) {
+		PRINT_E("Model is not found: %s\n", modelFilename.c_str());
+		return RET_ERR;
+	}
+
+	/* Set input tensor info */
+	m_inputTensorList.clear();
+	InputTensorInfo inputTensorInfo;
+	inputTensorInfo.name = INPUT_NAME;
+	inputTensorInfo.tensorType = TensorInfo::TENSOR_TYPE_FP32;
+	inputTensorInfo.tensorDims.batch = 1;
+	inputTensorInfo.tensorDims.width = INPUT_SIZE;
+	inputTensorInfo.tensorDims.height = INPUT_SIZE;
+	inputTensorInfo.tensorDims.channel = 3;
+	inputTensorInfo.dataType = InputTensorInfo::DATA_TYPE_IMAGE;
+	/* 0.0 - 1.0 */
+	inputTensorInfo.normalize.mean[0] = 0;
+	inputTensorInfo.normalize.mean[1] = 0;
+	inputTensorInfo.normalize.mean[2] = 0;
+	inputTensorInfo.normalize.norm[0] = 1/255.f;
+	inputTensorInfo.normalize.norm[1] = 1/255.f;
+	inputTensorInfo.normalize.norm[2] = 1/255.f;
+	m_inputTensorList.push_back(inputTensorInfo);
+
+	/* Set output tensor info */
+	m_outputTensorList.clear();
+	OutputTensorInfo outputTensorInfo;
+	outputTensorInfo.tensorType = TensorInfo::TENSOR_TYPE_FP32;
+	outputTensorInfo.name = OUTPUT_LANDMARK_NAME;
+	m_outputTensorList.push_back(outputTensorInfo);
+	outputTensorInfo.name = OUTPUT_SCORE_NAME;
+	m_outputTensorList.push_back(outputTensorInfo);
+
+	/* Create and Initialize Inference Helper */
+	m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_XNNPACK));
+	if (!m_inferenceHelper) {
+		return RET_ERR;
+	}
+	if (m_inferenceHelper->setNumThread(numThreads) != InferenceHelper::RET_OK
+		|| m_inferenceHelper->initialize(modelFilename, m_inputTensorList, m_outputTensorList) != InferenceHelper::RET_OK) {
+		m_inferenceHelper.reset();
+		return RET_ERR;
+	}
+
+	reset();
+	return RET_OK;
+}
+
+int32_t HandEngine::finalize()
+{
+	if (!m_inferenceHelper) {
+		PRINT_E("Inference helper is not created\n");
+		return RET_ERR;
+	}
+	m_inferenceHelper->finalize();
+	m_inferenceHelper.reset();
+	return RET_OK;
+}
+
+int32_t HandEngine::warmup(const int32_t numWarmup)
+{
+	/* so that the first hand gesture is not delayed by the first (slow) inference */
+	cv::Mat dummyMat(INPUT_SIZE, INPUT_SIZE, CV_8UC3, cv::Scalar(128, 128, 128));
+	for (int32_t i = 0; i < numWarmup; i++) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		int32_t fingerCount;
+		if (invokeRegion(dummyMat, cv::Rect(0, 0, dummyMat.cols, dummyMat.rows), fingerCount) != RET_OK) {
+			return RET_ERR;
+		}
+		const auto& t1 = std::chrono::steady_clock::now();
+		PRINT("Startup: warmup[%d] = %.1f [msec]\n", i, static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0);
+	}
+	return RET_OK;
+}
+
+void HandEngine::reset()
+{
+	for (auto& hand : m_handList) {
+		hand.fingerCount = -1;
+		hand.lastFingerCount = -1;
+	}
+}
+
+int32_t HandEngine::process(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, RESULT& result)
+{
+	result = RESULT();
+	if (!m_inferenceHelper) {
+		PRINT_E("Inference helper is not created\n");
+		return RET_ERR;
+	}
+
+	/* A hand is a candidate only while it's raised. the result is cleared as soon as the hand is put down */
+	std::array<cv::Rect, HAND_NUM> regionList;
+	std::array<bool, HAND_NUM> isRaisedList;
+	for (int32_t i = 0; i < HAND_NUM; i++) {
+		isRaisedList[i] = getRegion(originalMat, m_handList[i], jointList, scoreList, regionList[i]);
+		if (!isRaisedList[i]) {
+			m_handList[i].fingerCount = -1;
+			m_handList[i].lastFingerCount = -1;
+		}
+	}
+
+	/* One hand per frame. hands take turns when both are raised */
+	int32_t handIndex = -1;
+	for (int32_t i = 0; i < HAND_NUM; i++) {
+		const int32_t index = (m_nextHand + i) % HAND_NUM;
+		if (isRaisedList[index]) {
+			handIndex = index;
+			break;
+		}
+	}
+
+	if (handIndex >= 0) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		int32_t fingerCount;
+		if (invokeRegion(originalMat, regionList[handIndex], fingerCount) != RET_OK) {
+			return RET_ERR;
+		}
+		/* accept the count when two inferences in a row agree. the previous count is kept until then */
+		HAND& hand = m_handList[handIndex];
+		if (fingerCount < 0) {
+			hand.fingerCount = -1;
+		} else if (fingerCount == hand.lastFingerCount) {
+			hand.fingerCount = fingerCount;
+		}
+		hand.lastFingerCount = fingerCount;
+		m_nextHand = (handIndex + 1) % HAND_NUM;
+
+		const cv::Rect& region = regionList[handIndex];
+		result.hand = handIndex;
+		result.regionX = static_cast<float>(region.x) / originalMat.cols;
+		result.regionY = static_cast<float>(region.y) / originalMat.rows;
+		result.regionWidth = static_cast<float>(region.width) / originalMat.cols;
+		result.regionHeight = static_cast<float>(region.height) / originalMat.rows;
+		result.timeInference = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t0).count() * 1000.0;
+	}
+
+	for (int32_t i = 0; i < HAND_NUM; i++) {
+		result.fingerCount[i] = m_handList[i].fingerCount;
+	}
+	return RET_OK;
+}
+
+bool HandEngine::getRegion(const cv::Mat& originalMat, const HAND& hand, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, cv::Rect& region) const
+{
+	const CONFIG& config = Config::get();
+	if (scoreList[hand.wristIndex] <= config.handWristThreshold || scoreList[hand.elbowIndex] <= config.thresholdScore) {
+		return false;
+	}
+
+	/* raised: the wrist is above the elbow */
+	const float wristX = jointList[hand.wristIndex].first * originalMat.cols;
+	const float wristY = jointList[hand.wristIndex].second * originalMat.rows;
+	const float forearmX = wristX - jointList[hand.elbowIndex].first * originalMat.cols;
+	const float forearmY = wristY - jointList[hand.elbowIndex].second * originalMat.rows;
+	if (forearmY >= 0) {
+		return false;
+	}
+
+	const float size = std::sqrt(forearmX * forearmX + forearmY * forearmY) * HAND_CROP_RATIO;
+	if (size < MIN_CROP_SIZE) {
+		return false;
+	}
+	const float centerX = wristX + forearmX * HAND_CENTER_RATIO;
+	const float centerY = wristY + forearmY * HAND_CENTER_RATIO;
+	region = cv::Rect(static_cast<int32_t>(centerX - size / 2), static_cast<int32_t>(centerY - size / 2), static_cast<int32_t>(size), static_cast<int32_t>(size));
+	region = region & cv::Rect(0, 0, originalMat.cols, originalMat.rows);
+
+	/* the hand is mostly out of the frame */
+	return (region.width >= size / 2 && region.height >= size / 2);
+}
+
+int32_t HandEngine::invokeRegion(const cv::Mat& originalMat, const cv::Rect& region, int32_t& fingerCount)
+{
+	TRACE_SPAN("hand");
+	/*** PreProcess ***/
+	InputTensorInfo& inputTensorInfo = m_inputTensorList[0];
+#ifndef CV_COLOR_IS_RGB
+	cv::resize(originalMat(region), m_resizedMat, cv::Size(inputTensorInfo.tensorDims.width, inputTensorInfo.tensorDims.height));
+	cv::cvtColor(m_resizedMat, m_imgSrc, cv::COLOR_BGR2RGB);
+#else
+	cv::resize(originalMat(region), m_imgSrc, cv::Size(inputTensorInfo.tensorDims.width, inputTensorInfo.tensorDims.height));
+#endif
+	inputTensorInfo.data = m_imgSrc.data;
+	inputTensorInfo.dataType = InputTensorInfo::DATA_TYPE_IMAGE;
+	inputTensorInfo.imageInfo.width = m_imgSrc.cols;
+	inputTensorInfo.imageInfo.height = m_imgSrc.rows;
+	inputTensorInfo.imageInfo.channel = m_imgSrc.channels();
+	inputTensorInfo.imageInfo.cropX = 0;
+	inputTensorInfo.imageInfo.cropY = 0;
+	inputTensorInfo.imageInfo.cropWidth = m_imgSrc.cols;
+	inputTensorInfo.imageInfo.cropHeight = m_imgSrc.rows;
+	inputTensorInfo.imageInfo.isBGR = false;
+	inputTensorInfo.imageInfo.swapColor = false;
+	if (m_inferenceHelper->preProcess(m_inputTensorList) != InferenceHelper::RET_OK) {
+		return RET_ERR;
+	}
+
+	/*** Inference ***/
+	if (m_inferenceHelper->invoke(m_outputTensorList) != InferenceHelper::RET_OK) {
+		return RET_ERR;
+	}
+
+	/*** PostProcess ***/
+	const float handScore = 1.0f / (1.0f + std::exp(-m_outputTensorList[1].getDataAsFloat()[0]));
+	if (handScore < Config::get().handScoreThreshold) {
+		fingerCount = -1;
+	} else {
+		fingerCount = countFingers(m_outputTensorList[0].getDataAsFloat());
+	}
+	return RET_OK;
+}
+
+int32_t HandEngine::countFingers(const float* landmarkList)
+{
+	/* landmark index: 0 = wrist, thumb = 1 - 4, index = 5 - 8, middle = 9 - 12, ring = 13 - 16, pinky = 17 - 20 (tip is the last) */
+	const auto& distance = [landmarkList](int32_t index0, int32_t index1) {
+		const float dx = landmarkList[index0 * 3] - landmarkList[index1 * 3];
+		const float dy = landmarkList[index0 * 3 + 1] - landmarkList[index1 * 3 + 1];
+		return std::sqrt(dx * dx + dy * dy);
+	};
+
+	int32_t fingerCount = 0;
+
+	/* thumb: the tip is farther from the base of the pinky than the IP joint */
+	if (distance(4, 17) > distance(3, 17)) fingerCount++;
+
+	/* the others: the tip is farther from the wrist than the PIP joint. a bent finger comes back toward the palm */
+	static const std::array<std::pair<int32_t, int32_t>, 4> FINGER_LIST = { { {8, 6}, {12, 10}, {16, 14}, {20, 18} } };
+	for (const auto& finger : FINGER_LIST) {
+		if (distance(finger.first, 0) > distance(finger.second, 0)) fingerCount++;
+	}
+	return fingerCount;
+}
@@ -0,0 +1,100 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef HAND_ENGINE_
+#define HAND_ENGINE_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "InferenceHelper.h"
+
+/* Second stage of pose estimation: hand landmark model on a small crop around a raised wrist */
+/* At most one hand is inferred per frame (the two hands take turns), and nothing is inferred while no hand is raised. */
+/* So the cascade costs nothing unless a hand gesture is in progress */
+class HandEngine {
+public:
+	static constexpr int32_t NUM_LANDMARKS = 21;
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	/* same as PoseAnalyzer (left is joint 10, right is joint 9) */
+	enum {
+		HAND_LEFT = 0,
+		HAND_RIGHT,
+		HAND_NUM,
+	};
+
+	typedef struct RESULT_ {
+		std::array<int32_t, HAND_NUM> fingerCount;	// 0 (closed) - 5 (open). -1 if the hand is not raised or not stable
+		int32_t   hand;					// HAND_xxx inferred in this frame. -1 if none
+		float     regionX;				// crop of the hand inferred in this frame (0 - 1.0)
+		float     regionY;
+		float     regionWidth;
+		float     regionHeight;
+		double    timeInference;		// [msec] including pre / post process. 0 if nothing is inferred
+		RESULT_() : hand(-1), regionX(0), regionY(0), regionWidth(0), regionHeight(0), timeInference(0)
+		{
+			fingerCount.fill(-1);
+		}
+	} RESULT;
+
+private:
+	typedef struct HAND_ {
+		int32_t wristIndex;
+		int32_t elbowIndex;
+		int32_t fingerCount;		// stable result
+		int32_t lastFingerCount;	// result of the last inference (-1: hand not found)
+		HAND_(int32_t wrist, int32_t elbow) : wristIndex(wrist), elbowIndex(elbow), fingerCount(-1), lastFingerCount(-1) {}
+	} HAND;
+
+public:
+	HandEngine();
+	~HandEngine() {}
+	int32_t initialize(const std::string& workDir, const int32_t numThreads);
+	int32_t finalize(void);
+	int32_t warmup(const int32_t numWarmup);
+	bool    isInitialized() const { return m_inferenceHelper != nullptr; }
+	int32_t process(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, RESULT& result);
+	void    reset();
+
+private:
+	bool    getRegion(const cv::Mat& originalMat, const HAND& hand, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, cv::Rect& region) const;
+	int32_t invokeRegion(const cv::Mat& originalMat, const cv::Rect& region, int32_t& fingerCount);
+	static int32_t countFingers(const float* landmarkList);	// [x, y, z] x 21
+
+private:
+	std::unique_ptr<InferenceHelper> m_inferenceHelper;
+	std::vector<InputTensorInfo>  m_inputTensorList;
+	std::vector<OutputTensorInfo> m_outputTensorList;
+	std::array<HAND, HAND_NUM> m_handList;
+	int32_t m_nextHand;		// the hand inferred first when both are raised
+	cv::Mat m_resizedMat;	// reused to avoid allocation
+	cv::Mat m_imgSrc;
+};
+
+#endif
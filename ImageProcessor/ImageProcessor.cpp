@@ -26,15 +26,27 @@ limitations under the License.
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
 
 /* for My modules */
 #include "CommonHelper.h"
+#include "Config.h"
 #include "PoseEngine.h"
+#include "HandEngine.h"
+#include "OperatorLock.h"
 #include "PoseAnalyzer.h"
+#include "GestureRecognizer.h"
 #include "CommandDecider.h"
+#include "KeypointLog.h"
+#include "ResultBus.h"
+#include "PreviewServer.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
 #include "ImageProcessor.h"
 
 /*** Macro ***/
@@ -42,6 +54,8 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+#define TRACE_SPIKE_INTERVAL 5000	// [msec] between dumps triggered by slow frames
+
 static const std::vector<std::pair<int32_t, int32_t>> jointLineList {
 	/* face */
 	{0, 2},
@@ -67,8 +81,39 @@ static const std::vector<std::pair<int32_t, int32_t>> jointLineList {
 
 /*** Global variable ***/
 std::unique_ptr<PoseEngine> s_poseEngine;
+HandEngine s_handEngine;
+OperatorLock s_operatorLock;
 PoseAnalyzer s_poseAnalyzer;
+GestureRecognizer s_gestureRecognizer;
 CommandDecider s_commandDecider;
+KeypointLog s_keypointLog;
+ResultBus s_resultBus;
+double s_attentionTime = -1;	// [msec] the last time someone faced the robot
+double s_invokeTime = -1;		// [msec] the last time pose estimation ran
+int32_t s_numIdleSkipped = 0;
+int64_t s_traceDumpTime = -1;	// [nsec]
+int32_t s_numTraceDump = 0;
+cv::Mat s_resultBusImage;
+cv::Size s_resultBusImageSize;
+PreviewServer s_previewServer;
+
+/* for asynchronous API. ticket = 0 means no frame */
+std::thread s_asyncThread;
+std::mutex s_asyncMutex;
+std::condition_variable s_asyncRequestCond;
+std::condition_variable s_asyncResultCond;
+bool s_isAsyncRunning = false;
+int32_t s_asyncLastTicket = 0;
+int32_t s_asyncPendingTicket = 0;
+int32_t s_asyncProcessingTicket = 0;
+int32_t s_asyncResultTicket = 0;
+int32_t s_asyncResultStatus = IMAGE_PROCESSOR_ERROR;
+cv::Mat s_asyncPendingMat;
+cv::Mat s_asyncResultMat;
+OUTPUT_PARAM s_asyncResultParam;
+IMAGE_PROCESSOR_CALLBACK s_asyncCallback = nullptr;
+void* s_asyncCallbackUserData = nullptr;
+int32_t s_asyncNumDropped = 0;
 
 /*** Function ***/
 static cv::Scalar createCvColor(int32_t b, int32_t g, int32_t r) {
@@ -80,6 +125,21 @@ static cv::Scalar createCvColor(int32_t b, int32_t g, int32_t r) {
 }
 
 void drawPose(cv::Mat& mat, const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList);
+static void stopAsyncThread();
+static int32_t process(cv::Mat* mat, OUTPUT_PARAM* outputParam);
+
+/* release the modules initialized so far, so that ImageProcessor_initialize can be called again */
+static int32_t abortInitialize()
+{
+	(void)s_poseEngine->finalize();
+	if (s_handEngine.isInitialized()) s_handEngine.finalize();
+	s_keypointLog.close();
+	s_resultBus.close();
+	s_previewServer.finalize();
+	Config::finalize();
+	s_poseEngine.reset();
+	return -1;
+}
 
 int32_t ImageProcessor_initialize(const INPUT_PARAM* inputParam)
 {
@@ -88,10 +148,67 @@ int32_t ImageProcessor_initialize(const INPUT_PARAM* inputParam)
 		return -1;
 	}
 
+	/* parameters can be changed while running without reinitializing PoseEngine */
+	const std::string configFilename = std::string(inputParam->workDir) + "/config.txt";
+	if (Config::load(configFilename) == Config::RET_OK) {
+		(void)Config::startWatching(configFilename);
+	} else {
+		PRINT("Use default config\n");
+	}
+
 	s_poseEngine.reset(new PoseEngine());
-	if (s_poseEngine->initialize(inputParam->workDir, inputParam->numThreads) != PoseEngine::RET_OK) {
+	if (s_poseEngine->initialize(inputParam->workDir, inputParam->numThreads, inputParam->useModelLadder != 0) != PoseEngine::RET_OK) {
+		s_poseEngine.reset();
+		Config::finalize();
 		return -1;
 	}
+	s_poseEngine->setScaleMode(inputParam->scaleMode);
+	if (s_poseEngine->setPersonDetector(inputParam->usePersonDetector != 0) != PoseEngine::RET_OK) {
+		return abortInitialize();
+	}
+	if (s_poseEngine->warmup(inputParam->numWarmup) != PoseEngine::RET_OK) {
+		return abortInitialize();
+	}
+
+	if (inputParam->useHandEngine) {
+		if (s_handEngine.initialize(inputParam->workDir, inputParam->numThreads) != HandEngine::RET_OK) {
+			return abortInitialize();
+		}
+		if (s_handEngine.warmup(inputParam->numWarmup) != HandEngine::RET_OK) {
+			return abortInitialize();
+		}
+	}
+
+	s_operatorLock.setEnabled(inputParam->useOperatorLock != 0);
+	s_attentionTime = -1;
+	s_invokeTime = -1;
+	s_numIdleSkipped = 0;
+	s_commandDecider.setMode(inputParam->controlMode);
+	s_commandDecider.setTargetDistance(inputParam->targetDistance, inputParam->targetDistance * 0.2f);
+	if (s_poseAnalyzer.loadCalibration(std::string(inputParam->workDir) + "/calibration.txt") != PoseAnalyzer::RET_OK) {
+		PRINT("Distance is not estimated because calibration data is not found\n");
+	}
+
+	if (inputParam->resultBusName[0] != '\0') {
+		if (s_resultBus.open(inputParam->resultBusName, ResultBus::MODE_WRITE, inputParam->resultBusImageWidth, inputParam->resultBusImageHeight) != ResultBus::RET_OK) {
+			return abortInitialize();
+		}
+		s_resultBusImageSize = cv::Size(inputParam->resultBusImageWidth, inputParam->resultBusImageHeight);
+	}
+
+	if (inputParam->previewPort > 0) {
+		PreviewServer::PARAM previewParam;
+		previewParam.port = inputParam->previewPort;
+		if (s_previewServer.initialize(previewParam) != PreviewServer::RET_OK) {
+			return abortInitialize();
+		}
+	}
+
+	if (inputParam->keypointLogFile[0] != '\0') {
+		if (s_keypointLog.open(inputParam->keypointLogFile, KeypointLog::MODE_WRITE) != KeypointLog::RET_OK) {
+			return abortInitialize();
+		}
+	}
 	return 0;
 }
 
@@ -102,11 +219,25 @@ int32_t ImageProcessor_finalize(void)
 		return -1;
 	}
 
+	stopAsyncThread();
+
+	int32_t ret = 0;
 	if (s_poseEngine->finalize() != PoseEngine::RET_OK) {
-		return -1;
+		ret = -1;
 	}
-
-	return 0;
+	if (s_handEngine.isInitialized()) s_handEngine.finalize();
+	s_operatorLock.printStatistics();
+	if (s_numIdleSkipped > 0) PRINT("Idle: skipped %d frames\n", s_numIdleSkipped);
+	s_keypointLog.close();
+	s_resultBus.close();
+	s_previewServer.finalize();
+	s_commandDecider.printStopStatistics();
+	Config::finalize();
+
+	/* allow to initialize again */
+	s_poseEngine.reset();
+
+	return ret;
 }
 
 
@@ -118,6 +249,12 @@ int32_t ImageProcessor_command(int32_t cmd)
 	}
 
 	switch (cmd) {
+	case IMAGE_PROCESSOR_COMMAND_DUMP_TRACE:
+	{
+		char filename[64];
+		snprintf(filename, sizeof(filename), "trace_%d.json", ++s_numTraceDump);
+		return (Tracer::dump(filename) == Tracer::RET_OK) ? 0 : -1;
+	}
 	case 0:
 	default:
 		PRINT_E("command(%d) is not supported\n", cmd);
@@ -127,14 +264,55 @@ int32_t ImageProcessor_command(int32_t cmd)
 
 
 int32_t ImageProcessor_process(cv::Mat* mat, OUTPUT_PARAM* outputParam)
+{
+	const int64_t tStart = Tracer::now();
+	int32_t ret;
+	{
+		TRACE_SPAN("frame");
+		ret = process(mat, outputParam);
+	}
+
+	/* Dump spans when a frame is slow. not too often, because writing the file makes the next frames slow */
+	const float threshold = Config::get().traceSpikeThreshold;
+	if (Tracer::isEnabled() && threshold > 0) {
+		const int64_t tEnd = Tracer::now();
+		const double frameTime = (tEnd - tStart) / 1000000.0;
+		if (frameTime > threshold && (s_traceDumpTime < 0 || (tEnd - s_traceDumpTime) / 1000000.0 > TRACE_SPIKE_INTERVAL)) {
+			s_traceDumpTime = tEnd;
+			char filename[64];
+			snprintf(filename, sizeof(filename), "trace_spike_%d.json", ++s_numTraceDump);
+			PRINT("Slow frame: %.1f [msec]\n", frameTime);
+			(void)Tracer::dump(filename);
+		}
+	}
+	return ret;
+}
+
+static int32_t process(cv::Mat* mat, OUTPUT_PARAM* outputParam)
 {
 	if (!s_poseEngine) {
 		PRINT_E("Not initialized\n");
 		return -1;
 	}
 
-	/* Run inference */
+	const double timestamp = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count() * 1000.0;
+
 	cv::Mat& originalMat = *mat;
+
+	/* Low-rate idle mode: pose estimation runs only every idleInterval while nobody faces the robot */
+	/* note: no command is decided in a skipped frame, so the last one (stop, by the attention gate) is kept */
+	const CONFIG& config = Config::get();
+	if (s_attentionTime < 0) s_attentionTime = timestamp;
+	const bool isIdle = (config.idleInterval > 0 && timestamp - s_attentionTime > config.idleDelay);
+	if (isIdle && timestamp - s_invokeTime < config.idleInterval) {
+		s_numIdleSkipped++;
+		cv::putText(originalMat, "idle (not attending)", cv::Point(50, 230), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(128, 128, 128), 2);
+		*outputParam = OUTPUT_PARAM();
+		return 0;
+	}
+	s_invokeTime = timestamp;
+
+	/* Run inference */
 	PoseEngine::RESULT result;
 	if (s_poseEngine->invoke(originalMat, result) != PoseEngine::RET_OK) {
 		return -1;
@@ -144,33 +322,274 @@ int32_t ImageProcessor_process(cv::Mat* mat, OUTPUT_PARAM* outputParam)
 	const auto& scoreList = result.poseKeypointScores[0];
 	const auto& jointList = result.poseKeypointCoords[0];
 
+	/* Record keypoints for replay */
+	if (s_keypointLog.isOpened()) {
+		(void)s_keypointLog.write(timestamp, jointList, scoreList);
+	}
+
 	/* Analyze Pose */
+	/* note: joints are extrapolated by the time from the start of the frame to now, if predictionGain is set */
+	const double analyzeTime = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count() * 1000.0;
+	s_poseAnalyzer.setLatency(static_cast<float>(analyzeTime - timestamp));
 	PoseAnalyzer::RESULT poseResult;
-	(void)s_poseAnalyzer.analyze(jointList, scoreList, poseResult);
-	std::string command = s_commandDecider.decide(poseResult);
+	{
+		TRACE_SPAN("analyze");
+		(void)s_poseAnalyzer.analyze(jointList, scoreList, timestamp, poseResult);
+	}
+	HandEngine::RESULT handResult;
+	if (s_handEngine.isInitialized() && !result.isSkipped) {
+		(void)s_handEngine.process(originalMat, jointList, scoreList, handResult);
+		poseResult.fingerCountLeft = handResult.fingerCount[HandEngine::HAND_LEFT];
+		poseResult.fingerCountRight = handResult.fingerCount[HandEngine::HAND_RIGHT];
+	}
+	/* note: the current head direction also counts, because the filtered isAttending follows slowly at the low rate */
+	if (poseResult.isAttending || (poseResult.isHeadFound && std::abs(poseResult.headYaw) < config.attentionYawThreshold)) {
+		s_attentionTime = timestamp;
+	}
+	GestureRecognizer::RESULT gestureResult;
+	OperatorLock::RESULT lockResult;
+	if (s_operatorLock.isEnabled()) {
+		TRACE_SPAN("operatorLock");
+		(void)s_operatorLock.update(originalMat, jointList, scoreList, poseResult.faceScore, timestamp, lockResult);
+	}
+	if (lockResult.isOperator) {
+		TRACE_SPAN("gesture");
+		(void)s_gestureRecognizer.update(jointList, scoreList, gestureResult);
+	} else {
+		/* ignore the other person. the robot behaves as if nobody is in view */
+		PoseAnalyzer::RESULT ignoredResult;
+		ignoredResult.timestamp = poseResult.timestamp;
+		poseResult = ignoredResult;
+		s_gestureRecognizer.reset();
+	}
+	std::string command;
+	{
+		TRACE_SPAN("decide");
+		command = s_commandDecider.decide(poseResult, gestureResult);
+	}
+
+	/* Publish the result to other processes */
+	if (s_resultBus.isOpened()) {
+		TRACE_SPAN("resultBus");
+		ResultBus::FRAME frame;
+		frame.timestamp = timestamp;
+		for (int32_t i = 0; i < ResultBus::NUM_JOINTS && i < static_cast<int32_t>(jointList.size()); i++) {
+			frame.jointX[i] = jointList[i].first;
+			frame.jointY[i] = jointList[i].second;
+			frame.jointScore[i] = scoreList[i];
+		}
+		frame.poseResult = poseResult;
+		frame.gesture = gestureResult.gesture;
+		snprintf(frame.command, sizeof(frame.command), "%s", command.c_str());
+		const uint8_t* image = nullptr;
+		if (s_resultBusImageSize.area() > 0) {
+			cv::resize(originalMat, s_resultBusImage, s_resultBusImageSize, 0, 0, cv::INTER_AREA);
+			image = s_resultBusImage.data;
+		}
+		(void)s_resultBus.write(frame, image);
+	}
 
 	/* Draw the result */
-	drawPose(originalMat, jointList, scoreList);
-
-	char text[32];
-	snprintf(text, sizeof(text), "score = %.3f, x = %.2f", poseResult.faceScore, poseResult.x);
-	cv::putText(originalMat, text, cv::Point(50, 20), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
-	snprintf(text, sizeof(text), "raise = %d %d", poseResult.armLeftRaised, poseResult.armRightRaised);
-	cv::putText(originalMat, text, cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
-	snprintf(text, sizeof(text), "spread = %d %d", poseResult.armLeftSpread, poseResult.armRightSpread);
-	cv::putText(originalMat, text, cv::Point(50, 80), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
-	snprintf(text, sizeof(text), "forward = %d %d", poseResult.armLeftForward, poseResult.armRightForward);
-	cv::putText(originalMat, text, cv::Point(50, 110), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
-	snprintf(text, sizeof(text), "crunching = %d", poseResult.crunching);
-	cv::putText(originalMat, text, cv::Point(50, 140), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
-	cv::putText(originalMat, command.c_str(), cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, createCvColor(255, 0, 0), 2);
+	{
+		TRACE_SPAN("draw");
+		drawPose(originalMat, jointList, scoreList);
+		if (result.regionType != PoseEngine::REGION_FULL) {
+			cv::Rect region(static_cast<int32_t>(result.regionX * originalMat.cols), static_cast<int32_t>(result.regionY * originalMat.rows),
+				static_cast<int32_t>(result.regionWidth * originalMat.cols), static_cast<int32_t>(result.regionHeight * originalMat.rows));
+			cv::rectangle(originalMat, region, (result.regionType == PoseEngine::REGION_TRACK) ? createCvColor(0, 255, 0) : createCvColor(128, 128, 128), 1);
+		}
+		const auto& analyzedJointList = s_poseAnalyzer.getJointList();
+		const auto& jointStateList = s_poseAnalyzer.getJointStateList();
+		for (size_t i = 0; i < jointStateList.size(); i++) {
+			if (jointStateList[i] == KeypointImputer::STATE_IMPUTED) {
+				cv::Point point(static_cast<int32_t>(analyzedJointList[i].first * originalMat.cols), static_cast<int32_t>(analyzedJointList[i].second * originalMat.rows));
+				cv::circle(originalMat, point, 5, createCvColor(0, 255, 255), 2);
+			}
+		}
+
+		char text[64];
+		snprintf(text, sizeof(text), "score = %.3f, x = %.2f, d = %.1f", poseResult.faceScore, poseResult.x, poseResult.distance);
+		cv::putText(originalMat, text, cv::Point(50, 20), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		snprintf(text, sizeof(text), "raise = %d %d", poseResult.armLeftRaised, poseResult.armRightRaised);
+		cv::putText(originalMat, text, cv::Point(50, 50), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		snprintf(text, sizeof(text), "spread = %d %d", poseResult.armLeftSpread, poseResult.armRightSpread);
+		cv::putText(originalMat, text, cv::Point(50, 80), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		snprintf(text, sizeof(text), "forward = %d %d", poseResult.armLeftForward, poseResult.armRightForward);
+		cv::putText(originalMat, text, cv::Point(50, 110), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		snprintf(text, sizeof(text), "crunching = %d, yaw = %.0f%s", poseResult.crunching, poseResult.headYaw, poseResult.isAttending ? "" : " (not attending)");
+		cv::putText(originalMat, text, cv::Point(50, 140), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		snprintf(text, sizeof(text), "gesture = %s", GestureRecognizer::getName(gestureResult.gesture));
+		cv::putText(originalMat, text, cv::Point(50, 170), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		cv::putText(originalMat, command.c_str(), cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, createCvColor(255, 0, 0), 2);
+		if (result.isSkipped) {
+			cv::putText(originalMat, "idle (no person)", cv::Point(50, 230), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(128, 128, 128), 2);
+		}
+		cv::putText(originalMat, PoseEngine::getModelName(result.model), cv::Point(50, 260), cv::FONT_HERSHEY_SIMPLEX, 0.6, createCvColor(128, 128, 128), 1);
+		if (s_handEngine.isInitialized()) {
+			if (handResult.hand >= 0) {
+				cv::Rect region(static_cast<int32_t>(handResult.regionX * originalMat.cols), static_cast<int32_t>(handResult.regionY * originalMat.rows),
+					static_cast<int32_t>(handResult.regionWidth * originalMat.cols), static_cast<int32_t>(handResult.regionHeight * originalMat.rows));
+				cv::rectangle(originalMat, region, createCvColor(255, 0, 255), 1);
+			}
+			snprintf(text, sizeof(text), "finger = %d %d (%.1f ms)", poseResult.fingerCountLeft, poseResult.fingerCountRight, handResult.timeInference);
+			cv::putText(originalMat, text, cv::Point(50, 290), cv::FONT_HERSHEY_SIMPLEX, 0.8, createCvColor(255, 0, 0), 2);
+		}
+
+		if (s_operatorLock.isEnabled()) {
+			if (lockResult.regionWidth > 0) {
+				cv::Rect region(static_cast<int32_t>(lockResult.regionX * originalMat.cols), static_cast<int32_t>(lockResult.regionY * originalMat.rows),
+					static_cast<int32_t>(lockResult.regionWidth * originalMat.cols), static_cast<int32_t>(lockResult.regionHeight * originalMat.rows));
+				cv::rectangle(originalMat, region, lockResult.isOperator ? createCvColor(0, 255, 0) : createCvColor(0, 0, 255), 2);
+			}
+			snprintf(text, sizeof(text), "operator = %s (%.2f)", (lockResult.state == OperatorLock::STATE_LOCKED) ? "locked" : "free", lockResult.similarity);
+			cv::putText(originalMat, text, cv::Point(50, 320), cv::FONT_HERSHEY_SIMPLEX, 0.8, lockResult.isOperator ? createCvColor(255, 0, 0) : createCvColor(0, 0, 255), 2);
+		}
+	}
+
+	/* Send the processed image to preview clients */
+	{
+		TRACE_SPAN("preview");
+		s_previewServer.publish(timestamp, originalMat, jointList, scoreList, command);
+	}
 
 	/* Return the results */
 	outputParam->timePreProcess = result.timePreProcess;
 	outputParam->timeInference = result.timeInference;
 	outputParam->timePostProcess = result.timePostProcess;
 	snprintf(outputParam->command, sizeof(outputParam->command), "%s", command.c_str());
+	outputParam->commandPriority = s_commandDecider.getPriority();
+	outputParam->isPoseValid = (!result.isSkipped && poseResult.faceScore > config.faceScoreThreshold && poseResult.isAttending) ? 1 : 0;
+	outputParam->ticket = 0;
+
+	return 0;
+}
+
+
+static void asyncThread()
+{
+	/* note: the affinity of the thread calling ImageProcessor_submit first is inherited */
+	ThreadPolicy::registerThread("image_processor");
+	cv::Mat mat;
+	while (true) {
+		int32_t ticket;
+		{
+			std::unique_lock<std::mutex> lock(s_asyncMutex);
+			s_asyncRequestCond.wait(lock, [] { return s_asyncPendingTicket > 0 || !s_isAsyncRunning; });
+			if (!s_isAsyncRunning) break;
+			/* note: buffers are swapped, so that they are reused without allocation */
+			cv::swap(mat, s_asyncPendingMat);
+			ticket = s_asyncPendingTicket;
+			s_asyncPendingTicket = 0;
+			s_asyncProcessingTicket = ticket;
+		}
+
+		OUTPUT_PARAM outputParam;
+		const int32_t status = (ImageProcessor_process(&mat, &outputParam) == 0) ? IMAGE_PROCESSOR_DONE : IMAGE_PROCESSOR_ERROR;
+		outputParam.ticket = ticket;
+
+		IMAGE_PROCESSOR_CALLBACK callback;
+		void* userData;
+		{
+			std::lock_guard<std::mutex> lock(s_asyncMutex);
+			cv::swap(mat, s_asyncResultMat);
+			s_asyncResultParam = outputParam;
+			s_asyncResultTicket = ticket;
+			s_asyncResultStatus = status;
+			s_asyncProcessingTicket = 0;
+			callback = s_asyncCallback;
+			userData = s_asyncCallbackUserData;
+			s_asyncResultCond.notify_all();
+		}
+		/* note: s_asyncResultMat is modified only in this thread, so it can be read without lock here */
+		if (callback) callback(status, &s_asyncResultMat, &outputParam, userData);
+	}
+	ThreadPolicy::unregisterThread();
+}
+
+static void stopAsyncThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_asyncMutex);
+		if (!s_isAsyncRunning) return;
+		s_isAsyncRunning = false;
+		s_asyncRequestCond.notify_one();
+		s_asyncResultCond.notify_all();
+	}
+	s_asyncThread.join();
+	PRINT("Async: submitted = %d, dropped = %d\n", s_asyncLastTicket, s_asyncNumDropped);
+
+	s_asyncLastTicket = 0;
+	s_asyncPendingTicket = 0;
+	s_asyncResultTicket = 0;
+	s_asyncNumDropped = 0;
+	s_asyncCallback = nullptr;
+	s_asyncCallbackUserData = nullptr;
+}
 
+/* call with s_asyncMutex locked */
+static int32_t getAsyncStatus(int32_t ticket)
+{
+	if (ticket == IMAGE_PROCESSOR_TICKET_LATEST) {
+		return (s_asyncResultTicket > 0) ? s_asyncResultStatus : IMAGE_PROCESSOR_PENDING;
+	}
+	if (ticket < 0 || ticket > s_asyncLastTicket) return IMAGE_PROCESSOR_ERROR;
+	if (ticket == s_asyncPendingTicket || ticket == s_asyncProcessingTicket) return IMAGE_PROCESSOR_PENDING;
+	if (ticket == s_asyncResultTicket) return s_asyncResultStatus;
+	return IMAGE_PROCESSOR_DROPPED;
+}
+
+/* call with s_asyncMutex locked */
+static void getAsyncResult(cv::Mat* mat, OUTPUT_PARAM* outputParam)
+{
+	if (mat) s_asyncResultMat.copyTo(*mat);
+	if (outputParam) *outputParam = s_asyncResultParam;
+}
+
+int32_t ImageProcessor_submit(const cv::Mat* mat)
+{
+	if (!s_poseEngine) {
+		PRINT_E("Not initialized\n");
+		return -1;
+	}
+	if (mat->empty()) {
+		PRINT_E("Empty image\n");
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(s_asyncMutex);
+	if (!s_isAsyncRunning) {
+		s_isAsyncRunning = true;
+		s_asyncThread = std::thread(asyncThread);
+	}
+	if (s_asyncPendingTicket > 0) s_asyncNumDropped++;
+	mat->copyTo(s_asyncPendingMat);
+	s_asyncPendingTicket = ++s_asyncLastTicket;
+	s_asyncRequestCond.notify_one();
+	return s_asyncPendingTicket;
+}
+
+int32_t ImageProcessor_poll(int32_t ticket, cv::Mat* mat, OUTPUT_PARAM* outputParam)
+{
+	std::lock_guard<std::mutex> lock(s_asyncMutex);
+	const int32_t status = getAsyncStatus(ticket);
+	if (status == IMAGE_PROCESSOR_DONE) getAsyncResult(mat, outputParam);
+	return status;
+}
+
+int32_t ImageProcessor_wait(int32_t ticket, int32_t timeoutMsec, cv::Mat* mat, OUTPUT_PARAM* outputParam)
+{
+	std::unique_lock<std::mutex> lock(s_asyncMutex);
+	s_asyncResultCond.wait_for(lock, std::chrono::milliseconds(timeoutMsec), [ticket] { return getAsyncStatus(ticket) != IMAGE_PROCESSOR_PENDING || !s_isAsyncRunning; });
+	const int32_t status = getAsyncStatus(ticket);
+	if (status == IMAGE_PROCESSOR_DONE) getAsyncResult(mat, outputParam);
+	return status;
+}
+
+int32_t ImageProcessor_setCallback(IMAGE_PROCESSOR_CALLBACK callback, void* userData)
+{
+	std::lock_guard<std::mutex> lock(s_asyncMutex);
+	s_asyncCallback = callback;
+	s_asyncCallbackUserData = userData;
 	return 0;
 }
 
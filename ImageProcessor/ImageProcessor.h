@@ -31,6 +31,19 @@ namespace cv {
 typedef struct {
 	char     workDir[256];
 	int32_t  numThreads;
+	char     keypointLogFile[256];	// record keypoints to this file if not empty
+	int32_t  controlMode;	// 0: discrete, 1: continuous, 2: follow distance (CommandDecider::MODE_xxx)
+	float    targetDistance;	// [m] distance to keep (needs workDir/calibration.txt)
+	int32_t  numWarmup;		// the number of inferences with dummy image at initialization
+	int32_t  scaleMode;		// 0: the whole frame, 1: multi-scale (PoseEngine::SCALE_MODE_xxx)
+	int32_t  usePersonDetector;	// 1: skip pose estimation while the person detector finds nobody
+	char     resultBusName[64];	// publish results to this shared memory (e.g. "/bittle_result_bus") if not empty
+	int32_t  resultBusImageWidth;	// downscaled frame is also published if not 0
+	int32_t  resultBusImageHeight;
+	int32_t  previewPort;		// serve preview at http://127.0.0.1:previewPort if not 0
+	int32_t  useModelLadder;	// 1: load several models and switch them by inference time (inferenceBudget in config)
+	int32_t  useHandEngine;		// 1: count fingers of a raised hand with the hand landmark model (workDir/model/hand_landmark_lite.tflite)
+	int32_t  useOperatorLock;	// 1: accept commands only from the person who took control
 } INPUT_PARAM;
 
 typedef struct {
@@ -38,11 +51,38 @@ typedef struct {
 	double timeInference;    // [msec]
 	double timePostProcess;  // [msec]
 	char   command[32];
+	int32_t commandPriority;	// 0: normal, 1: safety (stop). CommandDecider::PRIORITY_xxx
+	int32_t isPoseValid;		// 1: the person addressing (facing) the robot is found (for watchdog)
+	int32_t ticket;			// ticket returned by ImageProcessor_submit (0 for ImageProcessor_process)
 } OUTPUT_PARAM;
 
+/* cmd of ImageProcessor_command */
+enum {
+	IMAGE_PROCESSOR_COMMAND_DUMP_TRACE = 1,	// write spans of the recent frames to trace_N.json (needs ENABLE_TRACE)
+};
+
+/* status of asynchronous processing */
+enum {
+	IMAGE_PROCESSOR_DONE = 0,
+	IMAGE_PROCESSOR_ERROR = -1,
+	IMAGE_PROCESSOR_PENDING = 1,	// waiting or being processed
+	IMAGE_PROCESSOR_DROPPED = 2,	// replaced by a newer frame before processed, or the result is overwritten by a newer one
+};
+#define IMAGE_PROCESSOR_TICKET_LATEST 0
+
+/* called in the worker thread when a submitted frame is processed. mat and outputParam are valid only in the callback */
+typedef void (*IMAGE_PROCESSOR_CALLBACK)(int32_t status, const cv::Mat* mat, const OUTPUT_PARAM* outputParam, void* userData);
+
 int32_t ImageProcessor_initialize(const INPUT_PARAM* inputParam);
 int32_t ImageProcessor_process(cv::Mat* mat, OUTPUT_PARAM* outputParam);
 int32_t ImageProcessor_finalize(void);
 int32_t ImageProcessor_command(int32_t cmd);
 
+/* Asynchronous API. Don't mix with ImageProcessor_process */
+/* at most one frame waits while another is processed. the waiting frame is replaced by a newly submitted one */
+int32_t ImageProcessor_submit(const cv::Mat* mat);	// returns ticket (> 0), or -1. the image is copied
+int32_t ImageProcessor_poll(int32_t ticket, cv::Mat* mat, OUTPUT_PARAM* outputParam);	// IMAGE_PROCESSOR_TICKET_LATEST for the latest result. mat/outputParam can be nullptr
+int32_t ImageProcessor_wait(int32_t ticket, int32_t timeoutMsec, cv::Mat* mat, OUTPUT_PARAM* outputParam);
+int32_t ImageProcessor_setCallback(IMAGE_PROCESSOR_CALLBACK callback, void* userData);
+
 #endif
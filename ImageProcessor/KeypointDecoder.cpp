@@ -0,0 +1,167 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* for SIMD */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define KEYPOINT_DECODER_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEYPOINT_DECODER_SSE
+#endif
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "KeypointDecoder.h"
+
+/*** Macro ***/
+#define TAG "KeypointDecoder"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t KeypointDecoder::initialize(int32_t layout, int32_t maxPersonNum)
+{
+	if ((layout != LAYOUT_SINGLEPOSE && layout != LAYOUT_MULTIPOSE) || maxPersonNum <= 0 || (layout == LAYOUT_SINGLEPOSE && maxPersonNum != 1)) {
+		PRINT_E("Invalid layout (%d, %d)\n", layout, maxPersonNum);
+		return RET_ERR;
+	}
+	m_layout = layout;
+	m_maxPersonNum = maxPersonNum;
+	m_personNum = 0;
+	m_xList.assign(maxPersonNum * NUM_JOINTS, 0);
+	m_yList.assign(maxPersonNum * NUM_JOINTS, 0);
+	m_scoreList.assign(maxPersonNum * NUM_JOINTS, 0);
+	m_validMaskList.assign(maxPersonNum, 0);
+	m_personScoreList.assign(maxPersonNum, 0);
+	return RET_OK;
+}
+
+void KeypointDecoder::decodePersonScore(const float* data)
+{
+	for (int32_t person = 0; person < m_personNum; person++) {
+		m_personScoreList[person] = (m_layout == LAYOUT_MULTIPOSE) ? data[person * MULTIPOSE_STRIDE + NUM_JOINTS * 3 + 4] : 1.0f;
+	}
+}
+
+int32_t KeypointDecoder::decodeScalar(const float* data, int32_t personNum, const ROI& roi, float thresholdScore)
+{
+	if (personNum < 0 || personNum > m_maxPersonNum) {
+		PRINT_E("Invalid person num (%d)\n", personNum);
+		return RET_ERR;
+	}
+	m_personNum = personNum;
+	const int32_t stride = getStride();
+	for (int32_t person = 0; person < personNum; person++) {
+		const float* src = data + person * stride;
+		float* x = &m_xList[person * NUM_JOINTS];
+		float* y = &m_yList[person * NUM_JOINTS];
+		float* score = &m_scoreList[person * NUM_JOINTS];
+		uint32_t validMask = 0;
+		for (int32_t joint = 0; joint < NUM_JOINTS; joint++) {
+			y[joint] = roi.y + src[joint * 3 + 0] * roi.height;
+			x[joint] = roi.x + src[joint * 3 + 1] * roi.width;
+			score[joint] = src[joint * 3 + 2];
+			if (score[joint] > thresholdScore) validMask |= 1u << joint;
+		}
+		m_validMaskList[person] = validMask;
+	}
+	decodePersonScore(data);
+	return RET_OK;
+}
+
+int32_t KeypointDecoder::decode(const float* data, int32_t personNum, const ROI& roi, float thresholdScore)
+{
+#if defined(KEYPOINT_DECODER_NEON) || defined(KEYPOINT_DECODER_SSE)
+	if (personNum < 0 || personNum > m_maxPersonNum) {
+		PRINT_E("Invalid person num (%d)\n", personNum);
+		return RET_ERR;
+	}
+	m_personNum = personNum;
+	const int32_t stride = getStride();
+	constexpr int32_t NUM_VECTOR_JOINTS = NUM_JOINTS / 4 * 4;
+#if defined(KEYPOINT_DECODER_NEON)
+	const float32x4_t offsetX = vdupq_n_f32(roi.x);
+	const float32x4_t offsetY = vdupq_n_f32(roi.y);
+	const float32x4_t scaleX = vdupq_n_f32(roi.width);
+	const float32x4_t scaleY = vdupq_n_f32(roi.height);
+	const float32x4_t threshold = vdupq_n_f32(thresholdScore);
+	static const uint32_t BIT_LIST[4] = { 1, 2, 4, 8 };
+	const uint32x4_t bit = vld1q_u32(BIT_LIST);
+#else
+	const __m128 offsetX = _mm_set1_ps(roi.x);
+	const __m128 offsetY = _mm_set1_ps(roi.y);
+	const __m128 scaleX = _mm_set1_ps(roi.width);
+	const __m128 scaleY = _mm_set1_ps(roi.height);
+	const __m128 threshold = _mm_set1_ps(thresholdScore);
+#endif
+
+	for (int32_t person = 0; person < personNum; person++) {
+		const float* src = data + person * stride;
+		float* x = &m_xList[person * NUM_JOINTS];
+		float* y = &m_yList[person * NUM_JOINTS];
+		float* score = &m_scoreList[person * NUM_JOINTS];
+		uint32_t validMask = 0;
+		int32_t joint = 0;
+		for (; joint < NUM_VECTOR_JOINTS; joint += 4) {
+#if defined(KEYPOINT_DECODER_NEON)
+			/* deinterleave 4 joints (y, x, score) x 4 */
+			float32x4x3_t yxs = vld3q_f32(src + joint * 3);
+			vst1q_f32(y + joint, vmlaq_f32(offsetY, yxs.val[0], scaleY));
+			vst1q_f32(x + joint, vmlaq_f32(offsetX, yxs.val[1], scaleX));
+			vst1q_f32(score + joint, yxs.val[2]);
+			uint32x4_t bits = vandq_u32(vcgtq_f32(yxs.val[2], threshold), bit);
+			uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+			validMask |= vget_lane_u32(vpadd_u32(sum, sum), 0) << joint;
+#else
+			/* deinterleave 4 joints. a = (y0 x0 s0 y1), b = (x1 s1 y2 x2), c = (s2 y3 x3 s3) */
+			const __m128 a = _mm_loadu_ps(src + joint * 3 + 0);
+			const __m128 b = _mm_loadu_ps(src + joint * 3 + 4);
+			const __m128 c = _mm_loadu_ps(src + joint * 3 + 8);
+			const __m128 b2c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+			const __m128 vy = _mm_shuffle_ps(a, b2c1, _MM_SHUFFLE(2, 0, 3, 0));
+			const __m128 a1b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+			const __m128 b3c2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+			const __m128 vx = _mm_shuffle_ps(a1b0, b3c2, _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 a2b1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+			const __m128 c0c3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+			const __m128 vs = _mm_shuffle_ps(a2b1, c0c3, _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(y + joint, _mm_add_ps(offsetY, _mm_mul_ps(vy, scaleY)));
+			_mm_storeu_ps(x + joint, _mm_add_ps(offsetX, _mm_mul_ps(vx, scaleX)));
+			_mm_storeu_ps(score + joint, vs);
+			validMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpgt_ps(vs, threshold))) << joint;
+#endif
+		}
+		for (; joint < NUM_JOINTS; joint++) {
+			y[joint] = roi.y + src[joint * 3 + 0] * roi.height;
+			x[joint] = roi.x + src[joint * 3 + 1] * roi.width;
+			score[joint] = src[joint * 3 + 2];
+			if (score[joint] > thresholdScore) validMask |= 1u << joint;
+		}
+		m_validMaskList[person] = validMask;
+	}
+	decodePersonScore(data);
+	return RET_OK;
+#else
+	return decodeScalar(data, personNum, roi, thresholdScore);
+#endif
+}
@@ -0,0 +1,83 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef KEYPOINT_DECODER_
+#define KEYPOINT_DECODER_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* Decode the output tensor of MoveNet into SoA (x, y, score) arrays */
+/* note: deinterleave, ROI inverse transform and threshold mask are done in one pass with SIMD (NEON / SSE2), with scalar fallback */
+/*       storage is allocated at initialize() and reused for every frame */
+class KeypointDecoder {
+public:
+	static constexpr int32_t NUM_JOINTS = 17;
+	static constexpr int32_t SINGLEPOSE_STRIDE = NUM_JOINTS * 3;			// [1][1][17][3] (y, x, score)
+	static constexpr int32_t MULTIPOSE_STRIDE = NUM_JOINTS * 3 + 5;		// [1][6][56] (y, x, score) x 17 + (ymin, xmin, ymax, xmax, score)
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	enum {
+		LAYOUT_SINGLEPOSE = 0,
+		LAYOUT_MULTIPOSE,
+	};
+
+	/* Region in the original image (normalized) which is fed to the model */
+	typedef struct ROI_ {
+		float x;
+		float y;
+		float width;
+		float height;
+		ROI_() : x(0), y(0), width(1.0f), height(1.0f)
+		{}
+		ROI_(float _x, float _y, float _width, float _height) : x(_x), y(_y), width(_width), height(_height)
+		{}
+	} ROI;
+
+public:
+	KeypointDecoder() : m_layout(LAYOUT_SINGLEPOSE), m_maxPersonNum(0), m_personNum(0) {}
+	~KeypointDecoder() {}
+	int32_t initialize(int32_t layout, int32_t maxPersonNum);
+	int32_t decode(const float* data, int32_t personNum, const ROI& roi, float thresholdScore);
+	int32_t decodeScalar(const float* data, int32_t personNum, const ROI& roi, float thresholdScore);	// reference implementation
+
+	int32_t      getPersonNum() const { return m_personNum; }
+	float        getPersonScore(int32_t person) const { return m_personScoreList[person]; }
+	const float* getX(int32_t person) const { return &m_xList[person * NUM_JOINTS]; }
+	const float* getY(int32_t person) const { return &m_yList[person * NUM_JOINTS]; }
+	const float* getScore(int32_t person) const { return &m_scoreList[person * NUM_JOINTS]; }
+	uint32_t     getValidMask(int32_t person) const { return m_validMaskList[person]; }	// bit n is set if score of joint n > threshold
+
+private:
+	int32_t getStride() const { return (m_layout == LAYOUT_MULTIPOSE) ? MULTIPOSE_STRIDE : SINGLEPOSE_STRIDE; }
+	void    decodePersonScore(const float* data);
+
+private:
+	int32_t m_layout;
+	int32_t m_maxPersonNum;
+	int32_t m_personNum;
+	std::vector<float>    m_xList;			// [person * NUM_JOINTS + joint]
+	std::vector<float>    m_yList;
+	std::vector<float>    m_scoreList;
+	std::vector<uint32_t> m_validMaskList;	// [person]
+	std::vector<float>    m_personScoreList;	// [person]
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "KeypointImputer.h"
+
+/*** Macro ***/
+#define TAG "KeypointImputer"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+#define VELOCITY_FILTER_COEFF 0.5f
+
+/* Torso is regarded as a parallelogram. {target, base, the other side of target, the other side of base} */
+/* e.g. right hip = right sholder + (left hip - left sholder) */
+static const std::vector<std::array<int32_t, 4>> TORSO_LIST = {
+    {12, 6, 11, 5},
+    {11, 5, 12, 6},
+    {6, 12, 5, 11},
+    {5, 11, 6, 12},
+};
+
+/*** Function ***/
+void KeypointImputer::reset()
+{
+    m_trackList.clear();
+}
+
+int32_t KeypointImputer::impute(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, double timestamp,
+    std::vector<std::pair<float, float>>& imputedJointList, std::vector<float>& imputedScoreList, std::vector<int32_t>& stateList)
+{
+    const size_t jointNum = jointList.size();
+    if (m_trackList.size() != jointNum) {
+        m_trackList.assign(jointNum, TRACK());
+    }
+
+    imputedJointList = jointList;
+    imputedScoreList = scoreList;
+    stateList.assign(jointNum, STATE_MISSING);
+    int32_t numReal = 0;
+    for (size_t i = 0; i < jointNum; i++) {
+        if (scoreList[i] > m_thresholdScore) {
+            stateList[i] = STATE_REAL;
+            numReal++;
+        }
+    }
+    updateTrack(jointList, stateList, timestamp);
+
+    /* the person is not here. don't create a ghost */
+    if (numReal < MIN_REAL_JOINTS) {
+        return RET_OK;
+    }
+
+    /*** Impute from the previous position and velocity ***/
+    const float imputedScore = std::nextafter(m_thresholdScore, 1.0f);
+    for (size_t i = 0; i < jointNum; i++) {
+        const TRACK& track = m_trackList[i];
+        if (stateList[i] != STATE_MISSING || !track.isValid || track.numLostFrame > MAX_IMPUTE_FRAMES) continue;
+        const float dt = static_cast<float>(timestamp - track.timestamp);
+        imputedJointList[i].first = track.position.first + track.velocity.first * dt;
+        imputedJointList[i].second = track.position.second + track.velocity.second * dt;
+        imputedScoreList[i] = imputedScore;
+        stateList[i] = STATE_IMPUTED;
+    }
+
+    /*** Impute torso using the other side ***/
+    for (const auto& torso : TORSO_LIST) {
+        if (stateList[torso[0]] != STATE_MISSING) continue;
+        if (stateList[torso[1]] != STATE_REAL || stateList[torso[2]] != STATE_REAL || stateList[torso[3]] != STATE_REAL) continue;
+        imputedJointList[torso[0]].first = jointList[torso[1]].first + (jointList[torso[2]].first - jointList[torso[3]].first);
+        imputedJointList[torso[0]].second = jointList[torso[1]].second + (jointList[torso[2]].second - jointList[torso[3]].second);
+        imputedScoreList[torso[0]] = imputedScore;
+        stateList[torso[0]] = STATE_IMPUTED;
+    }
+
+    return RET_OK;
+}
+
+std::pair<float, float> KeypointImputer::getVelocity(size_t index) const
+{
+    if (index >= m_trackList.size()) return std::pair<float, float>(0, 0);
+    const TRACK& track = m_trackList[index];
+    if (!track.isValid || track.numLostFrame > MAX_IMPUTE_FRAMES) return std::pair<float, float>(0, 0);
+    return track.velocity;
+}
+
+void KeypointImputer::updateTrack(const std::vector<std::pair<float, float>>& jointList, const std::vector<int32_t>& stateList, double timestamp)
+{
+    for (size_t i = 0; i < jointList.size(); i++) {
+        TRACK& track = m_trackList[i];
+        if (stateList[i] != STATE_REAL) {
+            track.numLostFrame++;
+            continue;
+        }
+        /* velocity is calculated only from consecutive real positions */
+        const float dt = static_cast<float>(timestamp - track.timestamp);
+        if (track.isValid && track.numLostFrame == 0 && dt > 0) {
+            const float vx = (jointList[i].first - track.position.first) / dt;
+            const float vy = (jointList[i].second - track.position.second) / dt;
+            track.velocity.first = VELOCITY_FILTER_COEFF * track.velocity.first + (1 - VELOCITY_FILTER_COEFF) * vx;
+            track.velocity.second = VELOCITY_FILTER_COEFF * track.velocity.second + (1 - VELOCITY_FILTER_COEFF) * vy;
+        } else {
+            track.velocity = std::pair<float, float>(0, 0);
+        }
+        track.position = jointList[i];
+        track.timestamp = timestamp;
+        track.numLostFrame = 0;
+        track.isValid = true;
+    }
+}
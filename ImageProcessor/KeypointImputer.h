@@ -0,0 +1,73 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef KEYPOINT_IMPUTER_
+#define KEYPOINT_IMPUTER_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/* Fill joints with low score using the velocity of the previous frames and skeletal constraints */
+/* Imputed joints get the score just above the threshold so that they are regarded as valid, but weakest */
+class KeypointImputer {
+public:
+	static constexpr int32_t MAX_IMPUTE_FRAMES = 5;		// don't extrapolate a joint lost longer than this
+	static constexpr int32_t MIN_REAL_JOINTS = 5;		// don't impute if the person is not in the frame
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	enum {
+		STATE_MISSING = 0,
+		STATE_REAL,
+		STATE_IMPUTED,
+	};
+
+private:
+	typedef struct TRACK_ {
+		std::pair<float, float> position;	// the last real position
+		std::pair<float, float> velocity;	// [/msec]
+		double  timestamp;		// [msec] when the last real position is observed
+		int32_t numLostFrame;
+		bool    isValid;
+		TRACK_() : position(0, 0), velocity(0, 0), timestamp(0), numLostFrame(0), isValid(false) {}
+	} TRACK;
+
+public:
+	KeypointImputer(float thresholdScore)
+		: m_thresholdScore(thresholdScore)
+	{}
+	~KeypointImputer() {}
+	void    setThresholdScore(float thresholdScore) { m_thresholdScore = thresholdScore; }
+	int32_t impute(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, double timestamp,
+		std::vector<std::pair<float, float>>& imputedJointList, std::vector<float>& imputedScoreList, std::vector<int32_t>& stateList);
+	void    reset();
+	/* [/msec] velocity of the joint estimated from consecutive real positions. (0, 0) if unknown or lost too long */
+	std::pair<float, float> getVelocity(size_t index) const;
+
+private:
+	void    updateTrack(const std::vector<std::pair<float, float>>& jointList, const std::vector<int32_t>& stateList, double timestamp);
+
+private:
+	float m_thresholdScore;
+	std::vector<TRACK> m_trackList;
+};
+
+#endif
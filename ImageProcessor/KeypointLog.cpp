@@ -0,0 +1,98 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "KeypointLog.h"
+
+/*** Macro ***/
+#define TAG "KeypointLog"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t KeypointLog::open(const std::string& filename, int32_t mode)
+{
+    close();
+    if (mode == MODE_READ) {
+        m_ifs.open(filename);
+    } else {
+        m_ofs.open(filename);
+    }
+    if (!isOpened()) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return RET_ERR;
+    }
+    return RET_OK;
+}
+
+void KeypointLog::close()
+{
+    if (m_ifs.is_open()) m_ifs.close();
+    if (m_ofs.is_open()) m_ofs.close();
+}
+
+bool KeypointLog::isOpened() const
+{
+    return m_ifs.is_open() || m_ofs.is_open();
+}
+
+int32_t KeypointLog::write(double timestamp, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList)
+{
+    if (!m_ofs.is_open()) {
+        return RET_ERR;
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", timestamp);
+    m_ofs << buffer;
+    for (size_t i = 0; i < jointList.size(); i++) {
+        snprintf(buffer, sizeof(buffer), " %.5f %.5f %.4f", jointList[i].first, jointList[i].second, scoreList[i]);
+        m_ofs << buffer;
+    }
+    m_ofs << "\n";
+    return RET_OK;
+}
+
+int32_t KeypointLog::read(double& timestamp, std::vector<std::pair<float, float>>& jointList, std::vector<float>& scoreList)
+{
+    if (!m_ifs.is_open()) {
+        return RET_ERR;
+    }
+    std::string line;
+    while (std::getline(m_ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        iss >> timestamp;
+        jointList.clear();
+        scoreList.clear();
+        float x, y, score;
+        while (iss >> x >> y >> score) {
+            jointList.push_back(std::pair<float, float>(x, y));
+            scoreList.push_back(score);
+        }
+        return RET_OK;
+    }
+    return RET_EOF;
+}
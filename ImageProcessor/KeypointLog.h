@@ -0,0 +1,54 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef KEYPOINT_LOG_
+#define KEYPOINT_LOG_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+/* Record / replay a keypoint stream as text */
+/* format: one frame per line. "timestamp[msec] x0 y0 score0 x1 y1 score1 ..." */
+class KeypointLog {
+public:
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+		RET_EOF = -2,
+	};
+
+	enum {
+		MODE_READ = 0,
+		MODE_WRITE,
+	};
+
+public:
+	KeypointLog() {}
+	~KeypointLog() {}
+	int32_t open(const std::string& filename, int32_t mode);
+	void    close();
+	bool    isOpened() const;
+	int32_t write(double timestamp, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList);
+	int32_t read(double& timestamp, std::vector<std::pair<float, float>>& jointList, std::vector<float>& scoreList);
+
+private:
+	std::ifstream m_ifs;
+	std::ofstream m_ofs;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "KeypointImputer.h"
+#include "KeypointPredictor.h"
+
+/*** Macro ***/
+#define TAG "KeypointPredictor"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t KeypointPredictor::predict(const KeypointImputer& keypointImputer, const std::vector<int32_t>& stateList, float predictionTime,
+	std::vector<std::pair<float, float>>& jointList)
+{
+	if (jointList.size() != stateList.size()) {
+		PRINT_E("Invalid joint num\n");
+		return RET_ERR;
+	}
+
+	const float maxTime = MAX_PREDICTION_TIME;	// note: copy not to odr-use the member by std::min
+	predictionTime = (std::min)(predictionTime, maxTime);
+	if (predictionTime <= 0) return RET_OK;
+
+	for (size_t i = 0; i < jointList.size(); i++) {
+		/* note: an imputed joint uses the velocity before it's lost */
+		if (stateList[i] == KeypointImputer::STATE_MISSING) continue;
+		const std::pair<float, float> velocity = keypointImputer.getVelocity(i);
+		float dx = velocity.first * predictionTime;
+		float dy = velocity.second * predictionTime;
+		const float shift = std::sqrt(dx * dx + dy * dy);
+		if (shift > MAX_SHIFT) {
+			dx *= MAX_SHIFT / shift;
+			dy *= MAX_SHIFT / shift;
+		}
+		jointList[i].first = (std::max)(0.0f, (std::min)(1.0f, jointList[i].first + dx));
+		jointList[i].second = (std::max)(0.0f, (std::min)(1.0f, jointList[i].second + dy));
+	}
+	return RET_OK;
+}
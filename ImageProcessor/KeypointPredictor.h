@@ -0,0 +1,48 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef KEYPOINT_PREDICTOR_
+#define KEYPOINT_PREDICTOR_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "KeypointImputer.h"
+
+/* Extrapolate joints to compensate the pipeline latency (capture + inference + command), using the velocity tracked by KeypointImputer */
+/* so that the pose is evaluated where the person is now rather than where the person was in the frame */
+class KeypointPredictor {
+public:
+	static constexpr float MAX_PREDICTION_TIME = 500.0f;	// [msec] don't extrapolate too far
+	static constexpr float MAX_SHIFT = 0.15f;				// max displacement (normalized by image size) to limit a wrong velocity (e.g. swapped joints)
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+public:
+	KeypointPredictor() {}
+	~KeypointPredictor() {}
+	/* keypointImputer: updated with the current frame, stateList: KeypointImputer::STATE_xxx, predictionTime: [msec] (0 = do nothing) */
+	/* jointList: joints not missing are moved by velocity * predictionTime (the imputed joint list) */
+	int32_t predict(const KeypointImputer& keypointImputer, const std::vector<int32_t>& stateList, float predictionTime,
+		std::vector<std::pair<float, float>>& jointList);
+};
+
+#endif
@@ -0,0 +1,280 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+
+/* for SIMD */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OPERATOR_LOCK_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OPERATOR_LOCK_SSE
+#endif
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "Config.h"
+#include "OperatorLock.h"
+
+/*** Macro ***/
+#define TAG "OperatorLock"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+#define IS_VALID(index) (static_cast<size_t>(index) < scoreList.size() && scoreList[index] > thresholdScore)
+
+/* Torso region. the margin excludes arms and background around the body */
+#define TORSO_MARGIN_X         0.2f		// of sholder width, from each side
+#define TORSO_MARGIN_Y         0.1f		// of sholder to waist, from each side
+#define TORSO_HEIGHT_RATIO     1.2f		// sholder to waist = sholder width * ratio, when the waist is not visible
+#define MIN_REGION_SIZE        8		// [px]
+#define CHUNK_SIZE             256		// [px] a row is quantized by this size
+
+/*** Function ***/
+void OperatorLock::reset()
+{
+	m_state = STATE_UNLOCKED;
+	m_numAcquireFrame = 0;
+	m_numReleaseFrame = 0;
+	m_lastSeenTime = 0;
+	m_releaseTime = -1;
+}
+
+void OperatorLock::printStatistics() const
+{
+	if (m_numSignature == 0) return;
+	PRINT("Signature: %d times, %.3f (max %.3f) [msec]\n", m_numSignature, m_sumTimeSignature / m_numSignature, m_maxTimeSignature);
+}
+
+bool OperatorLock::getTorsoRegion(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float thresholdScore, cv::Rect& region)
+{
+	if (!IS_VALID(5) || !IS_VALID(6)) return false;
+
+	const float x0 = (std::min)(jointList[5].first, jointList[6].first) * originalMat.cols;
+	const float x1 = (std::max)(jointList[5].first, jointList[6].first) * originalMat.cols;
+	const float y0 = (jointList[5].second + jointList[6].second) / 2 * originalMat.rows;
+	float y1 = y0 + (x1 - x0) * TORSO_HEIGHT_RATIO;
+	if (IS_VALID(11) && IS_VALID(12)) {
+		y1 = (jointList[11].second + jointList[12].second) / 2 * originalMat.rows;
+	}
+	const float marginX = (x1 - x0) * TORSO_MARGIN_X;
+	const float marginY = (y1 - y0) * TORSO_MARGIN_Y;
+
+	region = cv::Rect(static_cast<int32_t>(x0 + marginX), static_cast<int32_t>(y0 + marginY),
+		static_cast<int32_t>(x1 - x0 - marginX * 2), static_cast<int32_t>(y1 - y0 - marginY * 2));
+	region &= cv::Rect(0, 0, originalMat.cols, originalMat.rows);
+	return region.width >= MIN_REGION_SIZE && region.height >= MIN_REGION_SIZE;
+}
+
+/* bin = (c0 / 64) * 16 + (c1 / 64) * 4 + (c2 / 64) */
+void OperatorLock::quantizeRow(const uint8_t* src, int32_t width, uint8_t* binList)
+{
+	int32_t x = 0;
+#if defined(OPERATOR_LOCK_NEON)
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16x3_t c = vld3q_u8(src + x * 3);
+		const uint8x16_t c0 = vshlq_n_u8(vshrq_n_u8(c.val[0], 6), 4);
+		const uint8x16_t c1 = vshlq_n_u8(vshrq_n_u8(c.val[1], 6), 2);
+		const uint8x16_t c2 = vshrq_n_u8(c.val[2], 6);
+		vst1q_u8(binList + x, vorrq_u8(vorrq_u8(c0, c1), c2));
+	}
+#elif defined(OPERATOR_LOCK_SSE)
+	/* 16 pixels (48 bytes) are 3 vectors. the channel of each byte is fixed in each vector, so it's selected by mask */
+	/* then 3 bytes of a pixel are ORed into the first byte of the pixel */
+	static const uint8_t CHANNEL_LIST[48] = {
+		0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0,
+		1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1,
+		2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2,
+	};
+	__m128i mask[3][3];
+	for (int32_t k = 0; k < 3; k++) {
+		const __m128i channel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(CHANNEL_LIST + k * 16));
+		for (int32_t c = 0; c < 3; c++) {
+			mask[c][k] = _mm_cmpeq_epi8(channel, _mm_set1_epi8(static_cast<char>(c)));
+		}
+	}
+	const __m128i bits0 = _mm_set1_epi8(0x30);
+	const __m128i bits1 = _mm_set1_epi8(0x0C);
+	const __m128i bits2 = _mm_set1_epi8(0x03);
+	uint8_t combined[48];
+	for (; x + 16 <= width; x += 16) {
+		__m128i code[3];
+		for (int32_t k = 0; k < 3; k++) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3 + k * 16));
+			const __m128i c0 = _mm_and_si128(_mm_and_si128(_mm_srli_epi16(v, 2), bits0), mask[0][k]);
+			const __m128i c1 = _mm_and_si128(_mm_and_si128(_mm_srli_epi16(v, 4), bits1), mask[1][k]);
+			const __m128i c2 = _mm_and_si128(_mm_and_si128(_mm_srli_epi16(v, 6), bits2), mask[2][k]);
+			code[k] = _mm_or_si128(_mm_or_si128(c0, c1), c2);
+		}
+		for (int32_t k = 0; k < 3; k++) {
+			const __m128i next = (k < 2) ? code[k + 1] : _mm_setzero_si128();
+			const __m128i shift1 = _mm_or_si128(_mm_srli_si128(code[k], 1), _mm_slli_si128(next, 15));
+			const __m128i shift2 = _mm_or_si128(_mm_srli_si128(code[k], 2), _mm_slli_si128(next, 14));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(combined + k * 16), _mm_or_si128(_mm_or_si128(code[k], shift1), shift2));
+		}
+		for (int32_t i = 0; i < 16; i++) {
+			binList[x + i] = combined[i * 3];
+		}
+	}
+#endif
+	for (; x < width; x++) {
+		const uint8_t* c = src + x * 3;
+		binList[x] = static_cast<uint8_t>(((c[0] >> 6) << 4) | ((c[1] >> 6) << 2) | (c[2] >> 6));
+	}
+}
+
+int32_t OperatorLock::computeSignature(const cv::Mat& originalMat, const cv::Rect& region, SIGNATURE& signature)
+{
+	if (originalMat.type() != CV_8UC3 || region.width <= 0 || region.height <= 0
+		|| (region & cv::Rect(0, 0, originalMat.cols, originalMat.rows)) != region) {
+		PRINT_E("Invalid image or region\n");
+		return RET_ERR;
+	}
+
+	/* note: rows are sampled, but all the pixels in a row are used so that SIMD can load them continuously */
+	std::array<uint32_t, NUM_BINS> countList;
+	countList.fill(0);
+	uint8_t binList[CHUNK_SIZE];
+	const int32_t maxRows = MAX_ROWS;	// note: copy not to odr-use the member by std::min
+	const int32_t numRows = (std::min)(region.height, maxRows);
+	for (int32_t i = 0; i < numRows; i++) {
+		const int32_t y = region.y + static_cast<int32_t>(static_cast<int64_t>(i) * region.height / numRows);
+		const uint8_t* src = originalMat.ptr<uint8_t>(y) + region.x * 3;
+		for (int32_t x = 0; x < region.width; x += CHUNK_SIZE) {
+			const int32_t width = (std::min)(region.width - x, CHUNK_SIZE);
+			quantizeRow(src + x * 3, width, binList);
+			for (int32_t j = 0; j < width; j++) {
+				countList[binList[j]]++;
+			}
+		}
+	}
+
+	const float scale = 1.0f / (static_cast<float>(numRows) * region.width);
+	for (int32_t bin = 0; bin < NUM_BINS; bin++) {
+		signature.histogram[bin] = countList[bin] * scale;
+	}
+	return RET_OK;
+}
+
+float OperatorLock::compare(const SIGNATURE& signature0, const SIGNATURE& signature1)
+{
+	float sum = 0;
+	for (int32_t bin = 0; bin < NUM_BINS; bin++) {
+		sum += std::sqrt(signature0.histogram[bin] * signature1.histogram[bin]);
+	}
+	return sum;
+}
+
+/* arms are crossed in front of the chest: the wrists are below the sholders, and their left / right are swapped */
+bool OperatorLock::isReleasePose(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float thresholdScore)
+{
+	if (!IS_VALID(5) || !IS_VALID(6) || !IS_VALID(9) || !IS_VALID(10)) return false;
+
+	const float sholderWidth = std::abs(jointList[5].first - jointList[6].first);
+	const float sholderY = (std::max)(jointList[5].second, jointList[6].second);
+	const float xMin = (std::min)(jointList[5].first, jointList[6].first) - sholderWidth / 2;
+	const float xMax = (std::max)(jointList[5].first, jointList[6].first) + sholderWidth / 2;
+	for (int32_t index : { 9, 10 }) {
+		if (jointList[index].second < sholderY || jointList[index].first < xMin || jointList[index].first > xMax) return false;
+	}
+	return (jointList[9].first - jointList[10].first) * (jointList[5].first - jointList[6].first) < 0;
+}
+
+int32_t OperatorLock::update(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float faceScore, double timestamp, RESULT& result)
+{
+	result = RESULT();
+	if (!m_isEnabled) return RET_OK;
+
+	const CONFIG& config = Config::get();
+
+	/*** Signature of the current pose ***/
+	SIGNATURE signature;
+	bool hasSignature = false;
+	cv::Rect region;
+	if (getTorsoRegion(originalMat, jointList, scoreList, config.thresholdScore, region)) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		hasSignature = (computeSignature(originalMat, region, signature) == RET_OK);
+		const auto& t1 = std::chrono::steady_clock::now();
+		result.timeSignature = static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+		m_numSignature++;
+		m_sumTimeSignature += result.timeSignature;
+		m_maxTimeSignature = (std::max)(m_maxTimeSignature, result.timeSignature);
+		result.regionX = static_cast<float>(region.x) / originalMat.cols;
+		result.regionY = static_cast<float>(region.y) / originalMat.rows;
+		result.regionWidth = static_cast<float>(region.width) / originalMat.cols;
+		result.regionHeight = static_cast<float>(region.height) / originalMat.rows;
+	}
+
+	if (m_state == STATE_UNLOCKED) {
+		/*** Acquire: the person faces the robot for a while ***/
+		bool isCandidate = hasSignature && faceScore > config.faceScoreThreshold;
+		if (m_releaseTime >= 0 && timestamp - m_releaseTime > config.operatorTimeout * 1000.0) {
+			m_releaseTime = -1;
+		}
+		if (isCandidate && m_releaseTime >= 0) {
+			result.similarity = compare(m_releasedSignature, signature);
+			if (result.similarity >= config.operatorMatchThreshold) isCandidate = false;
+		}
+		m_numAcquireFrame = isCandidate ? m_numAcquireFrame + 1 : 0;
+		if (m_numAcquireFrame >= config.operatorAcquireFrames) {
+			m_state = STATE_LOCKED;
+			m_signature = signature;
+			m_lastSeenTime = timestamp;
+			m_releaseTime = -1;
+			m_numAcquireFrame = 0;
+			m_numReleaseFrame = 0;
+			PRINT("Locked to the operator\n");
+		}
+		result.isOperator = true;
+	} else {
+		/*** Accept the pose only if it looks like the operator ***/
+		result.similarity = hasSignature ? compare(m_signature, signature) : -1;
+		result.isOperator = (result.similarity >= config.operatorMatchThreshold);
+		if (result.isOperator) {
+			m_lastSeenTime = timestamp;
+			for (int32_t bin = 0; bin < NUM_BINS; bin++) {
+				m_signature.histogram[bin] += (signature.histogram[bin] - m_signature.histogram[bin]) * config.operatorUpdateRate;
+			}
+			m_numReleaseFrame = isReleasePose(jointList, scoreList, config.thresholdScore) ? m_numReleaseFrame + 1 : 0;
+			if (m_numReleaseFrame >= config.operatorReleaseFrames) {
+				m_state = STATE_UNLOCKED;
+				m_releasedSignature = m_signature;
+				m_releaseTime = timestamp;
+				m_numAcquireFrame = 0;
+				PRINT("Released by the operator\n");
+			}
+		} else if (timestamp - m_lastSeenTime > config.operatorTimeout * 1000.0) {
+			m_state = STATE_UNLOCKED;
+			m_numAcquireFrame = 0;
+			PRINT("Released because the operator is not seen for %.0f [sec]\n", config.operatorTimeout);
+		}
+	}
+	result.state = m_state;
+	return RET_OK;
+}
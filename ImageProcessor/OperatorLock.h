@@ -0,0 +1,105 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef OPERATOR_LOCK_
+#define OPERATOR_LOCK_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* Accept commands only from the person who took control (operator) */
+/* The operator is identified by a color histogram of the torso (between sholders and waist), which is computed when control is acquired. */
+/* Poses of the other persons are ignored until the operator releases control by crossing arms in front of the chest */
+/* note: quantization of pixels is done with SIMD (NEON / SSE2), with scalar fallback. a signature costs a few tens of usec (torso of 200 x 300 px) */
+class OperatorLock {
+public:
+	static constexpr int32_t NUM_BINS = 64;		// 4 levels x 3 channels
+	static constexpr int32_t MAX_ROWS = 48;		// rows of the torso used for a signature (sampled at even intervals)
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	enum {
+		STATE_UNLOCKED = 0,	// anyone can control. control is acquired by facing the robot for operatorAcquireFrames
+		STATE_LOCKED,
+	};
+
+	/* Appearance signature. histogram is normalized (sum = 1) */
+	typedef struct SIGNATURE_ {
+		std::array<float, NUM_BINS> histogram;
+		SIGNATURE_()
+		{
+			histogram.fill(0);
+		}
+	} SIGNATURE;
+
+	typedef struct RESULT_ {
+		int32_t state;				// STATE_xxx
+		bool    isOperator;			// commands from the current pose are accepted (always true while unlocked)
+		float   similarity;			// 0 - 1.0 to the operator. -1 if not compared
+		float   regionX;			// torso used for the signature (0 - 1.0). width = 0 if the torso is not found
+		float   regionY;
+		float   regionWidth;
+		float   regionHeight;
+		double  timeSignature;		// [msec]
+		RESULT_() : state(STATE_UNLOCKED), isOperator(true), similarity(-1), regionX(0), regionY(0), regionWidth(0), regionHeight(0), timeSignature(0)
+		{}
+	} RESULT;
+
+public:
+	OperatorLock() : m_isEnabled(false), m_state(STATE_UNLOCKED), m_numAcquireFrame(0), m_numReleaseFrame(0), m_lastSeenTime(0), m_releaseTime(-1)
+		, m_numSignature(0), m_sumTimeSignature(0), m_maxTimeSignature(0) {}
+	~OperatorLock() {}
+	void    setEnabled(bool isEnabled) { m_isEnabled = isEnabled; reset(); }
+	bool    isEnabled() const { return m_isEnabled; }
+	int32_t update(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float faceScore, double timestamp, RESULT& result);
+	void    reset();
+	void    printStatistics() const;
+
+	/* public for Tools/MicroBenchmark */
+	static int32_t computeSignature(const cv::Mat& originalMat, const cv::Rect& region, SIGNATURE& signature);	// originalMat is CV_8UC3
+	static float   compare(const SIGNATURE& signature0, const SIGNATURE& signature1);	// Bhattacharyya coefficient (1.0 = same)
+	static bool    getTorsoRegion(const cv::Mat& originalMat, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float thresholdScore, cv::Rect& region);
+
+private:
+	static void quantizeRow(const uint8_t* src, int32_t width, uint8_t* binList);
+	static bool isReleasePose(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float thresholdScore);
+
+private:
+	bool      m_isEnabled;
+	int32_t   m_state;
+	SIGNATURE m_signature;		// of the operator. updated slowly while the operator is seen, to follow lighting change
+	SIGNATURE m_releasedSignature;	// the last operator can't take control again until operatorTimeout passes
+	int32_t   m_numAcquireFrame;
+	int32_t   m_numReleaseFrame;
+	double    m_lastSeenTime;	// [msec] the operator is seen
+	double    m_releaseTime;	// [msec] -1 if not released
+
+	/* statistics of computeSignature */
+	int32_t   m_numSignature;
+	double    m_sumTimeSignature;	// [msec]
+	double    m_maxTimeSignature;	// [msec]
+};
+
+#endif
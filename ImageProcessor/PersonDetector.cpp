@@ -0,0 +1,77 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "PersonDetector.h"
+
+/*** Macro ***/
+#define TAG "PersonDetector"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+int32_t PersonDetector::initialize()
+{
+	m_hog.setSVMDetector(cv::HOGDescriptor::getDefaultPeopleDetector());
+	return RET_OK;
+}
+
+int32_t PersonDetector::detect(const cv::Mat& originalMat, int32_t detectWidth, float thresholdScore, RESULT& result)
+{
+	if (m_hog.svmDetector.empty()) {
+		PRINT_E("Not initialized\n");
+		return RET_ERR;
+	}
+	if (detectWidth < m_hog.winSize.width) {
+		PRINT_E("Invalid width (%d)\n", detectWidth);
+		return RET_ERR;
+	}
+	const auto& t0 = std::chrono::steady_clock::now();
+
+	const int32_t detectHeight = originalMat.rows * detectWidth / originalMat.cols;
+	cv::resize(originalMat, m_resizedMat, cv::Size(detectWidth, detectHeight), 0, 0, cv::INTER_AREA);
+	cv::cvtColor(m_resizedMat, m_grayMat, cv::COLOR_BGR2GRAY);
+
+	std::vector<cv::Rect> boxList;
+	std::vector<double> weightList;
+	m_hog.detectMultiScale(m_grayMat, boxList, weightList, 0, cv::Size(8, 8), cv::Size(8, 8), 1.1);
+
+	result = RESULT();
+	for (size_t i = 0; i < boxList.size() && i < weightList.size(); i++) {
+		if (weightList[i] > thresholdScore && weightList[i] > result.score) {
+			result.isDetected = true;
+			result.score = static_cast<float>(weightList[i]);
+			result.x = static_cast<float>(boxList[i].x) / m_grayMat.cols;
+			result.y = static_cast<float>(boxList[i].y) / m_grayMat.rows;
+			result.width = static_cast<float>(boxList[i].width) / m_grayMat.cols;
+			result.height = static_cast<float>(boxList[i].height) / m_grayMat.rows;
+		}
+	}
+
+	const auto& t1 = std::chrono::steady_clock::now();
+	result.timeDetection = static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+	return RET_OK;
+}
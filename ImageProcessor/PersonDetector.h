@@ -0,0 +1,60 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef PERSON_DETECTOR_
+#define PERSON_DETECTOR_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* Cheap person detector (HOG + linear SVM on a downscaled gray frame) to check if someone is in view before running pose estimation */
+class PersonDetector {
+public:
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	typedef struct RESULT_ {
+		bool   isDetected;
+		float  x;				// bounding box of the most confident person (0 - 1.0)
+		float  y;
+		float  width;
+		float  height;
+		float  score;			// SVM weight
+		double timeDetection;	// [msec]
+		RESULT_() : isDetected(false), x(0), y(0), width(0), height(0), score(0), timeDetection(0)
+		{}
+	} RESULT;
+
+public:
+	PersonDetector() {}
+	~PersonDetector() {}
+	int32_t initialize();
+	/* frame is resized to detectWidth. a person shorter than 128 px (HOG window) in the resized frame is not detected */
+	/* e.g. 320 px wide for 640x480 frame: 53 % of the frame height, 640 px: 27 % */
+	int32_t detect(const cv::Mat& originalMat, int32_t detectWidth, float thresholdScore, RESULT& result);
+
+private:
+	cv::HOGDescriptor m_hog;
+	cv::Mat m_resizedMat;	// reused to avoid allocation
+	cv::Mat m_grayMat;
+};
+
+#endif
@@ -16,6 +16,7 @@ limitations under the License.
 /*** Include ***/
 /* for general */
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cmath>
 #include <cstring>
@@ -35,9 +36,16 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
-#define THRESHOLD_SCORE 0.2f
+/* depth of the nose from the line of eyes / ears, relative to half of the distance between them */
+#define HEAD_EYE_DEPTH_RATIO  0.8f
+#define HEAD_EAR_DEPTH_RATIO  1.3f
+
+#define THRESHOLD_SCORE  (m_config.thresholdScore)
 #define GET_X_POS(index) ((scoreList[index] < THRESHOLD_SCORE) ? -1 : jointList[index].first)
 #define GET_Y_POS(index) ((scoreList[index] < THRESHOLD_SCORE) ? -1 : jointList[index].second)
+/* real: the joint is detected. valid: the joint is detected or imputed */
+#define IS_REAL(index)   (m_jointStateList[index] == KeypointImputer::STATE_REAL)
+#define IS_VALID(index)  (m_jointStateList[index] != KeypointImputer::STATE_MISSING)
 
 static const std::vector<std::pair<int32_t, int32_t>> ARM_LIST = {
     {10, 8},
@@ -54,39 +62,67 @@ static const std::vector<std::pair<int32_t, int32_t>> BODY_LIST = {
 };
 
 /*** Function ***/
-int32_t PoseAnalyzer::analyze(const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList, RESULT& result)
+int32_t PoseAnalyzer::analyze(const std::vector<std::pair<float, float>> rawJointList, std::vector<float> rawScoreList, double timestamp, RESULT& result)
 {
     RESULT currentResult;
+    currentResult.timestamp = timestamp;
+
+    /* use the same config during the frame */
+    m_config = Config::get();
+
+    /*** Fill occluded joints ***/
+    m_keypointImputer.setThresholdScore(m_config.thresholdScore);
+    (void)m_keypointImputer.impute(rawJointList, rawScoreList, timestamp, m_jointList, m_scoreList, m_jointStateList);
+
+    /*** Predict where the joints are now ***/
+    const float predictionTime = m_config.predictionGain * (m_latency + m_config.predictionLatency);
+    (void)m_keypointPredictor.predict(m_keypointImputer, m_jointStateList, predictionTime, m_jointList);
+    const auto& jointList = m_jointList;
+    const auto& scoreList = m_scoreList;
 
     float armLength = calcualteAverageLength(jointList, scoreList, ARM_LIST);
     float bodyLength = calcualteAverageLength(jointList, scoreList, BODY_LIST);
+
+    /*** Estimate body size ***/
+    /* use body, or use arm with the ratio learned while both of them appear */
+    if (bodyLength > 0) {
+        currentResult.bodySize = bodyLength;
+        if (armLength > 0) {
+            m_armToBodyRatio = 0.9f * m_armToBodyRatio + 0.1f * (bodyLength / armLength);
+        }
+    } else if (armLength > 0) {
+        currentResult.bodySize = armLength * m_armToBodyRatio;
+    }
+
     if (armLength < 0) armLength = bodyLength;
     if (bodyLength < 0) bodyLength = armLength;
-    const float armDistanceThreshold = armLength / 3;
-    const float bodyDistanceThreshold = bodyLength / 2;
+    const float armDistanceThreshold = armLength * m_config.armDistanceRatio;
+    const float bodyDistanceThreshold = bodyLength * m_config.bodyDistanceRatio;
+
+    /* note: the joint which moves to make a pose must be real. the reference joints (sholder, elbow, waist) may be imputed */
 
     /*** Check arm raised ***/
     /* hand comes above sholder */
-    if ((scoreList[10] > THRESHOLD_SCORE && scoreList[8] > THRESHOLD_SCORE && scoreList[6] > THRESHOLD_SCORE)
+    if ((IS_REAL(10) && IS_VALID(8) && IS_VALID(6))
         && (GET_Y_POS(10) + armDistanceThreshold < GET_Y_POS(6))) {
         currentResult.armLeftRaised = true;
     }
 
-    if ((scoreList[9] > THRESHOLD_SCORE && scoreList[7] > THRESHOLD_SCORE && scoreList[5] > THRESHOLD_SCORE)
+    if ((IS_REAL(9) && IS_VALID(7) && IS_VALID(5))
         && (GET_Y_POS(9) + armDistanceThreshold < GET_Y_POS(5))) {
         currentResult.armRightRaised = true;
     }
 
     /*** Check arm spread ***/
     /* the distance b/w hand and sholder is big */
-    if ((scoreList[10] > THRESHOLD_SCORE && scoreList[8] > THRESHOLD_SCORE && scoreList[6] > THRESHOLD_SCORE)
+    if ((IS_REAL(10) && IS_VALID(8) && IS_VALID(6))
         && (GET_X_POS(10) + armDistanceThreshold < GET_X_POS(8))
         && (GET_X_POS(8) + armDistanceThreshold < GET_X_POS(6))
         ) {
         currentResult.armLeftSpread = true;
     }
 
-    if ((scoreList[9] > THRESHOLD_SCORE && scoreList[7] > THRESHOLD_SCORE && scoreList[5] > THRESHOLD_SCORE)
+    if ((IS_REAL(9) && IS_VALID(7) && IS_VALID(5))
         && (GET_X_POS(9) > GET_X_POS(7) + armDistanceThreshold)
         && (GET_X_POS(7) > GET_X_POS(5) + armDistanceThreshold)
         ) {
@@ -95,12 +131,12 @@ int32_t PoseAnalyzer::analyze(const std::vector<std::pair<float, float>> jointLi
 
     /*** Check arm forward ***/
     /* the distance b/w hand and sholder is small */
-    if ((scoreList[10] > THRESHOLD_SCORE && scoreList[6] > THRESHOLD_SCORE)
+    if ((IS_REAL(10) && IS_VALID(6))
         && ((std::abs)(GET_Y_POS(10) - GET_Y_POS(6)) < bodyDistanceThreshold && (std::abs)(GET_X_POS(10) - GET_X_POS(6)) < bodyDistanceThreshold)) {
         currentResult.armLeftForward = true;
     }
 
-    if ((scoreList[9] > THRESHOLD_SCORE && scoreList[5] > THRESHOLD_SCORE)
+    if ((IS_REAL(9) && IS_VALID(5))
         && ((std::abs)(GET_Y_POS(9) - GET_Y_POS(5)) < bodyDistanceThreshold && (std::abs)(GET_X_POS(9) - GET_X_POS(5)) < bodyDistanceThreshold)) {
         currentResult.armRightForward = true;
     }
@@ -108,24 +144,38 @@ int32_t PoseAnalyzer::analyze(const std::vector<std::pair<float, float>> jointLi
     /*** Check crunching ***/
     /* knee comes above the waist */
     /* lower parts of leg don't appear */
-    float waistY = -1;
-    if (scoreList[12] > THRESHOLD_SCORE) {
-        waistY = GET_Y_POS(12);
+    /* don't check if waist is unknown */
+    float waistY = 0;
+    int32_t numWaist = 0;
+    if (IS_VALID(12)) {
+        waistY += GET_Y_POS(12);
+        numWaist++;
     }
-    
-    if (scoreList[11] > THRESHOLD_SCORE) {
+    if (IS_VALID(11)) {
         waistY += GET_Y_POS(11);
-        waistY /= 2;
+        numWaist++;
     }
-    if ( ((scoreList[14] > THRESHOLD_SCORE) && (GET_Y_POS(14) < waistY + bodyDistanceThreshold))
-        || ((scoreList[13] > THRESHOLD_SCORE) && (GET_Y_POS(13) < waistY + bodyDistanceThreshold))
-        /* || (scoreList[13] + scoreList[14] + scoreList[15] + scoreList[16] < 4 * THRESHOLD_SCORE * 0.8f)*/ ) {
-        currentResult.crunching = true;
+    if (numWaist > 0) {
+        waistY /= numWaist;
+        if ((IS_REAL(14) && (GET_Y_POS(14) < waistY + bodyDistanceThreshold))
+            || (IS_REAL(13) && (GET_Y_POS(13) < waistY + bodyDistanceThreshold))
+            /* || (scoreList[13] + scoreList[14] + scoreList[15] + scoreList[16] < 4 * THRESHOLD_SCORE * 0.8f)*/ ) {
+            currentResult.crunching = true;
+        }
     }
 
     /*** Check score ***/
     /* use the current score of nose */
-    currentResult.faceScore = scoreList[0];
+    currentResult.faceScore = rawScoreList[0];
+
+    /*** Estimate head orientation ***/
+    /* use the raw joints because imputed face joints don't follow the head turning */
+    currentResult.isHeadFound = estimateHeadYaw(rawJointList, rawScoreList, currentResult.headYaw);
+    if (m_config.attentionYawThreshold <= 0) {
+        currentResult.isAttending = true;
+    } else {
+        currentResult.isAttending = currentResult.isHeadFound && std::abs(currentResult.headYaw) < m_config.attentionYawThreshold;
+    }
 
     /*** Calclate face position [-1, 1] ***/
     /* use nose if it appears */
@@ -155,11 +205,12 @@ int32_t PoseAnalyzer::analyze(const std::vector<std::pair<float, float>> jointLi
 void PoseAnalyzer::filterResult(const RESULT& currentResult, RESULT& result)
 {
     m_resultList.push_back(currentResult);
-    if (m_resultList.size() > NUM_FILTERING) {
+    while (m_resultList.size() > static_cast<size_t>(m_config.poseFilteringNum)) {
         m_resultList.pop_front();
     }
 
-    const int32_t NUM_THRESHOLD = static_cast<int32_t>(m_resultList.size() * 0.8);
+    /* note: at least one vote is needed (with poseFilteringNum = 1, the threshold becomes 0) */
+    const int32_t NUM_THRESHOLD = (std::max)(1, static_cast<int32_t>(m_resultList.size() * 0.8));
     int32_t numArmLeftRaised = 0;
     int32_t numArmRightRaised = 0;
     int32_t numArmLeftSpread = 0;
@@ -167,6 +218,7 @@ void PoseAnalyzer::filterResult(const RESULT& currentResult, RESULT& result)
     int32_t numArmLeftForward = 0;
     int32_t numArmRightForward = 0;
     int32_t numCrunching = 0;
+    int32_t numAttending = 0;
     float avgFaceScore = 0;
 
     for (const auto& r : m_resultList) {
@@ -177,6 +229,7 @@ void PoseAnalyzer::filterResult(const RESULT& currentResult, RESULT& result)
         if (r.armLeftForward) numArmLeftForward++;
         if (r.armRightForward) numArmRightForward++;
         if (r.crunching) numCrunching++;
+        if (r.isAttending) numAttending++;
         avgFaceScore += r.faceScore;
     }
 
@@ -187,10 +240,95 @@ void PoseAnalyzer::filterResult(const RESULT& currentResult, RESULT& result)
     if (numArmLeftForward >= NUM_THRESHOLD) result.armLeftForward = true;
     if (numArmRightForward >= NUM_THRESHOLD) result.armRightForward = true;
     if (numCrunching >= NUM_THRESHOLD) result.crunching = true;
+    if (numAttending >= NUM_THRESHOLD) result.isAttending = true;
     result.faceScore = avgFaceScore / m_resultList.size();
 
     result.x = currentResult.x;
     result.y = currentResult.y;
+    result.headYaw = currentResult.headYaw;
+    result.isHeadFound = currentResult.isHeadFound;
+    result.timestamp = currentResult.timestamp;
+
+    /* use median of body size to ignore a wrong frame */
+    std::vector<float> bodySizeList;
+    for (const auto& r : m_resultList) {
+        if (r.bodySize > 0) bodySizeList.push_back(r.bodySize);
+    }
+    if (bodySizeList.size() > 0) {
+        auto median = bodySizeList.begin() + bodySizeList.size() / 2;
+        std::nth_element(bodySizeList.begin(), median, bodySizeList.end());
+        result.bodySize = *median;
+        if (m_calibrationCoeff > 0) {
+            result.distance = m_calibrationCoeff / result.bodySize;
+        }
+    }
+}
+
+/* The nose moves from the center of eyes (or ears) by depth * sin(yaw), while the half of the distance between them looks half * cos(yaw) */
+/* So yaw = atan(offset / (half * HEAD_xxx_DEPTH_RATIO)). ears are preferred because they are farther apart */
+/* If only one ear is visible, the head is regarded as turned aside */
+bool PoseAnalyzer::estimateHeadYaw(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float& yaw) const
+{
+    yaw = 0;
+    if (GET_X_POS(0) < 0) return false;
+    const float noseX = GET_X_POS(0);
+    const float leftEyeX = GET_X_POS(1);
+    const float rightEyeX = GET_X_POS(2);
+    const float leftEarX = GET_X_POS(3);
+    const float rightEarX = GET_X_POS(4);
+
+    float centerX;
+    float depth;
+    if (leftEarX >= 0 && rightEarX >= 0) {
+        centerX = (leftEarX + rightEarX) / 2;
+        depth = std::abs(leftEarX - rightEarX) / 2 * HEAD_EAR_DEPTH_RATIO;
+    } else if (leftEyeX >= 0 && rightEyeX >= 0) {
+        centerX = (leftEyeX + rightEyeX) / 2;
+        depth = std::abs(leftEyeX - rightEyeX) / 2 * HEAD_EYE_DEPTH_RATIO;
+    } else if (leftEarX >= 0 || rightEarX >= 0) {
+        const float earX = (leftEarX >= 0) ? leftEarX : rightEarX;
+        yaw = (noseX > earX) ? 90.0f : -90.0f;
+        return true;
+    } else {
+        return false;
+    }
+    yaw = static_cast<float>(std::atan2(noseX - centerX, depth) * 180.0 / 3.14159265358979);
+    return true;
+}
+
+int32_t PoseAnalyzer::loadCalibration(const std::string& filename)
+{
+    std::ifstream ifs(filename);
+    if (!ifs.is_open()) {
+        return RET_ERR;
+    }
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        float bodySize = 0;
+        float distance = 0;
+        if (sscanf(line.c_str(), "%f %f", &bodySize, &distance) != 2 || bodySize <= 0 || distance <= 0) {
+            PRINT_E("Invalid calibration data: %s\n", line.c_str());
+            return RET_ERR;
+        }
+        setCalibration(bodySize, distance);
+        PRINT("Calibration: bodySize = %.3f at %.2f [m]\n", bodySize, distance);
+        return RET_OK;
+    }
+    return RET_ERR;
+}
+
+int32_t PoseAnalyzer::saveCalibration(const std::string& filename, float bodySize, float distance)
+{
+    std::ofstream ofs(filename);
+    if (!ofs.is_open()) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return RET_ERR;
+    }
+    ofs << "# bodySize distance[m]\n";
+    ofs << bodySize << " " << distance << "\n";
+    setCalibration(bodySize, distance);
+    return RET_OK;
 }
 
 float PoseAnalyzer::calculateLength(const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList, int32_t index0, int32_t index1)
@@ -20,15 +20,18 @@ limitations under the License.
 #include <cstdint>
 #include <cmath>
 #include <string>
+#include <vector>
 #include <deque>
 #include <array>
 #include <memory>
 
+#include "Config.h"
+#include "KeypointImputer.h"
+#include "KeypointPredictor.h"
+
 class PoseAnalyzer {
 
 public:
-	static constexpr int32_t NUM_FILTERING = 10;
-
 	enum {
 		RET_OK = 0,
 		RET_ERR = -1,
@@ -46,6 +49,14 @@ public:
 		float x;	// -1.0 ~ 0.0(center) ~ 1.0
 		float y;	// -1.0 ~ 0.0(center) ~ 1.0
 		float faceScore;
+		float headYaw;		// [deg] -90 (turned to the left of the image) ~ 0 (facing the camera) ~ 90. current frame. 0 if !isHeadFound
+		bool  isHeadFound;	// head orientation is estimated in the current frame
+		bool  isAttending;	// the person faces the camera (|headYaw| < attentionYawThreshold). always true if attentionYawThreshold = 0
+		float bodySize;		// average length of body parts (normalized by image size). -1 if not found
+		float distance;		// [m] estimated from bodySize. -1 if unknown (not calibrated)
+		double timestamp;	// [msec]
+		int32_t fingerCountLeft;	// 0 - 5 of the raised hand, by HandEngine. -1 if not estimated
+		int32_t fingerCountRight;
 		RESULT_()
 			: armLeftRaised(false)
 			, armRightRaised(false)
@@ -57,22 +68,56 @@ public:
 			, x(0)
 			, y(0)
 			, faceScore(0)
+			, headYaw(0)
+			, isHeadFound(false)
+			, isAttending(false)
+			, bodySize(-1)
+			, distance(-1)
+			, timestamp(0)
+			, fingerCountLeft(-1)
+			, fingerCountRight(-1)
 		{}
 	} RESULT;
 
 public:
-	PoseAnalyzer() {}
+	PoseAnalyzer()
+		: m_keypointImputer(m_config.thresholdScore)
+		, m_armToBodyRatio(1.5f)
+		, m_calibrationCoeff(-1)
+		, m_latency(0)
+	{}
 	~PoseAnalyzer() {}
 	
-	int32_t analyze(const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList, PoseAnalyzer::RESULT& result);
+	int32_t loadCalibration(const std::string& filename);
+	int32_t saveCalibration(const std::string& filename, float bodySize, float distance);
+	void    setCalibration(float bodySize, float distance) { m_calibrationCoeff = bodySize * distance; }
+	/* [msec] latency measured until the analysis. joints are extrapolated by predictionGain * (latency + predictionLatency) */
+	void    setLatency(float latency) { m_latency = latency; }
+	int32_t analyze(const std::vector<std::pair<float, float>> rawJointList, std::vector<float> rawScoreList, double timestamp, PoseAnalyzer::RESULT& result);
+
+	/* keypoints used for the last analysis. low score joints may be imputed, and joints may be predicted */
+	const std::vector<std::pair<float, float>>& getJointList() const { return m_jointList; }
+	const std::vector<int32_t>& getJointStateList() const { return m_jointStateList; }
+
+	/* majority vote over the last poseFilteringNum results. called by analyze (public for Tools/MicroBenchmark) */
+	void  filterResult(const PoseAnalyzer::RESULT& currentResult, PoseAnalyzer::RESULT& result);
 
 private:
+	bool  estimateHeadYaw(const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, float& yaw) const;
 	float calculateLength(const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList, int32_t index0, int32_t index1);
 	float calcualteAverageLength(const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList, std::vector<std::pair<int32_t, int32_t>> indexPairList);
-	void  filterResult(const PoseAnalyzer::RESULT& currentResult, PoseAnalyzer::RESULT& result);
 
 private:
+	CONFIG m_config;	// snapshot of Config for the current frame
 	std::deque<RESULT> m_resultList;
+	KeypointImputer m_keypointImputer;
+	KeypointPredictor m_keypointPredictor;
+	std::vector<std::pair<float, float>> m_jointList;
+	std::vector<float> m_scoreList;
+	std::vector<int32_t> m_jointStateList;	// KeypointImputer::STATE_xxx
+	float m_armToBodyRatio;		// to estimate body size from arm when body doesn't appear
+	float m_calibrationCoeff;	// distance = coeff / bodySize
+	float m_latency;			// [msec]
 };
 
 #endif
@@ -26,13 +26,24 @@ limitations under the License.
 #include <chrono>
 #include <fstream>
 
+/* for mmap */
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
 
 /* for My modules */
 #include "CommonHelper.h"
 #include "InferenceHelper.h"
+#include "Config.h"
+#include "KeypointDecoder.h"
 #include "PoseEngine.h"
+#include "Tracer.h"
 
 /*** Macro ***/
 #define TAG "PoseEngine"
@@ -40,44 +51,85 @@ limitations under the License.
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
 /* Model parameters */
-#if 1
-/* Official model. https://tfhub.dev/google/lite-model/movenet/singlepose/lightning/3 */
-#define MODEL_NAME  "lite-model_movenet_singlepose_lightning_3.tflite"
-#define INPUT_NAME  "serving_default_input:0"
-#define OUTPUT_NAME "StatefulPartitionedCall:0"
-#define TENSORTYPE  TensorInfo::TENSOR_TYPE_FP32
-#else
-/* PINTO_model_zoo. https://github.com/PINTO0309/PINTO_model_zoo */
-#define MODEL_NAME  "model_float32.tflite"
-// #define MODEL_NAME  "model_weight_quant.tflite"
-// #define MODEL_NAME  "model_integer_quant.tflite"
-#define INPUT_NAME  "input:0"
-#define OUTPUT_NAME "Identity:0"
-#define TENSORTYPE  TensorInfo::TENSOR_TYPE_FP32
-#endif
+/* Official models. https://tfhub.dev/google/movenet/singlepose/ */
+/* note: PINTO_model_zoo models (https://github.com/PINTO0309/PINTO_model_zoo) can be used by changing the names ("input:0", "Identity:0") */
+typedef struct {
+	const char* name;
+	const char* filename;
+	const char* inputName;
+	const char* outputName;
+	int32_t     inputSize;
+	int32_t     inputType;
+} MODEL_INFO;
+
+static const std::array<MODEL_INFO, PoseEngine::MODEL_NUM> MODEL_INFO_LIST = { {
+	{ "thunder_fp32",   "lite-model_movenet_singlepose_thunder_3.tflite",              "serving_default_input:0", "StatefulPartitionedCall:0", 256, TensorInfo::TENSOR_TYPE_FP32 },
+	{ "lightning_fp32", "lite-model_movenet_singlepose_lightning_3.tflite",            "serving_default_input:0", "StatefulPartitionedCall:0", 192, TensorInfo::TENSOR_TYPE_FP32 },
+	{ "lightning_int8", "lite-model_movenet_singlepose_lightning_tflite_int8_4.tflite", "serving_default_input:0", "StatefulPartitionedCall:0", 192, TensorInfo::TENSOR_TYPE_UINT8 },
+} };
+
+/* for model ladder */
+#define LADDER_WINDOW          30		// [frame]
+#define LADDER_UPGRADE_RATIO   0.8f		// switch to the more accurate model if its estimated p95 is lower than budget * this
+#define LADDER_MAX_BACKOFF     32		// the wait before upgrading is doubled when upgrading fails, up to LADDER_WINDOW * this
+
+/* for SCALE_MODE_MULTI */
+#define NUM_TILES              3
+#define TILE_SIZE_RATIO        (2.0f / 3)	// tile size / min(width, height). 2/3 of 480 = 320 px, 1.7x resolution of the whole frame
+#define MIN_PRESENCE_JOINTS    6
+#define TRACK_MARGIN           1.5f
+#define TRACK_MIN_SIZE_RATIO   0.3f			// too small region doesn't improve accuracy
 
 /*** Function ***/
-int32_t PoseEngine::initialize(const std::string& workDir, const int32_t numThreads)
+int32_t PoseEngine::initialize(const std::string& workDir, const int32_t numThreads, bool useModelLadder)
 {
+	m_isLadderEnabled = useModelLadder;
+	m_modelIndex = -1;
+	for (int32_t model = 0; model < MODEL_NUM; model++) {
+		if (!useModelLadder && model != MODEL_LIGHTNING_FP32) continue;
+		if (initializeModel(model, workDir, numThreads) != RET_OK) {
+			if (!useModelLadder) return RET_ERR;
+			PRINT("Model ladder: %s is skipped\n", MODEL_INFO_LIST[model].name);
+			continue;
+		}
+		if (m_modelIndex < 0 || model == MODEL_LIGHTNING_FP32) m_modelIndex = model;
+	}
+	if (m_modelIndex < 0) {
+		PRINT_E("No model is loaded\n");
+		return RET_ERR;
+	}
+
+	if (m_keypointDecoder.initialize(KeypointDecoder::LAYOUT_SINGLEPOSE, 1) != KeypointDecoder::RET_OK) {
+		return RET_ERR;
+	}
+	return RET_OK;
+}
+
+int32_t PoseEngine::initializeModel(int32_t model, const std::string& workDir, const int32_t numThreads)
+{
+	const auto& tInitialize0 = std::chrono::steady_clock::now();
+	const MODEL_INFO& info = MODEL_INFO_LIST[model];
+	MODEL& target = m_modelList[model];
+
 	/* Set model information */
-	std::string modelFilename = workDir + "/model/" + MODEL_NAME;
+	std::string modelFilename = workDir + "/model/" + info.filename;
+	if (!std::ifstream(modelFilename)) {
+		PRINT("Model is not found: %s\n", modelFilename.c_str());
+		return RET_ERR;
+	}
+	preloadFile(modelFilename);
+	const auto& tPreload1 = std::chrono::steady_clock::now();
 
 	/* Set input tensor info */
-	m_inputTensorList.clear();
+	target.inputTensorList.clear();
 	InputTensorInfo inputTensorInfo;
-	inputTensorInfo.name = INPUT_NAME;
-	inputTensorInfo.tensorType = TENSORTYPE;
+	inputTensorInfo.name = info.inputName;
+	inputTensorInfo.tensorType = info.inputType;
 	inputTensorInfo.tensorDims.batch = 1;
-	inputTensorInfo.tensorDims.width = 192;
-	inputTensorInfo.tensorDims.height = 192;
+	inputTensorInfo.tensorDims.width = info.inputSize;
+	inputTensorInfo.tensorDims.height = info.inputSize;
 	inputTensorInfo.tensorDims.channel = 3;
 	inputTensorInfo.dataType = InputTensorInfo::DATA_TYPE_IMAGE;
-	// inputTensorInfo.normalize.mean[0] = 0.485f;   	/* https://github.com/onnx/models/tree/master/vision/classification/mobilenet#preprocessing */
-	// inputTensorInfo.normalize.mean[1] = 0.456f;
-	// inputTensorInfo.normalize.mean[2] = 0.406f;
-	// inputTensorInfo.normalize.norm[0] = 0.229f;
-	// inputTensorInfo.normalize.norm[1] = 0.224f;
-	// inputTensorInfo.normalize.norm[2] = 0.225f;
 	/* 0 - 255 (https://tfhub.dev/google/lite-model/movenet/singlepose/lightning/3) */
 	inputTensorInfo.normalize.mean[0] = 0;
 	inputTensorInfo.normalize.mean[1] = 0;
@@ -85,71 +137,384 @@ int32_t PoseEngine::initialize(const std::string& workDir, const int32_t numThre
 	inputTensorInfo.normalize.norm[0] = 1/255.f;
 	inputTensorInfo.normalize.norm[1] = 1/255.f;
 	inputTensorInfo.normalize.norm[2] = 1/255.f;
-	m_inputTensorList.push_back(inputTensorInfo);
+	target.inputTensorList.push_back(inputTensorInfo);
 
 	/* Set output tensor info */
-	m_outputTensorList.clear();
+	target.outputTensorList.clear();
 	OutputTensorInfo outputTensorInfo;
-	outputTensorInfo.tensorType = TENSORTYPE;
-	outputTensorInfo.name = OUTPUT_NAME;
-	m_outputTensorList.push_back(outputTensorInfo);
+	outputTensorInfo.tensorType = TensorInfo::TENSOR_TYPE_FP32;
+	outputTensorInfo.name = info.outputName;
+	target.outputTensorList.push_back(outputTensorInfo);
 
 	/* Create and Initialize Inference Helper */
-	// m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE));
-	m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_XNNPACK));
-	// m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_GPU));
-	// m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_EDGETPU));
-	// m_inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_NNAPI));
+	// target.inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE));
+	target.inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_XNNPACK));
+	// target.inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_GPU));
+	// target.inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_EDGETPU));
+	// target.inferenceHelper.reset(InferenceHelper::create(InferenceHelper::TENSORFLOW_LITE_NNAPI));
 
-	if (!m_inferenceHelper) {
+	if (!target.inferenceHelper) {
 		return RET_ERR;
 	}
-	if (m_inferenceHelper->setNumThread(numThreads) != InferenceHelper::RET_OK) {
-		m_inferenceHelper.reset();
+	if (target.inferenceHelper->setNumThread(numThreads) != InferenceHelper::RET_OK) {
+		target.inferenceHelper.reset();
 		return RET_ERR;
 	}
-	if (m_inferenceHelper->initialize(modelFilename, m_inputTensorList, m_outputTensorList) != InferenceHelper::RET_OK) {
-		m_inferenceHelper.reset();
+	if (target.inferenceHelper->initialize(modelFilename, target.inputTensorList, target.outputTensorList) != InferenceHelper::RET_OK) {
+		target.inferenceHelper.reset();
 		return RET_ERR;
 	}
 	/* Check if input tensor info is set */
-	for (const auto& inputTensorInfo : m_inputTensorList) {
+	for (const auto& inputTensorInfo : target.inputTensorList) {
 		if ((inputTensorInfo.tensorDims.width <= 0) || (inputTensorInfo.tensorDims.height <= 0) || inputTensorInfo.tensorType == TensorInfo::TENSOR_TYPE_NONE) {
 			PRINT_E("Invalid tensor size\n");
-			m_inferenceHelper.reset();
+			target.inferenceHelper.reset();
 			return RET_ERR;
 		}
 	}
 
+	const auto& tInitialize1 = std::chrono::steady_clock::now();
+	PRINT("Startup: %s preload = %.1f [msec], initialize = %.1f [msec]\n", info.name,
+		static_cast<std::chrono::duration<double>>(tPreload1 - tInitialize0).count() * 1000.0,
+		static_cast<std::chrono::duration<double>>(tInitialize1 - tPreload1).count() * 1000.0);
+
+	return RET_OK;
+}
+
+int32_t PoseEngine::warmup(const int32_t numWarmup)
+{
+	/* XNNPACK packs weights and allocates buffers at the first invocations */
+	/* with model ladder, every model runs at least twice to measure its cost */
+	cv::Mat dummyMat(480, 640, CV_8UC3, cv::Scalar(128, 128, 128));
+	const int32_t modelIndex = m_modelIndex;
+	for (int32_t model = 0; model < MODEL_NUM; model++) {
+		if (!m_modelList[model].inferenceHelper) continue;
+		m_modelIndex = model;
+		const int32_t num = m_isLadderEnabled ? (std::max)(numWarmup, 2) : numWarmup;
+		for (int32_t i = 0; i < num; i++) {
+			const auto& t0 = std::chrono::steady_clock::now();
+			RESULT result;
+			if (invokeRegion(dummyMat, cv::Rect(0, 0, dummyMat.cols, dummyMat.rows), result) != RET_OK) {
+				return RET_ERR;
+			}
+			const auto& t1 = std::chrono::steady_clock::now();
+			m_modelList[model].warmupTime = result.timeInference;
+			PRINT("Startup: warmup[%d] = %.1f [msec] (%s)\n", i, static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0, MODEL_INFO_LIST[model].name);
+		}
+	}
+	m_modelIndex = modelIndex;
+
+	/* Start with the most accurate model within the budget */
+	const float budget = Config::get().inferenceBudget;
+	if (m_isLadderEnabled && budget > 0) {
+		m_modelIndex = findModel(MODEL_NUM, -1);	// the cheapest one if nothing fits
+		for (int32_t model = 0; model < MODEL_NUM; model++) {
+			if (m_modelList[model].inferenceHelper && m_modelList[model].warmupTime < budget * LADDER_UPGRADE_RATIO) {
+				m_modelIndex = model;
+				break;
+			}
+		}
+		PRINT("Model ladder: start with %s\n", MODEL_INFO_LIST[m_modelIndex].name);
+	}
+	m_inferenceTimeList.clear();
+	m_numFrameSinceSwitch = 0;
+
+	setScaleMode(m_scaleMode);
+	m_isPersonPresent = false;
+	m_numSkipped = 0;
 	return RET_OK;
 }
 
+void PoseEngine::preloadFile(const std::string& filename)
+{
+#ifndef _WIN32
+	/* Read the whole model file sequentially into page cache */
+	/* Inference engine maps the file and touches weights in random order, which is slow on SD card */
+	int32_t fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;	// error is reported by inference helper
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			(void)madvise(addr, st.st_size, MADV_SEQUENTIAL);
+			(void)madvise(addr, st.st_size, MADV_WILLNEED);
+			const long pageSize = sysconf(_SC_PAGESIZE);
+			volatile uint8_t sum = 0;
+			for (off_t offset = 0; offset < st.st_size; offset += pageSize) {
+				sum += static_cast<const uint8_t*>(addr)[offset];
+			}
+			(void)sum;
+			munmap(addr, st.st_size);
+		}
+	}
+	close(fd);
+#endif
+}
+
 int32_t PoseEngine::finalize()
 {
-	if (!m_inferenceHelper) {
+	if (m_modelIndex < 0 || !m_modelList[m_modelIndex].inferenceHelper) {
 		PRINT_E("Inference helper is not created\n");
 		return RET_ERR;
 	}
-	m_inferenceHelper->finalize();
+	if (m_isLadderEnabled) printModelReport();
+	for (auto& model : m_modelList) {
+		if (model.inferenceHelper) model.inferenceHelper->finalize();
+	}
+	return RET_OK;
+}
+
+const char* PoseEngine::getModelName(int32_t model)
+{
+	return (model >= 0 && model < MODEL_NUM) ? MODEL_INFO_LIST[model].name : "unknown";
+}
+
+void PoseEngine::printModelReport() const
+{
+	double timeTotal = 0;
+	for (const auto& model : m_modelList) timeTotal += model.time;
+	PRINT("Model ladder: %d switches\n", m_numSwitch);
+	for (int32_t model = 0; model < MODEL_NUM; model++) {
+		if (!m_modelList[model].inferenceHelper) continue;
+		PRINT("  %-15s: %6d frames, %8.1f [sec] (%5.1f %%)\n", MODEL_INFO_LIST[model].name, m_modelList[model].numFrame,
+			m_modelList[model].time / 1000.0, (timeTotal > 0) ? m_modelList[model].time / timeTotal * 100.0 : 0.0);
+	}
+}
+
+int32_t PoseEngine::findModel(int32_t model, int32_t direction) const
+{
+	for (int32_t i = model + direction; i >= 0 && i < MODEL_NUM; i += direction) {
+		if (m_modelList[i].inferenceHelper) return i;
+	}
+	return -1;
+}
+
+void PoseEngine::updateModel(double timeInference)
+{
+	const float budget = Config::get().inferenceBudget;
+	m_numFrameSinceSwitch++;
+	m_inferenceTimeList.push_back(timeInference);
+	if (m_inferenceTimeList.size() > LADDER_WINDOW) m_inferenceTimeList.pop_front();
+	if (budget <= 0 || m_inferenceTimeList.size() < LADDER_WINDOW) return;
+
+	/* p95 of the window */
+	std::vector<double> sortedList(m_inferenceTimeList.begin(), m_inferenceTimeList.end());
+	const size_t index = static_cast<size_t>(std::ceil(sortedList.size() * 0.95)) - 1;
+	std::nth_element(sortedList.begin(), sortedList.begin() + index, sortedList.end());
+	const double p95 = sortedList[index];
+
+	/* Downgrade as soon as the budget is exceeded. upgrade only if the accurate model is expected to be well within the budget */
+	/* the cost of the accurate model is estimated from the ratio measured at warmup. if it's wrong and upgrading fails, wait longer next time */
+	int32_t nextModel = -1;
+	if (p95 > budget) {
+		nextModel = findModel(m_modelIndex, 1);
+		if (nextModel >= 0 && m_isLastSwitchUpgrade && m_numFrameSinceSwitch < LADDER_WINDOW * 2) {
+			m_upgradeBackoff = (std::min)(m_upgradeBackoff * 2, LADDER_MAX_BACKOFF);
+		}
+	} else {
+		const int32_t accurateModel = findModel(m_modelIndex, -1);
+		if (accurateModel >= 0 && m_numFrameSinceSwitch >= LADDER_WINDOW * m_upgradeBackoff) {
+			const double ratio = m_modelList[accurateModel].warmupTime / (std::max)(m_modelList[m_modelIndex].warmupTime, 1e-3);
+			if (p95 * ratio < budget * LADDER_UPGRADE_RATIO) nextModel = accurateModel;
+		}
+		if (m_isLastSwitchUpgrade && m_numFrameSinceSwitch >= LADDER_WINDOW * 4) m_upgradeBackoff = 1;
+	}
+	if (nextModel < 0) return;
+
+	PRINT("Model ladder: %s -> %s (p95 = %.1f [msec], budget = %.1f [msec])\n", MODEL_INFO_LIST[m_modelIndex].name, MODEL_INFO_LIST[nextModel].name, p95, budget);
+	m_isLastSwitchUpgrade = (nextModel < m_modelIndex);
+	m_modelIndex = nextModel;
+	m_inferenceTimeList.clear();
+	m_numFrameSinceSwitch = 0;
+	m_numSwitch++;
+}
+
+void PoseEngine::setScaleMode(int32_t scaleMode)
+{
+	m_scaleMode = scaleMode;
+	m_searchIndex = 0;
+	m_isTracking = false;
+}
+
+int32_t PoseEngine::setPersonDetector(bool isEnabled)
+{
+	if (isEnabled && m_personDetector.initialize() != PersonDetector::RET_OK) {
+		return RET_ERR;
+	}
+	m_isDetectorEnabled = isEnabled;
+	m_isPersonPresent = false;
+	m_numSkipped = 0;
 	return RET_OK;
 }
 
+int32_t PoseEngine::setModel(int32_t model)
+{
+	if (model < 0 || model >= MODEL_NUM || !m_modelList[model].inferenceHelper) {
+		PRINT_E("Model is not loaded: %s\n", getModelName(model));
+		return RET_ERR;
+	}
+	m_modelIndex = model;
+	m_isLadderEnabled = false;
+	m_inferenceTimeList.clear();
+	m_numFrameSinceSwitch = 0;
+	return RET_OK;
+}
 
 int32_t PoseEngine::invoke(const cv::Mat& originalMat, RESULT& result)
 {
-	if (!m_inferenceHelper) {
+	if (m_modelIndex < 0 || !m_modelList[m_modelIndex].inferenceHelper) {
 		PRINT_E("Inference helper is not created\n");
 		return RET_ERR;
 	}
+
+	/* Time spent with each model */
+	const double now = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count() * 1000.0;
+	if (m_lastInvokeTime >= 0) m_modelList[m_modelIndex].time += now - m_lastInvokeTime;
+	m_lastInvokeTime = now;
+	m_modelList[m_modelIndex].numFrame++;
+	result.model = m_modelIndex;
+
+	/* Skip pose estimation while nobody is in view. pose estimation runs at an interval in case the detector misses the person */
+	if (m_isDetectorEnabled && !m_isPersonPresent) {
+		const CONFIG& config = Config::get();
+		PersonDetector::RESULT detectResult;
+		if (m_personDetector.detect(originalMat, config.detectorWidth, config.detectorThreshold, detectResult) != PersonDetector::RET_OK) {
+			return RET_ERR;
+		}
+		result.timeDetection = detectResult.timeDetection;
+		if (detectResult.isDetected) {
+			/* start with the region around the detected person */
+			if (m_scaleMode == SCALE_MODE_MULTI) {
+				setTrackRegion(originalMat, detectResult.x, detectResult.y, detectResult.x + detectResult.width, detectResult.y + detectResult.height);
+			}
+		} else if (++m_numSkipped < config.detectorCheckInterval) {
+			setEmptyResult(result);
+			return RET_OK;
+		}
+	}
+	m_numSkipped = 0;
+
+	if (m_scaleMode != SCALE_MODE_MULTI) {
+		result.regionType = REGION_FULL;
+		if (invokeRegion(originalMat, cv::Rect(0, 0, originalMat.cols, originalMat.rows), result) != RET_OK) {
+			return RET_ERR;
+		}
+	} else {
+		int32_t regionType;
+		const cv::Rect region = selectRegion(originalMat, regionType);
+		result.regionType = regionType;
+		if (invokeRegion(originalMat, region, result) != RET_OK) {
+			return RET_ERR;
+		}
+	}
+
+	/* Bounding box of detected joints. the joints are thresholded by KeypointDecoder */
+	const uint32_t validMask = m_keypointDecoder.getValidMask(0);
+	float xMin = 1.0f, yMin = 1.0f, xMax = 0.0f, yMax = 0.0f;
+	int32_t numDetected = 0;
+	for (int32_t i = 0; i < KeypointDecoder::NUM_JOINTS; i++) {
+		if (validMask & (1u << i)) {
+			const auto& joint = result.poseKeypointCoords[0][i];
+			xMin = (std::min)(xMin, joint.first);
+			xMax = (std::max)(xMax, joint.first);
+			yMin = (std::min)(yMin, joint.second);
+			yMax = (std::max)(yMax, joint.second);
+			numDetected++;
+		}
+	}
+	m_isPersonPresent = (numDetected >= MIN_PRESENCE_JOINTS);
+
+	/* Select the model for the next frame */
+	if (m_isLadderEnabled) updateModel(result.timeInference);
+
+	if (m_scaleMode == SCALE_MODE_MULTI) {
+		if (m_isPersonPresent) {
+			setTrackRegion(originalMat, xMin, yMin, xMax, yMax);
+		} else {
+			/* lost: restart searching from the whole frame */
+			if (m_isTracking) m_searchIndex = 0;
+			m_isTracking = false;
+		}
+	}
+	return RET_OK;
+}
+
+cv::Rect PoseEngine::selectRegion(const cv::Mat& originalMat, int32_t& regionType)
+{
+	if (m_isTracking) {
+		regionType = REGION_TRACK;
+		return m_trackRegion;
+	}
+
+	/* Search schedule: the whole frame, tile 0, tile 1, ... */
+	/* tiles are square and overlapped, placed at the middle height where a distant person appears */
+	const int32_t index = m_searchIndex;
+	m_searchIndex = (m_searchIndex + 1) % (NUM_TILES + 1);
+	if (index == 0) {
+		regionType = REGION_FULL;
+		return cv::Rect(0, 0, originalMat.cols, originalMat.rows);
+	}
+	regionType = REGION_TILE;
+	const int32_t tileSize = static_cast<int32_t>((std::min)(originalMat.cols, originalMat.rows) * TILE_SIZE_RATIO);
+	const int32_t tileX = (NUM_TILES > 1) ? (index - 1) * (originalMat.cols - tileSize) / (NUM_TILES - 1) : (originalMat.cols - tileSize) / 2;
+	const int32_t tileY = (originalMat.rows - tileSize) / 2;
+	return cv::Rect(tileX, tileY, tileSize, tileSize);
+}
+
+void PoseEngine::setTrackRegion(const cv::Mat& originalMat, float xMin, float yMin, float xMax, float yMax)
+{
+	/* Square region around the person with margin for limbs */
+	const float centerX = (xMin + xMax) / 2 * originalMat.cols;
+	const float centerY = (yMin + yMax) / 2 * originalMat.rows;
+	float size = (std::max)((xMax - xMin) * originalMat.cols, (yMax - yMin) * originalMat.rows) * TRACK_MARGIN;
+	size = (std::max)(size, originalMat.rows * TRACK_MIN_SIZE_RATIO);
+	if (size >= (std::min)(originalMat.cols, originalMat.rows)) {
+		/* the person is close enough. the whole frame has enough resolution */
+		m_trackRegion = cv::Rect(0, 0, originalMat.cols, originalMat.rows);
+	} else {
+		int32_t x = static_cast<int32_t>(centerX - size / 2);
+		int32_t y = static_cast<int32_t>(centerY - size / 2);
+		x = (std::max)(0, (std::min)(x, originalMat.cols - static_cast<int32_t>(size)));
+		y = (std::max)(0, (std::min)(y, originalMat.rows - static_cast<int32_t>(size)));
+		m_trackRegion = cv::Rect(x, y, static_cast<int32_t>(size), static_cast<int32_t>(size));
+	}
+	m_isTracking = true;
+}
+
+void PoseEngine::setEmptyResult(RESULT& result)
+{
+	result.isSkipped = true;
+	result.regionType = REGION_FULL;
+	result.poseScores.assign(1, 0.0f);
+	result.poseKeypointScores.assign(1, std::vector<float>(KeypointDecoder::NUM_JOINTS, 0.0f));
+	result.poseKeypointCoords.assign(1, std::vector<std::pair<float, float>>(KeypointDecoder::NUM_JOINTS, std::pair<float, float>(0.0f, 0.0f)));
+}
+
+int32_t PoseEngine::invokeRegion(const cv::Mat& originalMat, const cv::Rect& region, RESULT& result)
+{
 	/*** PreProcess ***/
 	const auto& tPreProcess0 = std::chrono::steady_clock::now();
-	InputTensorInfo& inputTensorInfo = m_inputTensorList[0];
+	MODEL& model = m_modelList[m_modelIndex];
+	InputTensorInfo& inputTensorInfo = model.inputTensorList[0];
 #if 1
 	/* do resize and color conversion here because some inference engine doesn't support these operations */
-	cv::Mat imgSrc;
-	cv::resize(originalMat, imgSrc, cv::Size(inputTensorInfo.tensorDims.width, inputTensorInfo.tensorDims.height));
+	cv::Mat& imgSrc = model.imgSrc;
 #ifndef CV_COLOR_IS_RGB
-	cv::cvtColor(imgSrc, imgSrc, cv::COLOR_BGR2RGB);
+	{
+		TRACE_SPAN("resize");
+		cv::resize(originalMat(region), model.resizedMat, cv::Size(inputTensorInfo.tensorDims.width, inputTensorInfo.tensorDims.height));
+	}
+	{
+		TRACE_SPAN("cvtColor");
+		cv::cvtColor(model.resizedMat, imgSrc, cv::COLOR_BGR2RGB);
+	}
+#else
+	{
+		TRACE_SPAN("resize");
+		cv::resize(originalMat(region), imgSrc, cv::Size(inputTensorInfo.tensorDims.width, inputTensorInfo.tensorDims.height));
+	}
 #endif
 	inputTensorInfo.data = imgSrc.data;
 	inputTensorInfo.dataType = InputTensorInfo::DATA_TYPE_IMAGE;
@@ -170,10 +535,10 @@ int32_t PoseEngine::invoke(const cv::Mat& originalMat, RESULT& result)
 	inputTensorInfo.imageInfo.width = originalMat.cols;
 	inputTensorInfo.imageInfo.height = originalMat.rows;
 	inputTensorInfo.imageInfo.channel = originalMat.channels();
-	inputTensorInfo.imageInfo.cropX = 0;
-	inputTensorInfo.imageInfo.cropY = 0;
-	inputTensorInfo.imageInfo.cropWidth = originalMat.cols;
-	inputTensorInfo.imageInfo.cropHeight = originalMat.rows;
+	inputTensorInfo.imageInfo.cropX = region.x;
+	inputTensorInfo.imageInfo.cropY = region.y;
+	inputTensorInfo.imageInfo.cropWidth = region.width;
+	inputTensorInfo.imageInfo.cropHeight = region.height;
 	inputTensorInfo.imageInfo.isBGR = true;
 	inputTensorInfo.imageInfo.swapColor = true;
 #if 0
@@ -185,43 +550,63 @@ int32_t PoseEngine::invoke(const cv::Mat& originalMat, RESULT& result)
 #endif
 	inputTensorInfo.data = imgSrc.data;
 #endif
-	if (m_inferenceHelper->preProcess(m_inputTensorList) != InferenceHelper::RET_OK) {
-		return RET_ERR;
+	{
+		TRACE_SPAN("preProcess");
+		if (model.inferenceHelper->preProcess(model.inputTensorList) != InferenceHelper::RET_OK) {
+			return RET_ERR;
+		}
 	}
 	const auto& tPreProcess1 = std::chrono::steady_clock::now();
 
 	/*** Inference ***/
 	const auto& tInference0 = std::chrono::steady_clock::now();
-	if (m_inferenceHelper->invoke(m_outputTensorList) != InferenceHelper::RET_OK) {
-		return RET_ERR;
+	{
+		TRACE_SPAN("invoke");
+		if (model.inferenceHelper->invoke(model.outputTensorList) != InferenceHelper::RET_OK) {
+			return RET_ERR;
+		}
 	}
 	const auto& tInference1 = std::chrono::steady_clock::now();
 
 	/*** PostProcess ***/
 	const auto& tPostProcess0 = std::chrono::steady_clock::now();
+	TRACE_SPAN("decode");
 
 	/* Retrieve the result */
-	float* valFloat = m_outputTensorList[0].getDataAsFloat();
-	std::vector<float> poseKeypointScores;	// z
-	std::vector<std::pair<float,float>> poseKeypointCoords;	// x, y
-	for (int32_t jointIndex = 0; jointIndex < m_outputTensorList[0].tensorDims.width; jointIndex++) {
-		// PRINT("%f, %f, %f\n", valFloat[1], valFloat[0], valFloat[2]);
-		poseKeypointCoords.push_back(std::pair<float,float>(valFloat[1], valFloat[0]));
-		poseKeypointScores.push_back(valFloat[2]);
-		valFloat += 3;
-	}
-
-	/* Find the max score */
 	/* note: we have only one body with this model */
-	result.poseScores.push_back(1.0);
-	result.poseKeypointScores.push_back(poseKeypointScores);
-	result.poseKeypointCoords.push_back(poseKeypointCoords);
+	const float* valFloat = model.outputTensorList[0].getDataAsFloat();
+	const KeypointDecoder::ROI roi(static_cast<float>(region.x) / originalMat.cols, static_cast<float>(region.y) / originalMat.rows,
+		static_cast<float>(region.width) / originalMat.cols, static_cast<float>(region.height) / originalMat.rows);
+	if (m_keypointDecoder.decode(valFloat, 1, roi, Config::get().thresholdScore) != KeypointDecoder::RET_OK) {
+		return RET_ERR;
+	}
+	const int32_t personNum = m_keypointDecoder.getPersonNum();
+	result.poseScores.resize(personNum);
+	result.poseKeypointScores.resize(personNum);
+	result.poseKeypointCoords.resize(personNum);
+	for (int32_t person = 0; person < personNum; person++) {
+		const float* x = m_keypointDecoder.getX(person);
+		const float* y = m_keypointDecoder.getY(person);
+		const float* score = m_keypointDecoder.getScore(person);
+		result.poseScores[person] = m_keypointDecoder.getPersonScore(person);
+		result.poseKeypointScores[person].assign(score, score + KeypointDecoder::NUM_JOINTS);
+		auto& coords = result.poseKeypointCoords[person];
+		coords.resize(KeypointDecoder::NUM_JOINTS);
+		for (int32_t joint = 0; joint < KeypointDecoder::NUM_JOINTS; joint++) {
+			coords[joint].first = x[joint];
+			coords[joint].second = y[joint];
+		}
+	}
 	const auto& tPostProcess1 = std::chrono::steady_clock::now();
 
 	/* Return the results */
 	result.timePreProcess = static_cast<std::chrono::duration<double>>(tPreProcess1 - tPreProcess0).count() * 1000.0;
 	result.timeInference = static_cast<std::chrono::duration<double>>(tInference1 - tInference0).count() * 1000.0;
 	result.timePostProcess = static_cast<std::chrono::duration<double>>(tPostProcess1 - tPostProcess0).count() * 1000.0;;
+	result.regionX = roi.x;
+	result.regionY = roi.y;
+	result.regionWidth = roi.width;
+	result.regionHeight = roi.height;
 
 	return RET_OK;
 }
@@ -22,6 +22,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <deque>
 #include <memory>
 
 /* for OpenCV */
@@ -29,6 +30,8 @@ limitations under the License.
 
 /* for My modules */
 #include "InferenceHelper.h"
+#include "KeypointDecoder.h"
+#include "PersonDetector.h"
 
 
 class PoseEngine {
@@ -38,6 +41,25 @@ public:
 		RET_ERR = -1,
 	};
 
+	enum {
+		SCALE_MODE_FULL = 0,	// the whole frame is resized to the model input
+		SCALE_MODE_MULTI,		// search the person with the whole frame and tiles, then crop around the person
+	};
+
+	enum {
+		REGION_FULL = 0,
+		REGION_TILE,
+		REGION_TRACK,
+	};
+
+	/* Model ladder. ordered from high accuracy to low cost */
+	enum {
+		MODEL_THUNDER_FP32 = 0,
+		MODEL_LIGHTNING_FP32,
+		MODEL_LIGHTNING_INT8,
+		MODEL_NUM,
+	};
+
 	typedef struct RESULT_ {
 		std::vector<float>                                  poseScores;			// [body]
 		std::vector<std::vector<float>>                     poseKeypointScores;	// [body][joint]
@@ -45,20 +67,82 @@ public:
 		double    timePreProcess;		// [msec]
 		double    timeInference;		// [msec]
 		double    timePostProcess;	// [msec]
-		RESULT_() : timePreProcess(0), timeInference(0), timePostProcess(0)
+		double    timeDetection;		// [msec]
+		bool      isSkipped;			// pose estimation is skipped because nobody is detected. scores are 0
+		int32_t   regionType;			// REGION_xxx
+		float     regionX;				// region fed to the model in this frame (0 - 1.0)
+		float     regionY;
+		float     regionWidth;
+		float     regionHeight;
+		int32_t   model;				// MODEL_xxx used in this frame
+		RESULT_() : timePreProcess(0), timeInference(0), timePostProcess(0), timeDetection(0), isSkipped(false)
+			, regionType(REGION_FULL), regionX(0), regionY(0), regionWidth(1.0f), regionHeight(1.0f), model(MODEL_LIGHTNING_FP32)
 		{}
 	} RESULT;
 
 public:
-	PoseEngine() {}
+	PoseEngine() : m_modelIndex(MODEL_LIGHTNING_FP32), m_isLadderEnabled(false), m_numSwitch(0), m_numFrameSinceSwitch(0), m_upgradeBackoff(1), m_isLastSwitchUpgrade(false), m_lastInvokeTime(-1)
+		, m_scaleMode(SCALE_MODE_FULL), m_searchIndex(0), m_isTracking(false), m_isDetectorEnabled(false), m_isPersonPresent(false), m_numSkipped(0) {}
 	~PoseEngine() {}
-	int32_t initialize(const std::string& workDir, const int32_t numThreads);
+	int32_t initialize(const std::string& workDir, const int32_t numThreads, bool useModelLadder = false);	// load all the models in the ladder if useModelLadder
 	int32_t finalize(void);
+	int32_t warmup(const int32_t numWarmup);	// run inference with dummy image so that the first frame is not slow
 	int32_t invoke(const cv::Mat& originalMat, RESULT& result);
+	void    setScaleMode(int32_t scaleMode);
+	int32_t setPersonDetector(bool isEnabled);	// run the cheap detector first while nobody is in view
+	int32_t setModel(int32_t model);			// use the model (loaded with useModelLadder) and stop switching
+	static const char* getModelName(int32_t model);
+	void    printModelReport() const;
+
+private:
+	typedef struct MODEL_ {
+		std::unique_ptr<InferenceHelper> inferenceHelper;	// null if the model is not loaded
+		std::vector<InputTensorInfo>  inputTensorList;
+		std::vector<OutputTensorInfo> outputTensorList;
+		double  warmupTime;	// [msec] inference time at warmup, to estimate the cost relative to the other models
+		int32_t numFrame;
+		double  time;		// [msec] wall time spent with this model
+		cv::Mat resizedMat;	// reused to avoid allocation
+		cv::Mat imgSrc;		// (cvtColor allocates when src and dst are the same)
+		MODEL_() : warmupTime(0), numFrame(0), time(0) {}
+	} MODEL;
+
 private:
-	std::unique_ptr<InferenceHelper> m_inferenceHelper;
-	std::vector<InputTensorInfo> m_inputTensorList;
-	std::vector<OutputTensorInfo> m_outputTensorList;
+	int32_t initializeModel(int32_t model, const std::string& workDir, const int32_t numThreads);
+	void    updateModel(double timeInference);
+	int32_t findModel(int32_t model, int32_t direction) const;	// the next loaded model toward direction (-1: accurate, 1: cheap). -1 if none
+	static void preloadFile(const std::string& filename);
+	int32_t invokeRegion(const cv::Mat& originalMat, const cv::Rect& region, RESULT& result);
+	cv::Rect selectRegion(const cv::Mat& originalMat, int32_t& regionType);
+	void    setTrackRegion(const cv::Mat& originalMat, float xMin, float yMin, float xMax, float yMax);
+	static void setEmptyResult(RESULT& result);
+private:
+	std::array<MODEL, MODEL_NUM> m_modelList;
+	KeypointDecoder m_keypointDecoder;
+
+	/* for model ladder */
+	/* the model is switched by p95 of inference time in the window, compared with inferenceBudget in config */
+	int32_t  m_modelIndex;
+	bool     m_isLadderEnabled;
+	std::deque<double> m_inferenceTimeList;	// [msec] of the current model
+	int32_t  m_numSwitch;
+	int32_t  m_numFrameSinceSwitch;
+	int32_t  m_upgradeBackoff;		// wait LADDER_WINDOW * this before upgrading
+	bool     m_isLastSwitchUpgrade;
+	double   m_lastInvokeTime;	// [msec]
+
+	/* for SCALE_MODE_MULTI */
+	/* only one inference runs per frame. searching regions (the whole frame and tiles) are visited one by one over frames */
+	int32_t  m_scaleMode;
+	int32_t  m_searchIndex;		// 0: the whole frame, 1 -: tile
+	bool     m_isTracking;
+	cv::Rect m_trackRegion;
+
+	/* for PersonDetector */
+	PersonDetector m_personDetector;
+	bool     m_isDetectorEnabled;
+	bool     m_isPersonPresent;	// the last pose estimation found a person
+	int32_t  m_numSkipped;
 };
 
 #endif
@@ -0,0 +1,355 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+/* for socket */
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "PreviewServer.h"
+
+/*** Macro ***/
+#define TAG "PreviewServer"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+#define MAX_CLIENT_NUM        8
+#define MAX_REQUEST_SIZE      4096
+#define MAX_KEYPOINT_PENDING  (64 * 1024)	// [byte] keypoint lines are dropped if the client doesn't read
+#define POLL_TIMEOUT          100			// [msec]
+
+static const char* HEADER_IMAGE = "HTTP/1.0 200 OK\r\nCache-Control: no-cache\r\nContent-Type: multipart/x-mixed-replace; boundary=frame\r\n\r\n";
+static const char* HEADER_KEYPOINT = "HTTP/1.0 200 OK\r\nCache-Control: no-cache\r\nContent-Type: text/plain\r\n\r\n";
+static const char* RESPONSE_INDEX = "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n<html><body><img src=\"/stream.mjpg\"></body></html>\n";
+static const char* RESPONSE_NOT_FOUND = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n\r\nNot Found\n";
+
+/*** Function ***/
+#ifndef _WIN32
+static void setNonBlocking(int32_t fd)
+{
+	int32_t flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+#endif
+
+int32_t PreviewServer::initialize(const PARAM& param)
+{
+#ifdef _WIN32
+	(void)param;
+	PRINT_E("Not supported\n");
+	return RET_ERR;
+#else
+	finalize();
+	m_param = param;
+	if (m_param.imageFps <= 0 || m_param.imageWidth <= 0 || m_param.imageHeight <= 0) {
+		PRINT_E("Invalid parameter\n");
+		return RET_ERR;
+	}
+
+	m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listenFd < 0) {
+		PRINT_E("socket failed\n");
+		return RET_ERR;
+	}
+	int32_t reuse = 1;
+	setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<uint16_t>(m_param.port));
+	if (inet_pton(AF_INET, m_param.address.c_str(), &addr.sin_addr) != 1
+		|| bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0
+		|| listen(m_listenFd, MAX_CLIENT_NUM) != 0) {
+		PRINT_E("Failed to listen on %s:%d\n", m_param.address.c_str(), m_param.port);
+		::close(m_listenFd);
+		m_listenFd = -1;
+		return RET_ERR;
+	}
+	setNonBlocking(m_listenFd);
+
+	if (pipe(m_wakeupFd) != 0) {
+		PRINT_E("pipe failed\n");
+		::close(m_listenFd);
+		m_listenFd = -1;
+		return RET_ERR;
+	}
+	setNonBlocking(m_wakeupFd[0]);
+	setNonBlocking(m_wakeupFd[1]);
+
+	m_nextImageTime = 0;
+	m_isRunning = true;
+	m_thread = std::thread(&PreviewServer::serverThread, this);
+	PRINT("Preview: http://%s:%d/stream.mjpg, http://%s:%d/keypoints\n", m_param.address.c_str(), m_param.port, m_param.address.c_str(), m_param.port);
+	return RET_OK;
+#endif
+}
+
+void PreviewServer::finalize()
+{
+#ifndef _WIN32
+	if (m_thread.joinable()) {
+		m_isRunning = false;
+		(void)!write(m_wakeupFd[1], "q", 1);
+		m_thread.join();
+	}
+	for (auto& fd : { &m_listenFd, &m_wakeupFd[0], &m_wakeupFd[1] }) {
+		if (*fd >= 0) ::close(*fd);
+		*fd = -1;
+	}
+	m_numImageClient = 0;
+	m_numKeypointClient = 0;
+#endif
+}
+
+void PreviewServer::publish(double timestamp, const cv::Mat& image, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, const std::string& command)
+{
+#ifndef _WIN32
+	if (!m_isRunning || !hasClient()) return;
+
+	std::string line;
+	if (m_numKeypointClient > 0) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%u %.1f %s", m_frameId, timestamp, command.empty() ? "-" : command.c_str());
+		line = buffer;
+		for (size_t i = 0; i < jointList.size() && i < scoreList.size(); i++) {
+			snprintf(buffer, sizeof(buffer), " %.3f %.3f %.2f", jointList[i].first, jointList[i].second, scoreList[i]);
+			line += buffer;
+		}
+		line += "\n";
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frameId++;
+		if (!line.empty()) {
+			m_keypointLine.swap(line);
+			m_isKeypointUpdated = true;
+		}
+		if (m_numImageClient > 0 && timestamp >= m_nextImageTime) {
+			/* resizing and encoding are done by the server thread */
+			image.copyTo(m_image);
+			m_isImageUpdated = true;
+			m_nextImageTime = timestamp + 1000.0 / m_param.imageFps;
+		}
+	}
+	(void)!write(m_wakeupFd[1], "f", 1);
+#else
+	(void)timestamp; (void)image; (void)jointList; (void)scoreList; (void)command;
+#endif
+}
+
+#ifndef _WIN32
+void PreviewServer::serverThread()
+{
+	std::vector<CLIENT> clientList;
+	std::vector<struct pollfd> pollList;
+	while (m_isRunning) {
+		pollList.clear();
+		pollList.push_back({ m_listenFd, POLLIN, 0 });
+		pollList.push_back({ m_wakeupFd[0], POLLIN, 0 });
+		for (const auto& client : clientList) {
+			pollList.push_back({ client.fd, static_cast<int16_t>(POLLIN | (client.pending.empty() ? 0 : POLLOUT)), 0 });
+		}
+		if (poll(pollList.data(), pollList.size(), POLL_TIMEOUT) < 0) {
+			if (errno == EINTR) continue;
+			PRINT_E("poll failed\n");
+			break;
+		}
+
+		/* Receive request and send the rest of data */
+		for (size_t i = 0; i < clientList.size(); i++) {
+			CLIENT& client = clientList[i];
+			const int16_t revents = pollList[i + 2].revents;
+			if (revents & POLLIN) {
+				char buffer[512];
+				ssize_t size = recv(client.fd, buffer, sizeof(buffer), 0);
+				if (size <= 0) {
+					closeClient(client);
+					continue;
+				}
+				if (client.type == CLIENT_REQUEST) {
+					client.request.append(buffer, size);
+					if (client.request.find("\r\n\r\n") != std::string::npos || client.request.find("\n\n") != std::string::npos) {
+						handleRequest(client);
+					} else if (client.request.size() > MAX_REQUEST_SIZE) {
+						closeClient(client);
+						continue;
+					}
+				}
+			} else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				closeClient(client);
+				continue;
+			}
+			if (revents & POLLOUT) {
+				sendPending(client);
+			}
+		}
+
+		/* Send the latest frame */
+		if (pollList[1].revents & POLLIN) {
+			char buffer[64];
+			while (read(m_wakeupFd[0], buffer, sizeof(buffer)) > 0);
+			sendFrame(clientList);
+		}
+
+		clientList.erase(std::remove_if(clientList.begin(), clientList.end(), [](const CLIENT& client) { return client.fd < 0; }), clientList.end());
+
+		/* Accept new clients */
+		if (pollList[0].revents & POLLIN) {
+			int32_t fd;
+			while ((fd = accept(m_listenFd, nullptr, nullptr)) >= 0) {
+				if (clientList.size() >= MAX_CLIENT_NUM) {
+					::close(fd);
+					continue;
+				}
+				setNonBlocking(fd);
+				clientList.push_back({ fd, CLIENT_REQUEST, "", "", 0 });
+			}
+		}
+
+		int32_t numImageClient = 0;
+		int32_t numKeypointClient = 0;
+		for (const auto& client : clientList) {
+			if (client.type == CLIENT_IMAGE) numImageClient++;
+			if (client.type == CLIENT_KEYPOINT) numKeypointClient++;
+		}
+		m_numImageClient = numImageClient;
+		m_numKeypointClient = numKeypointClient;
+	}
+
+	for (auto& client : clientList) {
+		closeClient(client);
+	}
+}
+
+void PreviewServer::handleRequest(CLIENT& client)
+{
+	char method[16] = "";
+	char path[256] = "";
+	(void)sscanf(client.request.c_str(), "%15s %255s", method, path);
+	const std::string target = std::string(path).substr(0, std::string(path).find('?'));
+	if (strcmp(method, "GET") != 0) {
+		client.type = CLIENT_CLOSING;
+		client.pending = RESPONSE_NOT_FOUND;
+	} else if (target == "/stream.mjpg") {
+		client.type = CLIENT_IMAGE;
+		client.pending = HEADER_IMAGE;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_nextImageTime = 0;	// send the next frame immediately
+	} else if (target == "/keypoints") {
+		client.type = CLIENT_KEYPOINT;
+		client.pending = HEADER_KEYPOINT;
+	} else if (target == "/") {
+		client.type = CLIENT_CLOSING;
+		client.pending = RESPONSE_INDEX;
+	} else {
+		client.type = CLIENT_CLOSING;
+		client.pending = RESPONSE_NOT_FOUND;
+	}
+	client.request.clear();
+	client.sentSize = 0;
+	sendPending(client);
+}
+
+void PreviewServer::sendPending(CLIENT& client)
+{
+	while (client.fd >= 0 && client.sentSize < client.pending.size()) {
+		ssize_t size = send(client.fd, client.pending.data() + client.sentSize, client.pending.size() - client.sentSize, MSG_NOSIGNAL);
+		if (size > 0) {
+			client.sentSize += size;
+		} else if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		} else {
+			closeClient(client);
+			return;
+		}
+	}
+	client.pending.clear();
+	client.sentSize = 0;
+	if (client.type == CLIENT_CLOSING) closeClient(client);
+}
+
+void PreviewServer::sendFrame(std::vector<CLIENT>& clientList)
+{
+	std::string keypointLine;
+	bool isImageUpdated = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_isKeypointUpdated) {
+			keypointLine.swap(m_keypointLine);
+			m_isKeypointUpdated = false;
+		}
+		if (m_isImageUpdated) {
+			cv::swap(m_image, m_sendImage);
+			m_isImageUpdated = false;
+			isImageUpdated = true;
+		}
+	}
+
+	std::string part;
+	if (isImageUpdated) {
+		cv::resize(m_sendImage, m_resizedImage, cv::Size(m_param.imageWidth, m_param.imageHeight), 0, 0, cv::INTER_AREA);
+		cv::imencode(".jpg", m_resizedImage, m_jpeg, { cv::IMWRITE_JPEG_QUALITY, m_param.jpegQuality });
+		char header[128];
+		snprintf(header, sizeof(header), "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", m_jpeg.size());
+		part = header;
+		part.append(reinterpret_cast<const char*>(m_jpeg.data()), m_jpeg.size());
+		part += "\r\n";
+	}
+
+	for (auto& client : clientList) {
+		if (client.fd < 0) continue;
+		if (client.type == CLIENT_IMAGE && !part.empty() && client.pending.empty()) {
+			/* a client which hasn't received the previous frame yet skips this frame */
+			client.pending = part;
+			sendPending(client);
+		} else if (client.type == CLIENT_KEYPOINT && !keypointLine.empty() && client.pending.size() < MAX_KEYPOINT_PENDING) {
+			client.pending += keypointLine;
+			sendPending(client);
+		}
+	}
+}
+
+void PreviewServer::closeClient(CLIENT& client)
+{
+	if (client.fd >= 0) ::close(client.fd);
+	client.fd = -1;
+	client.pending.clear();
+	client.sentSize = 0;
+}
+#endif
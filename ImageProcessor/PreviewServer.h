@@ -0,0 +1,114 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef PREVIEW_SERVER_
+#define PREVIEW_SERVER_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* HTTP server to preview the result without a display */
+/*   /stream.mjpg : MJPEG of the processed image at a reduced rate and size */
+/*   /keypoints   : text stream. one line per frame "frameId timestamp command x0 y0 score0 x1 y1 score1 ..." */
+/* note: JPEG encoding and sending run on the server thread. publish() only stores the latest frame, */
+/*       and doesn't even copy the image when no MJPEG client is connected. a slow client drops frames */
+class PreviewServer {
+public:
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	typedef struct PARAM_ {
+		std::string address;	// "127.0.0.1" to accept only local clients (e.g. via ssh port forwarding)
+		int32_t port;
+		float   imageFps;		// max frame rate of MJPEG
+		int32_t imageWidth;		// image is resized to this size before encoding
+		int32_t imageHeight;
+		int32_t jpegQuality;
+		PARAM_()
+			: address("127.0.0.1")
+			, port(8080)
+			, imageFps(5.0f)
+			, imageWidth(320)
+			, imageHeight(240)
+			, jpegQuality(60)
+		{}
+	} PARAM;
+
+public:
+	PreviewServer() : m_listenFd(-1), m_isRunning(false), m_numImageClient(0), m_numKeypointClient(0), m_frameId(0), m_isKeypointUpdated(false), m_isImageUpdated(false), m_nextImageTime(0) {
+		m_wakeupFd[0] = m_wakeupFd[1] = -1;
+	}
+	~PreviewServer() { finalize(); }
+	int32_t initialize(const PARAM& param);
+	void    finalize();
+	void    publish(double timestamp, const cv::Mat& image, const std::vector<std::pair<float, float>>& jointList, const std::vector<float>& scoreList, const std::string& command);
+	bool    hasClient() const { return m_numImageClient > 0 || m_numKeypointClient > 0; }
+
+private:
+	enum {
+		CLIENT_REQUEST = 0,	// waiting for request
+		CLIENT_IMAGE,
+		CLIENT_KEYPOINT,
+		CLIENT_CLOSING,		// close after sending the response
+	};
+	typedef struct {
+		int32_t     fd;
+		int32_t     type;
+		std::string request;
+		std::string pending;	// data not sent yet
+		size_t      sentSize;
+	} CLIENT;
+
+	void serverThread();
+	void handleRequest(CLIENT& client);
+	void sendPending(CLIENT& client);
+	void sendFrame(std::vector<CLIENT>& clientList);
+	void closeClient(CLIENT& client);
+
+private:
+	PARAM m_param;
+	int32_t m_listenFd;
+	int32_t m_wakeupFd[2];	// pipe to wake up the server thread when a frame is published
+	std::thread m_thread;
+	std::atomic<bool> m_isRunning;
+	std::atomic<int32_t> m_numImageClient;
+	std::atomic<int32_t> m_numKeypointClient;
+
+	/* the latest frame. protected by m_mutex */
+	std::mutex  m_mutex;
+	uint32_t    m_frameId;
+	std::string m_keypointLine;
+	bool        m_isKeypointUpdated;
+	cv::Mat     m_image;
+	bool        m_isImageUpdated;
+	double      m_nextImageTime;	// [msec]
+
+	/* for the server thread. swapped with m_image and reused to avoid allocation */
+	cv::Mat     m_sendImage;
+	cv::Mat     m_resizedImage;
+	std::vector<uint8_t> m_jpeg;
+};
+
+#endif
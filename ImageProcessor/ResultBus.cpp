@@ -0,0 +1,258 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+/* for shared memory */
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "ResultBus.h"
+
+/*** Macro ***/
+#define TAG "ResultBus"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+#define MAGIC          0x42545242	// "BRTB"
+#define VERSION        3			// increment when FRAME is changed
+#define ALIGNMENT      64			// cache line
+#define FRAME_OFFSET   16			// offset of FRAME in a slot (after the sequence counter)
+#define MAX_RETRY      4
+
+static_assert(std::is_trivially_copyable<ResultBus::FRAME>::value, "FRAME must be trivially copyable");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "atomic must be lock-free to be shared between processes");
+
+/*** Function ***/
+static size_t alignSize(size_t size)
+{
+	return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+int32_t ResultBus::open(const std::string& name, int32_t mode, int32_t imageWidth, int32_t imageHeight)
+{
+#ifdef _WIN32
+	(void)name; (void)mode; (void)imageWidth; (void)imageHeight;
+	PRINT_E("Not supported\n");
+	return RET_ERR;
+#else
+	close();
+	m_name = name;
+	m_mode = mode;
+	m_lastFrameId = 0;
+	m_hasRead = false;
+
+	if (mode == MODE_WRITE) {
+		if (imageWidth < 0 || imageHeight < 0) {
+			PRINT_E("Invalid image size (%d x %d)\n", imageWidth, imageHeight);
+			return RET_ERR;
+		}
+		const uint32_t slotSize = static_cast<uint32_t>(alignSize(FRAME_OFFSET + sizeof(FRAME) + imageWidth * imageHeight * 3));
+		m_size = alignSize(sizeof(HEADER)) + static_cast<size_t>(slotSize) * NUM_SLOTS;
+
+		/* Recreate so that a reader attached to the old bus doesn't see inconsistent header */
+		(void)shm_unlink(name.c_str());
+		int32_t fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+		if (fd < 0) {
+			PRINT_E("Failed to create %s\n", name.c_str());
+			return RET_ERR;
+		}
+		if (ftruncate(fd, m_size) != 0) {
+			PRINT_E("Failed to allocate %s\n", name.c_str());
+			::close(fd);
+			shm_unlink(name.c_str());
+			return RET_ERR;
+		}
+		void* addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (addr == MAP_FAILED) {
+			PRINT_E("Failed to map %s\n", name.c_str());
+			shm_unlink(name.c_str());
+			return RET_ERR;
+		}
+		memset(addr, 0, m_size);
+		m_header = static_cast<HEADER*>(addr);
+		m_header->version = VERSION;
+		m_header->slotNum = NUM_SLOTS;
+		m_header->slotSize = slotSize;
+		m_header->imageWidth = imageWidth;
+		m_header->imageHeight = imageHeight;
+		m_header->writeCount.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_header->magic = MAGIC;
+		return RET_OK;
+	}
+
+	int32_t fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		PRINT_E("Failed to open %s\n", name.c_str());
+		return RET_ERR;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < alignSize(sizeof(HEADER))) {
+		PRINT_E("%s is not ready\n", name.c_str());
+		::close(fd);
+		return RET_ERR;
+	}
+	m_size = st.st_size;
+	void* addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) {
+		PRINT_E("Failed to map %s\n", name.c_str());
+		return RET_ERR;
+	}
+	m_header = static_cast<HEADER*>(addr);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (m_header->magic != MAGIC || m_header->version != VERSION
+		|| alignSize(sizeof(HEADER)) + static_cast<size_t>(m_header->slotSize) * m_header->slotNum > m_size) {
+		PRINT_E("%s is not ready or incompatible\n", name.c_str());
+		close();
+		return RET_ERR;
+	}
+	return RET_OK;
+#endif
+}
+
+void ResultBus::close()
+{
+#ifndef _WIN32
+	if (m_header) {
+		munmap(m_header, m_size);
+		if (m_mode == MODE_WRITE) {
+			shm_unlink(m_name.c_str());
+		}
+	}
+#endif
+	m_header = nullptr;
+	m_size = 0;
+}
+
+uint8_t* ResultBus::getSlot(uint32_t index) const
+{
+	return reinterpret_cast<uint8_t*>(m_header) + alignSize(sizeof(HEADER)) + static_cast<size_t>(m_header->slotSize) * (index % m_header->slotNum);
+}
+
+int32_t ResultBus::write(const FRAME& frame, const uint8_t* image)
+{
+	if (!m_header || m_mode != MODE_WRITE) {
+		PRINT_E("Not opened for write\n");
+		return RET_ERR;
+	}
+	const uint32_t frameId = m_header->writeCount.load(std::memory_order_relaxed);
+	uint8_t* slot = getSlot(frameId);
+	std::atomic<uint32_t>* sequence = reinterpret_cast<std::atomic<uint32_t>*>(slot);
+
+	/* odd sequence means the slot is being written */
+	const uint32_t sequenceValue = sequence->load(std::memory_order_relaxed);
+	sequence->store(sequenceValue + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	FRAME* dst = reinterpret_cast<FRAME*>(slot + FRAME_OFFSET);
+	memcpy(dst, &frame, sizeof(FRAME));
+	dst->frameId = frameId;
+	const bool hasImage = image && m_header->imageWidth > 0 && m_header->imageHeight > 0;
+	dst->imageWidth = hasImage ? m_header->imageWidth : 0;
+	dst->imageHeight = hasImage ? m_header->imageHeight : 0;
+	if (hasImage) {
+		memcpy(slot + FRAME_OFFSET + sizeof(FRAME), image, static_cast<size_t>(m_header->imageWidth) * m_header->imageHeight * 3);
+	}
+
+	sequence->store(sequenceValue + 2, std::memory_order_release);
+	m_header->writeCount.store(frameId + 1, std::memory_order_release);
+	return RET_OK;
+}
+
+int32_t ResultBus::readSlot(uint32_t frameId, FRAME& frame, std::vector<uint8_t>* image)
+{
+	const uint8_t* slot = getSlot(frameId);
+	const std::atomic<uint32_t>* sequence = reinterpret_cast<const std::atomic<uint32_t>*>(slot);
+	for (int32_t retry = 0; retry < MAX_RETRY; retry++) {
+		const uint32_t sequence0 = sequence->load(std::memory_order_acquire);
+		if (sequence0 & 1) continue;	// being written
+
+		memcpy(&frame, slot + FRAME_OFFSET, sizeof(FRAME));
+		const size_t imageSize = static_cast<size_t>(frame.imageWidth) * frame.imageHeight * 3;
+		const bool hasImage = image && imageSize > 0 && FRAME_OFFSET + sizeof(FRAME) + imageSize <= m_header->slotSize;
+		if (hasImage) {
+			image->resize(imageSize);
+			memcpy(image->data(), slot + FRAME_OFFSET + sizeof(FRAME), imageSize);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint32_t sequence1 = sequence->load(std::memory_order_relaxed);
+		if (sequence0 == sequence1) {
+			if (image && !hasImage) image->clear();
+			return (frame.frameId == frameId) ? RET_OK : RET_OVERRUN;
+		}
+	}
+	/* the writer is faster than copying the slot */
+	return RET_OVERRUN;
+}
+
+int32_t ResultBus::readLatest(FRAME& frame, std::vector<uint8_t>* image)
+{
+	if (!m_header || m_mode != MODE_READ) {
+		PRINT_E("Not opened for read\n");
+		return RET_ERR;
+	}
+	for (int32_t retry = 0; retry < MAX_RETRY; retry++) {
+		const uint32_t writeCount = m_header->writeCount.load(std::memory_order_acquire);
+		if (writeCount == 0) return RET_NO_DATA;
+		const uint32_t frameId = writeCount - 1;
+		if (m_hasRead && frameId == m_lastFrameId) return RET_NO_DATA;
+		if (readSlot(frameId, frame, image) == RET_OK) {
+			m_lastFrameId = frameId;
+			m_hasRead = true;
+			return RET_OK;
+		}
+	}
+	return RET_NO_DATA;
+}
+
+int32_t ResultBus::readNext(FRAME& frame, std::vector<uint8_t>* image)
+{
+	if (!m_header || m_mode != MODE_READ) {
+		PRINT_E("Not opened for read\n");
+		return RET_ERR;
+	}
+	if (!m_hasRead) {
+		return readLatest(frame, image);
+	}
+	const uint32_t writeCount = m_header->writeCount.load(std::memory_order_acquire);
+	const uint32_t frameId = m_lastFrameId + 1;
+	if (writeCount == frameId) return RET_NO_DATA;
+	if (writeCount - frameId > m_header->slotNum - 1 || readSlot(frameId, frame, image) != RET_OK) {
+		/* skip to the oldest frame which will not be overwritten soon */
+		m_lastFrameId = writeCount - (std::min)(writeCount, m_header->slotNum / 2) - 1;
+		return RET_OVERRUN;
+	}
+	m_lastFrameId = frameId;
+	return RET_OK;
+}
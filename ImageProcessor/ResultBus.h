@@ -0,0 +1,101 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef RESULT_BUS_
+#define RESULT_BUS_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+
+/* for My modules */
+#include "PoseAnalyzer.h"
+
+/* Publish the result of each frame to other processes through POSIX shared memory */
+/* The bus is a ring of slots, each of which is protected by a sequence counter (seqlock). */
+/* The writer never waits for readers, and readers map the memory read-only, so they cannot slow down or block the writer. */
+/* A reader retries when the slot is overwritten while copying it */
+class ResultBus {
+public:
+	static constexpr int32_t NUM_JOINTS = 17;
+	static constexpr int32_t NUM_SLOTS = 8;
+	static constexpr const char* DEFAULT_NAME = "/bittle_result_bus";
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+		RET_NO_DATA = -2,	// no new frame
+		RET_OVERRUN = -3,	// frames are overwritten before read (readNext only)
+	};
+
+	enum {
+		MODE_READ = 0,
+		MODE_WRITE,
+	};
+
+	/* note: must be trivially copyable because it's copied into shared memory as it is */
+	typedef struct FRAME_ {
+		uint32_t frameId;
+		double   timestamp;					// [msec] steady clock (CLOCK_MONOTONIC)
+		float    jointX[NUM_JOINTS];			// 0 - 1.0
+		float    jointY[NUM_JOINTS];
+		float    jointScore[NUM_JOINTS];
+		PoseAnalyzer::RESULT poseResult;
+		int32_t  gesture;					// GestureRecognizer::GESTURE_xxx
+		char     command[32];				// command decided in this frame. empty if not changed
+		int32_t  imageWidth;				// 0 if image is not published
+		int32_t  imageHeight;
+	} FRAME;
+
+public:
+	ResultBus() : m_mode(MODE_READ), m_size(0), m_header(nullptr), m_lastFrameId(0), m_hasRead(false) {}
+	~ResultBus() { close(); }
+	int32_t open(const std::string& name, int32_t mode, int32_t imageWidth = 0, int32_t imageHeight = 0);	// image size is for MODE_WRITE
+	void    close();
+	bool    isOpened() const { return m_header != nullptr; }
+
+	/* for MODE_WRITE */
+	int32_t write(const FRAME& frame, const uint8_t* image);	// image is BGR (imageWidth x imageHeight x 3) or nullptr
+
+	/* for MODE_READ */
+	int32_t readLatest(FRAME& frame, std::vector<uint8_t>* image = nullptr);	// skip to the latest frame
+	int32_t readNext(FRAME& frame, std::vector<uint8_t>* image = nullptr);		// the next frame of the last read
+
+private:
+	typedef struct HEADER_ {
+		uint32_t magic;			// set at the end of initialization
+		uint32_t version;
+		uint32_t slotNum;
+		uint32_t slotSize;		// [byte] including sequence counter, FRAME and image
+		int32_t  imageWidth;
+		int32_t  imageHeight;
+		std::atomic<uint32_t> writeCount;
+	} HEADER;
+
+	uint8_t* getSlot(uint32_t index) const;
+	int32_t  readSlot(uint32_t frameId, FRAME& frame, std::vector<uint8_t>* image);
+
+private:
+	std::string m_name;
+	int32_t     m_mode;
+	size_t      m_size;
+	HEADER*     m_header;
+	uint32_t    m_lastFrameId;
+	bool        m_hasRead;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "SteeringController.h"
+
+/*** Macro ***/
+#define TAG "SteeringController"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/* Hysteresis to quantize control values into gaits. {enter, exit} */
+static constexpr float THRESHOLD_CRAWL[2] = { 0.25f, 0.05f };
+static constexpr float THRESHOLD_WALK[2]  = { 0.60f, 0.45f };
+static constexpr float THRESHOLD_BACK[2]  = { 0.20f, 0.10f };
+static constexpr float THRESHOLD_TURN[2]  = { 0.35f, 0.20f };
+
+/*** Function ***/
+static float clamp(float value, float minValue, float maxValue)
+{
+    return (std::min)((std::max)(value, minValue), maxValue);
+}
+
+static float filter(float coeff, float current, float value)
+{
+    /* invalid value (< 0) is ignored */
+    if (value <= 0) return current;
+    if (current <= 0) return value;
+    return coeff * current + (1 - coeff) * value;
+}
+
+static float limitRate(float current, float target, float maxDelta)
+{
+    return current + clamp(target - current, -maxDelta, maxDelta);
+}
+
+SteeringController::SteeringController()
+{
+    reset();
+}
+
+void SteeringController::reset()
+{
+    m_isFirst = true;
+    m_lastControlTime = 0;
+    m_filteredX = 0;
+    m_filteredBodySize = -1;
+    m_filteredDistance = -1;
+    m_steering = 0;
+    m_speed = 0;
+    m_gait = GAIT_STOP;
+    m_turn = TURN_NONE;
+}
+
+bool SteeringController::update(const PoseAnalyzer::RESULT& poseResult)
+{
+    /*** Filter input every frame ***/
+    if (m_isFirst) {
+        m_filteredX = poseResult.x;
+        m_lastControlTime = poseResult.timestamp;
+        m_isFirst = false;
+    } else {
+        m_filteredX = m_param.filterCoeff * m_filteredX + (1 - m_param.filterCoeff) * poseResult.x;
+    }
+    m_filteredBodySize = filter(m_param.filterCoeff, m_filteredBodySize, poseResult.bodySize);
+    m_filteredDistance = filter(m_param.filterCoeff, m_filteredDistance, poseResult.distance);
+
+    /*** Update control values at the fixed rate ***/
+    const double elapsed = poseResult.timestamp - m_lastControlTime;
+    if (elapsed < m_param.controlPeriod) {
+        return false;
+    }
+    m_lastControlTime = poseResult.timestamp;
+
+    float targetSteering = clamp(m_param.gainSteering * m_filteredX, -1.0f, 1.0f);
+    float targetSpeed = 0;
+    if (m_filteredDistance > 0) {
+        targetSpeed = clamp(m_param.gainSpeed * (m_filteredDistance - m_param.targetDistance) / m_param.targetDistance, -1.0f, 1.0f);
+    } else if (m_filteredBodySize > 0) {
+        targetSpeed = clamp(m_param.gainSpeed * (m_param.targetBodySize - m_filteredBodySize) / m_param.targetBodySize, -1.0f, 1.0f);
+    }
+
+    const float dt = static_cast<float>((std::min)(elapsed, 2 * m_param.controlPeriod) / 1000.0);
+    m_steering = limitRate(m_steering, targetSteering, m_param.maxSteeringRate * dt);
+    m_speed = limitRate(m_speed, targetSpeed, m_param.maxSpeedRate * dt);
+
+    quantize();
+    return true;
+}
+
+void SteeringController::quantize()
+{
+    /*** Speed ***/
+    switch (m_gait) {
+    case GAIT_BACK:
+        if (m_speed > -THRESHOLD_BACK[1]) m_gait = GAIT_STOP;
+        break;
+    case GAIT_WALK:
+        if (m_speed < THRESHOLD_WALK[1]) m_gait = GAIT_CRAWL;
+        break;
+    case GAIT_CRAWL:
+        if (m_speed > THRESHOLD_WALK[0]) m_gait = GAIT_WALK;
+        if (m_speed < THRESHOLD_CRAWL[1]) m_gait = GAIT_STOP;
+        break;
+    case GAIT_STOP:
+    default:
+        if (m_speed > THRESHOLD_CRAWL[0]) m_gait = GAIT_CRAWL;
+        if (m_speed < -THRESHOLD_BACK[0]) m_gait = GAIT_BACK;
+        break;
+    }
+
+    /*** Steering ***/
+    if (m_turn == TURN_NONE) {
+        if (m_steering > THRESHOLD_TURN[0]) m_turn = TURN_RIGHT;
+        if (m_steering < -THRESHOLD_TURN[0]) m_turn = TURN_LEFT;
+    } else {
+        if ((std::abs)(m_steering) < THRESHOLD_TURN[1]) m_turn = TURN_NONE;
+    }
+}
+
+std::string SteeringController::getCommand() const
+{
+    /* OpenCat doesn't have continuous steering. Use the gait closest to the control values */
+    const char* direction = (m_turn == TURN_LEFT) ? "L" : (m_turn == TURN_RIGHT) ? "R" : "F";
+    switch (m_gait) {
+    case GAIT_BACK:
+        return (m_turn == TURN_NONE) ? "kbk" : std::string("kbk") + direction;
+    case GAIT_WALK:
+        return std::string("kwk") + direction;
+    case GAIT_CRAWL:
+        return std::string("kcr") + direction;
+    case GAIT_STOP:
+    default:
+        /* turn slowly when the person is at the proper distance */
+        return (m_turn == TURN_NONE) ? "kbalance" : std::string("kcr") + direction;
+    }
+}
@@ -0,0 +1,91 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef STEERING_CONTROLLER_
+#define STEERING_CONTROLLER_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+
+#include "PoseAnalyzer.h"
+
+/* Convert the position and size of the person into continuous steering and speed */
+/* The control values are updated at a fixed rate with rate limiting, then quantized into gait commands with hysteresis */
+class SteeringController {
+public:
+	typedef struct PARAM_ {
+		double controlPeriod;	// [msec]
+		float  gainSteering;	// steering = gain * x
+		float  gainSpeed;		// speed = gain * (distance - target) / target, or gain * (target - bodySize) / target
+		float  targetDistance;	// [m] keep this distance if distance is estimated
+		float  targetBodySize;	// keep this body size (normalized by image size) if distance is not estimated
+		float  maxSteeringRate;	// [1/sec]
+		float  maxSpeedRate;	// [1/sec]
+		float  filterCoeff;		// low pass filter for input (0: no filter ~ 1: never update)
+		PARAM_()
+			: controlPeriod(200)
+			, gainSteering(1.5f)
+			, gainSpeed(1.5f)
+			, targetDistance(1.5f)
+			, targetBodySize(0.25f)
+			, maxSteeringRate(2.0f)
+			, maxSpeedRate(1.0f)
+			, filterCoeff(0.8f)
+		{}
+	} PARAM;
+
+	enum {
+		GAIT_BACK = -1,
+		GAIT_STOP = 0,
+		GAIT_CRAWL,
+		GAIT_WALK,
+	};
+
+	enum {
+		TURN_LEFT = -1,
+		TURN_NONE = 0,
+		TURN_RIGHT,
+	};
+
+public:
+	SteeringController();
+	~SteeringController() {}
+	void  setParam(const PARAM& param) { m_param = param; }
+	const PARAM& getParam() const { return m_param; }
+	void  reset();
+	bool  update(const PoseAnalyzer::RESULT& poseResult);	// return true when control values are updated
+	float getSteering() const { return m_steering; }	// -1.0(left) ~ 1.0(right)
+	float getSpeed() const { return m_speed; }		// -1.0(backward) ~ 1.0(forward)
+	std::string getCommand() const;
+
+private:
+	void  quantize();
+
+private:
+	PARAM  m_param;
+	bool   m_isFirst;
+	double m_lastControlTime;
+	float  m_filteredX;
+	float  m_filteredBodySize;
+	float  m_filteredDistance;
+	float  m_steering;
+	float  m_speed;
+	int32_t m_gait;
+	int32_t m_turn;
+};
+
+#endif
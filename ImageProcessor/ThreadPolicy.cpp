@@ -0,0 +1,255 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+/* for pthread */
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "ThreadPolicy.h"
+#include "Tracer.h"
+
+/*** Macro ***/
+#define TAG "ThreadPolicy"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Global variable ***/
+typedef struct {
+	ThreadPolicy::THREAD_STAT stat;
+	std::chrono::steady_clock::time_point tStart;
+	double  timeCpuStart;
+	int64_t numContextSwitchStart;
+	bool    isRunning;
+} THREAD_ENTRY;
+
+static std::mutex s_mutex;
+static std::vector<THREAD_ENTRY> s_threadEntryList;
+static thread_local int32_t s_threadEntryIndex = -1;
+
+/*** Function ***/
+static void getThreadUsage(double& timeCpu, int64_t& numContextSwitch)
+{
+	timeCpu = 0;
+	numContextSwitch = 0;
+#ifdef __linux__
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+		timeCpu = ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+	}
+	struct rusage usage;
+	if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+		numContextSwitch = usage.ru_nivcsw;
+	}
+#endif
+}
+
+static double getProcessCpuTime()
+{
+#ifdef __linux__
+	struct timespec ts;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0) {
+		return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+	}
+#endif
+	return 0;
+}
+
+int32_t ThreadPolicy::parseCpuList(const std::string& cpuList, std::vector<int32_t>& cpuIndexList)
+{
+	cpuIndexList.clear();
+	std::stringstream ss(cpuList);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		if (item.empty()) continue;
+		int32_t first = 0;
+		int32_t last = 0;
+		char dummy;
+		if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &dummy) == 2) {
+			/* range */
+		} else if (sscanf(item.c_str(), "%d%c", &first, &dummy) == 1) {
+			last = first;
+		} else {
+			PRINT_E("Invalid cpu list: %s\n", cpuList.c_str());
+			return RET_ERR;
+		}
+		if (first < 0 || last < first) {
+			PRINT_E("Invalid cpu list: %s\n", cpuList.c_str());
+			return RET_ERR;
+		}
+		for (int32_t i = first; i <= last; i++) {
+			cpuIndexList.push_back(i);
+		}
+	}
+	return RET_OK;
+}
+
+int32_t ThreadPolicy::setAffinity(const std::string& cpuList)
+{
+#ifdef __linux__
+	std::vector<int32_t> cpuIndexList;
+	if (parseCpuList(cpuList, cpuIndexList) != RET_OK) {
+		return RET_ERR;
+	}
+	if (cpuIndexList.empty()) {
+		for (int32_t i = 0; i < getNumCpu(); i++) cpuIndexList.push_back(i);
+	}
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (int32_t index : cpuIndexList) {
+		if (index >= CPU_SETSIZE) {
+			PRINT_E("Invalid cpu: %d\n", index);
+			return RET_ERR;
+		}
+		CPU_SET(index, &cpuSet);
+	}
+	int32_t ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+	if (ret != 0) {
+		PRINT_E("pthread_setaffinity_np(%s) failed (%s)\n", cpuList.c_str(), strerror(ret));
+		return RET_ERR;
+	}
+	return RET_OK;
+#else
+	(void)cpuList;
+	PRINT_E("CPU affinity is not supported\n");
+	return RET_ERR;
+#endif
+}
+
+std::string ThreadPolicy::getAffinity()
+{
+	std::string cpuList;
+#ifdef __linux__
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+		return cpuList;
+	}
+	/* print as ranges (e.g. "0,2-3") */
+	for (int32_t i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET(i, &cpuSet)) continue;
+		int32_t last = i;
+		while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpuSet)) last++;
+		if (!cpuList.empty()) cpuList += ",";
+		cpuList += (last == i) ? std::to_string(i) : std::to_string(i) + "-" + std::to_string(last);
+		i = last;
+	}
+#endif
+	return cpuList;
+}
+
+int32_t ThreadPolicy::setRealtimePriority(int32_t priority)
+{
+#ifdef __linux__
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	int32_t ret = pthread_setschedparam(pthread_self(), (priority > 0) ? SCHED_FIFO : SCHED_OTHER, &param);
+	if (ret != 0) {
+		/* needs root or CAP_SYS_NICE */
+		PRINT_E("pthread_setschedparam(%d) failed (%s)\n", priority, strerror(ret));
+		return RET_ERR;
+	}
+	return RET_OK;
+#else
+	(void)priority;
+	PRINT_E("Realtime priority is not supported\n");
+	return RET_ERR;
+#endif
+}
+
+int32_t ThreadPolicy::getNumCpu()
+{
+	int32_t num = static_cast<int32_t>(std::thread::hardware_concurrency());
+	return (num > 0) ? num : 1;
+}
+
+void ThreadPolicy::registerThread(const std::string& name)
+{
+	THREAD_ENTRY entry;
+	entry.stat.name = name;
+	entry.stat.cpuList = getAffinity();
+	entry.tStart = std::chrono::steady_clock::now();
+	getThreadUsage(entry.timeCpuStart, entry.numContextSwitchStart);
+	entry.isRunning = true;
+	Tracer::setThreadName(name);
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_threadEntryIndex = static_cast<int32_t>(s_threadEntryList.size());
+	s_threadEntryList.push_back(entry);
+}
+
+void ThreadPolicy::unregisterThread()
+{
+	if (s_threadEntryIndex < 0) return;
+
+	double timeCpu;
+	int64_t numContextSwitch;
+	getThreadUsage(timeCpu, numContextSwitch);
+	const auto& tEnd = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	THREAD_ENTRY& entry = s_threadEntryList[s_threadEntryIndex];
+	entry.stat.timeCpu = timeCpu - entry.timeCpuStart;
+	entry.stat.timeWall = static_cast<std::chrono::duration<double>>(tEnd - entry.tStart).count() * 1000.0;
+	entry.stat.numContextSwitch = numContextSwitch - entry.numContextSwitchStart;
+	entry.isRunning = false;
+	s_threadEntryIndex = -1;
+}
+
+std::vector<ThreadPolicy::THREAD_STAT> ThreadPolicy::getReport()
+{
+	std::vector<THREAD_STAT> statList;
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (const auto& entry : s_threadEntryList) {
+		if (!entry.isRunning) statList.push_back(entry.stat);
+	}
+	return statList;
+}
+
+void ThreadPolicy::printReport()
+{
+	const auto& statList = getReport();
+	double timeCpuSum = 0;
+	double timeWallMax = 0;
+	PRINT("=== CPU time per thread ===\n");
+	PRINT("%-12s %-8s %10s %8s %10s\n", "thread", "cpu", "cpu[msec]", "usage", "preempted");
+	for (const auto& stat : statList) {
+		PRINT("%-12s %-8s %10.1f %7.1f%% %10lld\n", stat.name.c_str(), stat.cpuList.c_str(), stat.timeCpu,
+			(stat.timeWall > 0) ? stat.timeCpu * 100.0 / stat.timeWall : 0.0, static_cast<long long>(stat.numContextSwitch));
+		timeCpuSum += stat.timeCpu;
+		if (stat.timeWall > timeWallMax) timeWallMax = stat.timeWall;
+	}
+	const double timeCpuOthers = getProcessCpuTime() - timeCpuSum;
+	PRINT("%-12s %-8s %10.1f %7.1f%%\n", "others", "-", timeCpuOthers, (timeWallMax > 0) ? timeCpuOthers * 100.0 / timeWallMax : 0.0);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THREAD_POLICY_
+#define THREAD_POLICY_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Scheduling policy of threads (CPU affinity, real-time priority) and per-thread CPU time */
+/* note: threads inherit affinity and policy of the creating thread. */
+/*       set affinity of the inference thread before creating the interpreter so that the worker pool of the inference engine follows it */
+class ThreadPolicy {
+public:
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	typedef struct THREAD_STAT_ {
+		std::string name;
+		std::string cpuList;
+		double      timeCpu;			// [msec]
+		double      timeWall;			// [msec] from registerThread to unregisterThread
+		int64_t     numContextSwitch;	// involuntary context switch (preempted by other threads)
+		THREAD_STAT_() : timeCpu(0), timeWall(0), numContextSwitch(0)
+		{}
+	} THREAD_STAT;
+
+public:
+	/* cpuList is like "0", "1-3", "0,2-3". empty means all cores */
+	static int32_t parseCpuList(const std::string& cpuList, std::vector<int32_t>& cpuIndexList);
+	static int32_t setAffinity(const std::string& cpuList);		// for the calling thread
+	static std::string getAffinity();								// for the calling thread
+	static int32_t setRealtimePriority(int32_t priority);			// SCHED_FIFO (1 - 99) for the calling thread. 0 means SCHED_OTHER
+	static int32_t getNumCpu();
+
+	/* measure CPU time of the calling thread between register and unregister */
+	static void    registerThread(const std::string& name);
+	static void    unregisterThread();
+	static void    printReport();	// the rest of process CPU time is shown as "others" (e.g. worker pool of the inference engine)
+	static std::vector<THREAD_STAT> getReport();
+};
+
+#endif
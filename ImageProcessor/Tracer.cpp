@@ -0,0 +1,184 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+/* for My modules */
+#include "CommonHelper.h"
+#include "Tracer.h"
+
+/*** Macro ***/
+#define TAG "Tracer"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Global variable ***/
+typedef struct {
+	const char* name;
+	int64_t     start;		// [nsec]
+	int64_t     duration;	// [nsec]
+} EVENT;
+
+/* note: fields are atomic (relaxed) because the reader may read a slot being overwritten */
+typedef struct {
+	std::atomic<const char*> name;
+	std::atomic<int64_t>     start;
+	std::atomic<int64_t>     duration;
+} SLOT;
+
+/* Single writer (the owner thread). the reader copies events, then discards the ones which may be overwritten during the copy */
+typedef struct THREAD_BUFFER_ {
+	int32_t     tid;
+	std::string name;		// guarded by s_mutex
+	std::array<SLOT, Tracer::BUFFER_SIZE> slotList;
+	std::atomic<uint64_t> writeCount;
+	THREAD_BUFFER_() : tid(0), writeCount(0) {}
+} THREAD_BUFFER;
+
+/* note: buffers are not deleted when the thread exits, so that its spans can be dumped later */
+static std::mutex s_mutex;
+static std::vector<std::unique_ptr<THREAD_BUFFER>> s_bufferList;
+static thread_local THREAD_BUFFER* s_threadBuffer = nullptr;
+
+/*** Function ***/
+static THREAD_BUFFER* getThreadBuffer()
+{
+	if (!s_threadBuffer) {
+		std::unique_ptr<THREAD_BUFFER> buffer(new THREAD_BUFFER());
+		std::lock_guard<std::mutex> lock(s_mutex);
+		buffer->tid = static_cast<int32_t>(s_bufferList.size()) + 1;
+		buffer->name = "thread " + std::to_string(buffer->tid);
+		s_threadBuffer = buffer.get();
+		s_bufferList.push_back(std::move(buffer));
+	}
+	return s_threadBuffer;
+}
+
+bool Tracer::isEnabled()
+{
+#ifdef ENABLE_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+int64_t Tracer::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t end)
+{
+	THREAD_BUFFER* buffer = getThreadBuffer();
+	const uint64_t index = buffer->writeCount.load(std::memory_order_relaxed);
+	SLOT& slot = buffer->slotList[index % BUFFER_SIZE];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.duration.store(end - start, std::memory_order_relaxed);
+	buffer->writeCount.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const std::string& name)
+{
+	if (!isEnabled()) return;
+	THREAD_BUFFER* buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(s_mutex);
+	buffer->name = name;
+}
+
+int32_t Tracer::dump(const std::string& filename)
+{
+	if (!isEnabled()) {
+		PRINT_E("Tracing is disabled. build with ENABLE_TRACE=on\n");
+		return RET_ERR;
+	}
+
+	/* Copy events of each thread */
+	typedef struct {
+		int32_t tid;
+		std::string name;
+		std::vector<EVENT> eventList;
+	} THREAD_EVENT;
+	std::vector<THREAD_EVENT> threadList;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (const auto& buffer : s_bufferList) {
+			THREAD_EVENT thread;
+			thread.tid = buffer->tid;
+			thread.name = buffer->name;
+			const uint64_t countBefore = buffer->writeCount.load(std::memory_order_acquire);
+			const uint64_t first = (countBefore > BUFFER_SIZE) ? countBefore - BUFFER_SIZE : 0;
+			for (uint64_t i = first; i < countBefore; i++) {
+				const SLOT& slot = buffer->slotList[i % BUFFER_SIZE];
+				EVENT event;
+				event.name = slot.name.load(std::memory_order_relaxed);
+				event.start = slot.start.load(std::memory_order_relaxed);
+				event.duration = slot.duration.load(std::memory_order_relaxed);
+				thread.eventList.push_back(event);
+			}
+			/* the slot being written now is (countAfter % BUFFER_SIZE) */
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t countAfter = buffer->writeCount.load(std::memory_order_relaxed);
+			const uint64_t firstValid = (countAfter + 1 > BUFFER_SIZE) ? countAfter + 1 - BUFFER_SIZE : 0;
+			if (firstValid > first) {
+				const size_t numOverwritten = static_cast<size_t>((std::min)(firstValid - first, countBefore - first));
+				thread.eventList.erase(thread.eventList.begin(), thread.eventList.begin() + numOverwritten);
+			}
+			threadList.push_back(std::move(thread));
+		}
+	}
+
+	/* Write in Chrome trace format. time is in usec from the first event */
+	int64_t timeOrigin = INT64_MAX;
+	for (const auto& thread : threadList) {
+		for (const auto& event : thread.eventList) timeOrigin = (std::min)(timeOrigin, event.start);
+	}
+	FILE* fp = fopen(filename.c_str(), "w");
+	if (!fp) {
+		PRINT_E("Failed to open %s\n", filename.c_str());
+		return RET_ERR;
+	}
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool isFirst = true;
+	int32_t numEvent = 0;
+	for (const auto& thread : threadList) {
+		fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", isFirst ? "" : ",\n", thread.tid, thread.name.c_str());
+		isFirst = false;
+		for (const auto& event : thread.eventList) {
+			fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+				event.name, thread.tid, (event.start - timeOrigin) / 1000.0, event.duration / 1000.0);
+			numEvent++;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+	PRINT("Wrote %d spans to %s\n", numEvent, filename.c_str());
+	return RET_OK;
+}
@@ -0,0 +1,65 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TRACER_
+#define TRACER_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Span tracing of each frame, written as Chrome trace JSON (chrome://tracing, https://ui.perfetto.dev) */
+/* Each thread records spans into its own ring buffer without lock, and the buffers are read only when dumped. */
+/* Spans are compiled only with ENABLE_TRACE (cmake -DENABLE_TRACE=on). Otherwise TRACE_SPAN is empty and costs nothing */
+/* note: name must be a string literal (only the pointer is recorded) */
+#ifdef ENABLE_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name)    Tracer::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SPAN(name)
+#endif
+
+class Tracer {
+public:
+	static constexpr int32_t BUFFER_SIZE = 16384;	// [span] per thread. about 30 sec at 30 fps
+
+	enum {
+		RET_OK = 0,
+		RET_ERR = -1,
+	};
+
+	/* Record a span from construction to destruction */
+	class Span {
+	public:
+		explicit Span(const char* name) : m_name(name), m_start(now()) {}
+		~Span() { record(m_name, m_start, now()); }
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+	private:
+		const char* m_name;
+		int64_t     m_start;
+	};
+
+public:
+	static bool    isEnabled();		// built with ENABLE_TRACE
+	static int64_t now();			// [nsec] steady clock
+	static void    record(const char* name, int64_t start, int64_t end);
+	static void    setThreadName(const std::string& name);	// for the calling thread. called by ThreadPolicy::registerThread
+	static int32_t dump(const std::string& filename);		// spans in the buffers of all threads
+};
+
+#endif
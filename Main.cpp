@@ -24,69 +24,427 @@ limitations under the License.
 #include <array>
 #include <algorithm>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
 
 /* for My modules */
 #include "ImageProcessor.h"
+#include "Config.h"
+#include "ResultBus.h"
+#include "ThreadPolicy.h"
+#include "FramePool.h"
+#include "Tracer.h"
 #include "Uart.h"
+#include "CommandProtocol.h"
 
 /*** Macro ***/
 #define WORK_DIR     RESOURCE_DIR
+#define UART_POLL_INTERVAL  10	// [msec] interval to check responses from the robot
+#define FRAME_POOL_SIZE     4	// capture, the latest image, inference and a spare
 
-int32_t main()
+/*** Global variable ***/
+static cv::VideoCapture s_cap;
+static std::atomic<bool> s_isRunning(true);
+static std::atomic<bool> s_isTraceRequested(false);
+
+/* buffers for captured images. no allocation while running */
+static FramePool s_framePool;
+
+/* the latest captured image. older images are dropped when inference is slower than camera */
+static std::mutex s_imageMutex;
+static std::condition_variable s_imageCond;
+static FramePool::FRAME s_image;
+static bool s_isImageUpdated = false;
+
+/* command requested by CommandDecider. deduplication and rate limiting are done by CommandProtocol in the uart thread */
+static std::mutex s_commandMutex;
+static std::condition_variable s_commandCond;
+static std::string s_command;
+static bool s_isCommandUrgent = false;
+static bool s_isPoseValid = false;
+static bool s_isCommandUpdated = false;
+
+static std::chrono::steady_clock::time_point s_tStart;
+
+/*** Function ***/
+static void handleSignal(int32_t)
+{
+	s_isRunning = false;
+}
+
+static void handleTraceSignal(int32_t)
+{
+	s_isTraceRequested = true;
+}
+
+static void printUsage(const char* name)
+{
+	printf("usage: %s [-r keypoint_log_file] [-c] [-d distance] [-w warmup_num] [-t thread_num] [-a cpu_layout] [-p priority] [-m] [-g] [-b] [-s port] [-u device] [-v video] [-q] [-y] [-f] [-o]\n", name);
+	printf("  -r : record keypoints to the file for replay\n");
+	printf("  -c : follow the person with continuous steering\n");
+	printf("  -d : keep the distance [m] to the person (needs calibration)\n");
+	printf("  -w : the number of warmup inferences at startup (default: 2)\n");
+	printf("  -t : the number of inference threads (default: 4)\n");
+	printf("  -a : cpu cores for capture:inference:uart threads (e.g. 0:1-3:0, default: not pinned)\n");
+	printf("  -p : SCHED_FIFO priority (1 - 99) for inference and uart threads (default: 0 = not realtime)\n");
+	printf("  -m : multi-scale mode. search a distant person with tiles and crop around the person\n");
+	printf("  -g : skip pose estimation while the person detector finds nobody\n");
+	printf("  -b : publish results and 160x120 frame to shared memory for other processes\n");
+	printf("  -s : serve preview (MJPEG and keypoints) at http://127.0.0.1:port instead of showing a window\n");
+	printf("  -u : uart device (default: /dev/serial0. e.g. pty of ./Tools/BittleSimulator)\n");
+	printf("  -v : use the video file instead of camera. stop at the end of the video\n");
+	printf("  -q : load several models and switch them to keep inference time within inferenceBudget in config.txt\n");
+	printf("  -y : run inference asynchronously and show camera image at camera rate\n");
+	printf("  -f : count fingers of a raised hand (needs resource/model/hand_landmark_lite.tflite)\n");
+	printf("  -o : accept commands only from the person who took control. cross arms to release it\n");
+	printf("  key t (or SIGUSR1) writes spans of the recent frames to trace_N.json (build with ENABLE_TRACE=on)\n");
+}
+
+static double getElapsedMsec(const std::chrono::steady_clock::time_point& t0)
+{
+	return static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t0).count() * 1000.0;
+}
+
+static void captureThread(std::string cpuList, bool isVideoFile, int32_t width, int32_t height)
+{
+	if (!cpuList.empty()) (void)ThreadPolicy::setAffinity(cpuList);
+	ThreadPolicy::registerThread("capture");
+	/* video file is read at its frame rate, as camera */
+	const double fps = isVideoFile ? s_cap.get(cv::CAP_PROP_FPS) : 0;
+	const auto& t0 = std::chrono::steady_clock::now();
+	int32_t frameIndex = 0;
+	while (s_isRunning) {
+		/* note: cap.read writes into the buffer as long as the size is the same */
+		FramePool::FRAME image = s_framePool.acquire(width, height, CV_8UC3);
+		if (isVideoFile) {
+			if (fps > 0) std::this_thread::sleep_until(t0 + std::chrono::microseconds(static_cast<int64_t>(frameIndex * 1000000 / fps)));
+			frameIndex++;
+		}
+		bool isRead;
+		{
+			TRACE_SPAN("capture");
+			isRead = s_cap.read(image.mat) && !image.mat.empty();
+		}
+		if (!isRead) {
+			if (isVideoFile) {
+				s_isRunning = false;
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(s_imageMutex);
+		s_image = image;
+		s_isImageUpdated = true;
+		s_imageCond.notify_one();
+	}
+	ThreadPolicy::unregisterThread();
+}
+
+static void uartThread(Uart* uart, std::string cpuList, int32_t priority)
+{
+	if (!cpuList.empty()) (void)ThreadPolicy::setAffinity(cpuList);
+	if (priority > 0) (void)ThreadPolicy::setRealtimePriority(priority);
+	ThreadPolicy::registerThread("uart");
+	const auto& t0 = std::chrono::steady_clock::now();
+	CommandProtocol protocol;
+	protocol.initialize(CommandProtocol::PARAM());
+	std::vector<CommandProtocol::RESPONSE> responseList;
+	while (s_isRunning) {
+		/* Watchdog timeout can be changed while running */
+		protocol.setWatchdogTimeout(Config::get().watchdogTimeout);
+
+		/* Wait for a new command, or for the time to send the held command / heartbeat / watchdog stop */
+		std::string command;
+		bool isUrgent = false;
+		bool isPoseValid = false;
+		{
+			const double waitTime = (std::min)(protocol.getWaitTime(getElapsedMsec(t0)), static_cast<double>(UART_POLL_INTERVAL));
+			std::unique_lock<std::mutex> lock(s_commandMutex);
+			s_commandCond.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(waitTime * 1000)), [] { return s_isCommandUpdated || !s_isRunning; });
+			if (s_isCommandUpdated) {
+				command = s_command;
+				isUrgent = s_isCommandUrgent;
+				isPoseValid = s_isPoseValid;
+				s_isCommandUpdated = false;
+			}
+		}
+		if (isPoseValid) protocol.feedWatchdog(getElapsedMsec(t0));
+		if (!command.empty()) protocol.request(command, getElapsedMsec(t0), isUrgent);
+
+		std::string frame;
+		while (protocol.getFrame(getElapsedMsec(t0), frame)) {
+			TRACE_SPAN("uart send");
+			if (uart->send(frame.c_str()) < 0) {
+				printf("[ERR] uart.send\n");
+			}
+		}
+
+		/* Read responses from the robot */
+		char buffer[256];
+		int32_t size = uart->recv(buffer, sizeof(buffer), 0);
+		if (size > 0) {
+			responseList.clear();
+			protocol.parse(buffer, size, getElapsedMsec(t0), responseList);
+			for (const auto& response : responseList) {
+				if (!response.isAck) printf("UART: %s\n", response.text.c_str());
+			}
+		}
+	}
+	protocol.printStatistics();
+	ThreadPolicy::unregisterThread();
+}
+
+static void passResult(const OUTPUT_PARAM& outputParam)
+{
+	static bool isFirstFrame = true;
+	static char command[32] = "";
+	if (isFirstFrame) {
+		printf("Startup: first frame = %.1f [msec] (inference = %.1f [msec])\n", getElapsedMsec(s_tStart), outputParam.timeInference);
+		isFirstFrame = false;
+	}
+
+	/* Pass command to the uart thread */
+	if (outputParam.command[0] != 0 && strncmp(command, outputParam.command, sizeof(command)) != 0) {
+		strncpy(command, outputParam.command, sizeof(command));
+		printf("CMD = %s\n", command);
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_commandMutex);
+		/* note: keep the command not yet taken by the uart thread if no command is decided in this frame */
+		if (outputParam.command[0] != 0 || !s_isCommandUpdated) {
+			s_command = outputParam.command;
+			s_isCommandUrgent = (outputParam.commandPriority > 0);
+		}
+		s_isPoseValid = (outputParam.isPoseValid != 0);
+		s_isCommandUpdated = true;
+		s_commandCond.notify_one();
+	}
+}
+
+static void onProcessed(int32_t status, const cv::Mat*, const OUTPUT_PARAM* outputParam, void*)
 {
+	if (status == IMAGE_PROCESSOR_DONE) passResult(*outputParam);
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	s_tStart = std::chrono::steady_clock::now();
+
+	/*** Parse arguments ***/
+	const char* keypointLogFile = "";
+	int32_t controlMode = 0;
+	float targetDistance = 1.5f;
+	int32_t numWarmup = 2;
+	int32_t numThreads = 4;
+	std::array<std::string, 3> cpuLayout;	// capture, inference, uart
+	int32_t priority = 0;
+	int32_t scaleMode = 0;
+	int32_t usePersonDetector = 0;
+	bool useResultBus = false;
+	int32_t previewPort = 0;
+	const char* uartDevice = "/dev/serial0";
+	std::string videoFile;
+	int32_t useModelLadder = 0;
+	bool isAsync = false;
+	int32_t useHandEngine = 0;
+	int32_t useOperatorLock = 0;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			keypointLogFile = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0) {
+			controlMode = 1;
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			targetDistance = static_cast<float>(atof(argv[++i]));
+			if (controlMode == 0) controlMode = 2;
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			numWarmup = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			numThreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			std::string layout = argv[++i];
+			for (auto& cpuList : cpuLayout) {
+				size_t pos = layout.find(':');
+				cpuList = layout.substr(0, pos);
+				layout = (pos == std::string::npos) ? "" : layout.substr(pos + 1);
+			}
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			priority = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0) {
+			scaleMode = 1;
+		} else if (strcmp(argv[i], "-g") == 0) {
+			usePersonDetector = 1;
+		} else if (strcmp(argv[i], "-b") == 0) {
+			useResultBus = true;
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			previewPort = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+			uartDevice = argv[++i];
+		} else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+			videoFile = argv[++i];
+		} else if (strcmp(argv[i], "-q") == 0) {
+			useModelLadder = 1;
+		} else if (strcmp(argv[i], "-y") == 0) {
+			isAsync = true;
+		} else if (strcmp(argv[i], "-f") == 0) {
+			useHandEngine = 1;
+		} else if (strcmp(argv[i], "-o") == 0) {
+			useOperatorLock = 1;
+		} else {
+			printUsage(argv[0]);
+			return -1;
+		}
+	}
+
 	/*** Initialize ***/
 	/* Initialize uart */
 	Uart uart;
-	if (uart.initialize("/dev/serial0") < 0) {
+	if (uart.initialize(uartDevice) < 0) {
 		printf("[ERR] uart.initialize\n");
 	}
 
+	/* Initialize camera */
+	/* note: opening camera takes time, so do it while loading model */
+	std::thread cameraThread([&videoFile]() {
+		if (!videoFile.empty()) {
+			s_cap = cv::VideoCapture(videoFile);
+			return;
+		}
+#ifdef _WIN32
+		s_cap = cv::VideoCapture(cv::CAP_DSHOW + 0);
+#else
+		s_cap = cv::VideoCapture(0);
+#endif
+		s_cap.set(cv::CAP_PROP_FRAME_WIDTH, 640);
+		s_cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
+		// s_cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('B', 'G', 'R', '3'));
+		s_cap.set(cv::CAP_PROP_BUFFERSIZE, 1);
+	});
+
+	/* Pin this thread before creating the interpreter so that its worker threads inherit the affinity */
+	if (!cpuLayout[1].empty()) (void)ThreadPolicy::setAffinity(cpuLayout[1]);
+
 	/* Initialize image processor library */
 	INPUT_PARAM inputParam;
 	snprintf(inputParam.workDir, sizeof(inputParam.workDir), WORK_DIR);
-	inputParam.numThreads = 4;
-	ImageProcessor_initialize(&inputParam);
+	inputParam.numThreads = numThreads;
+	snprintf(inputParam.keypointLogFile, sizeof(inputParam.keypointLogFile), "%s", keypointLogFile);
+	inputParam.controlMode = controlMode;
+	inputParam.targetDistance = targetDistance;
+	inputParam.numWarmup = numWarmup;
+	inputParam.scaleMode = scaleMode;
+	inputParam.usePersonDetector = usePersonDetector;
+	snprintf(inputParam.resultBusName, sizeof(inputParam.resultBusName), "%s", useResultBus ? ResultBus::DEFAULT_NAME : "");
+	inputParam.resultBusImageWidth = 160;
+	inputParam.resultBusImageHeight = 120;
+	inputParam.previewPort = previewPort;
+	inputParam.useModelLadder = useModelLadder;
+	inputParam.useHandEngine = useHandEngine;
+	inputParam.useOperatorLock = useOperatorLock;
+	if (ImageProcessor_initialize(&inputParam) != 0) {
+		printf("[ERR] ImageProcessor_initialize\n");
+		cameraThread.join();
+		uart.finalize();
+		return -1;
+	}
+	const double timeInitialize = getElapsedMsec(s_tStart);
 
-	/* Initialize camera */
-	static cv::VideoCapture cap;
-#ifdef _WIN32
-	cap = cv::VideoCapture(cv::CAP_DSHOW + 0);
-#else
-	cap = cv::VideoCapture(0);
+	/* Realtime priority is set after the worker threads are created, so that they don't starve the other threads */
+	if (priority > 0) (void)ThreadPolicy::setRealtimePriority(priority);
+
+	cameraThread.join();
+	printf("Startup: initialize = %.1f [msec], camera ready = %.1f [msec]\n", timeInitialize, getElapsedMsec(s_tStart));
+
+	if (!s_cap.isOpened()) {
+		printf("[ERR] Failed to open %s\n", videoFile.empty() ? "camera" : videoFile.c_str());
+		ImageProcessor_finalize();
+		uart.finalize();
+		return -1;
+	}
+	const int32_t imageWidth = static_cast<int32_t>(s_cap.get(cv::CAP_PROP_FRAME_WIDTH));
+	const int32_t imageHeight = static_cast<int32_t>(s_cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+	if (s_framePool.initialize(imageWidth, imageHeight, CV_8UC3, FRAME_POOL_SIZE) != FramePool::RET_OK) {
+		printf("[ERR] framePool.initialize (%d x %d)\n", imageWidth, imageHeight);
+		ImageProcessor_finalize();
+		uart.finalize();
+		return -1;
+	}
+
+	signal(SIGINT, handleSignal);
+#ifndef _WIN32
+	signal(SIGUSR1, handleTraceSignal);
 #endif
-	cap.set(cv::CAP_PROP_FRAME_WIDTH, 640);
-	cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
-	// cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('B', 'G', 'R', '3'));
-	cap.set(cv::CAP_PROP_BUFFERSIZE, 1);
+	std::thread capture(captureThread, cpuLayout[0], !videoFile.empty(), imageWidth, imageHeight);
+	std::thread sender(uartThread, &uart, cpuLayout[2], priority);
+	ThreadPolicy::registerThread("inference");
 
-	char command[32] = "";
+	if (isAsync) ImageProcessor_setCallback(onProcessed, nullptr);
 
-	while (1) {
-		/* Read image */
-		cv::Mat originalImage;
-		cap.read(originalImage);
+	while (s_isRunning) {
+		/* Wait for the latest image */
+		FramePool::FRAME image;
+		{
+			std::unique_lock<std::mutex> lock(s_imageMutex);
+			if (s_imageCond.wait_for(lock, std::chrono::milliseconds(100), [] { return s_isImageUpdated; })) {
+				image = s_image;
+				s_image = FramePool::FRAME();
+				s_isImageUpdated = false;
+			}
+		}
+		cv::Mat& originalImage = image.mat;
+		if (originalImage.empty()) {
+			if (previewPort == 0 && cv::waitKey(1) == 'q') break;
+			continue;
+		}
 
 		/* Call image processor library */
-		OUTPUT_PARAM outputParam;
-		ImageProcessor_process(&originalImage, &outputParam);
+		if (isAsync) {
+			/* the result is passed to the uart thread in the callback. show the latest result on the current image */
+			(void)ImageProcessor_submit(&originalImage);
+			OUTPUT_PARAM outputParam;
+			if (previewPort == 0 && ImageProcessor_poll(IMAGE_PROCESSOR_TICKET_LATEST, nullptr, &outputParam) == IMAGE_PROCESSOR_DONE) {
+				cv::putText(originalImage, outputParam.command, cv::Point(50, 200), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255, 0, 0), 2);
+			}
+		} else {
+			OUTPUT_PARAM outputParam;
+			ImageProcessor_process(&originalImage, &outputParam);
+			passResult(outputParam);
+		}
 
 		/* Display the processed image */
-		cv::imshow("test", originalImage);
-		if (cv::waitKey(1) == 'q') break;
-
-		/* Send command when it's updated */
-		if (outputParam.command[0] != 0 && strncmp(command, outputParam.command, sizeof(command)) != 0) {
-			strncpy(command, outputParam.command, sizeof(command));
-			printf("CMD = %s\n", command);
-			if (uart.send(command) < 0) {
-				printf("[ERR] uart.send\n");
-			}
+		/* note: with preview server, the image is sent from ImageProcessor. stop with Ctrl-C */
+		if (previewPort == 0) {
+			cv::imshow("test", originalImage);
+			const int32_t key = cv::waitKey(1);
+			if (key == 'q') break;
+			if (key == 't') s_isTraceRequested = true;
+		}
+
+		/* Write spans on request ('t' key or SIGUSR1) */
+		if (s_isTraceRequested.exchange(false)) {
+			(void)ImageProcessor_command(IMAGE_PROCESSOR_COMMAND_DUMP_TRACE);
 		}
 	}
 
+	/* Stop threads */
+	ThreadPolicy::unregisterThread();
+	s_isRunning = false;
+	{
+		std::lock_guard<std::mutex> lock(s_commandMutex);
+		s_commandCond.notify_one();
+	}
+	capture.join();
+	sender.join();
+	ThreadPolicy::printReport();
+	s_image = FramePool::FRAME();
+	s_framePool.printStatistics("capture");
+
 	/* Fianlize image processor library */
 	ImageProcessor_finalize();
 	uart.finalize();
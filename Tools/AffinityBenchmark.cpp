@@ -0,0 +1,185 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "PoseEngine.h"
+#include "ThreadPolicy.h"
+
+/*** Macro ***/
+#define WORK_DIR     RESOURCE_DIR
+#define LOAD_PERIOD  33		// [msec] emulate capture and drawing at 30 fps
+
+/*** Function ***/
+typedef struct CASE_ {
+	int32_t     numThreads;
+	std::string name;
+	std::string cpuInference;
+	std::string cpuLoad;		// capture and uart
+	double      timeAvg;
+	double      timeStddev;
+	double      timeP95;
+	double      timeMax;
+	CASE_(int32_t _numThreads, const std::string& _name, const std::string& _cpuInference, const std::string& _cpuLoad)
+		: numThreads(_numThreads), name(_name), cpuInference(_cpuInference), cpuLoad(_cpuLoad)
+		, timeAvg(0), timeStddev(0), timeP95(0), timeMax(0)
+	{}
+} CASE;
+
+static std::string createCpuRange(int32_t first, int32_t last)
+{
+	return (first == last) ? std::to_string(first) : std::to_string(first) + "-" + std::to_string(last);
+}
+
+/* Emulate capture, drawing and display which run with inference in the main application */
+static void loadThread(const cv::Mat* image, std::string cpuList, std::atomic<bool>* isRunning)
+{
+	if (!cpuList.empty()) (void)ThreadPolicy::setAffinity(cpuList);
+	cv::Mat resized, gray, blurred;
+	auto tNext = std::chrono::steady_clock::now();
+	while (*isRunning) {
+		cv::resize(*image, resized, cv::Size(640, 480));
+		cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
+		cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 0);
+		tNext += std::chrono::milliseconds(LOAD_PERIOD);
+		std::this_thread::sleep_until(tNext);
+	}
+}
+
+static int32_t runCase(const cv::Mat& image, int32_t numFrames, CASE& benchCase)
+{
+	/* Inference engine creates worker threads at initialization, and they inherit the affinity of this thread */
+	if (!benchCase.cpuInference.empty() && ThreadPolicy::setAffinity(benchCase.cpuInference) != ThreadPolicy::RET_OK) {
+		return -1;
+	}
+
+	PoseEngine poseEngine;
+	if (poseEngine.initialize(WORK_DIR, benchCase.numThreads) != PoseEngine::RET_OK) {
+		return -1;
+	}
+	(void)poseEngine.warmup(2);
+
+	std::atomic<bool> isRunning(true);
+	std::thread load(loadThread, &image, benchCase.cpuLoad, &isRunning);
+
+	std::vector<double> timeList;
+	for (int32_t i = 0; i < numFrames; i++) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		PoseEngine::RESULT result;
+		if (poseEngine.invoke(image, result) != PoseEngine::RET_OK) break;
+		const auto& t1 = std::chrono::steady_clock::now();
+		timeList.push_back(static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0);
+	}
+
+	isRunning = false;
+	load.join();
+	poseEngine.finalize();
+	if (timeList.empty()) return -1;
+
+	std::sort(timeList.begin(), timeList.end());
+	double sum = 0;
+	double sumSquare = 0;
+	for (const auto& t : timeList) {
+		sum += t;
+		sumSquare += t * t;
+	}
+	benchCase.timeAvg = sum / timeList.size();
+	benchCase.timeStddev = std::sqrt((std::max)(0.0, sumSquare / timeList.size() - benchCase.timeAvg * benchCase.timeAvg));
+	benchCase.timeP95 = timeList[timeList.size() * 95 / 100];
+	benchCase.timeMax = timeList.back();
+	return 0;
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	if (argc < 2) {
+		printf("usage: %s image_file [frame_num]\n", argv[0]);
+		return -1;
+	}
+	const int32_t numFrames = (argc > 2) ? atoi(argv[2]) : 50;
+
+	cv::Mat image = cv::imread(argv[1]);
+	if (image.empty()) {
+		printf("[ERR] Failed to read %s\n", argv[1]);
+		return -1;
+	}
+
+	/*** Create cases: the number of threads x affinity layout ***/
+	const int32_t numCpu = ThreadPolicy::getNumCpu();
+	const std::string cpuAll = createCpuRange(0, numCpu - 1);
+	std::vector<CASE> caseList;
+	for (int32_t numThreads = 1; numThreads <= (std::min)(numCpu, 4); numThreads++) {
+		/* scheduled by OS */
+		caseList.push_back(CASE(numThreads, "free", "", ""));
+		/* all threads share all cores */
+		caseList.push_back(CASE(numThreads, "shared", cpuAll, cpuAll));
+		/* capture and uart use core 0, inference uses the others */
+		if (numThreads < numCpu) {
+			caseList.push_back(CASE(numThreads, "isolated", createCpuRange(1, numCpu - 1), "0"));
+		}
+		/* capture and uart use the last core, inference uses the first numThreads cores */
+		if (numThreads < numCpu) {
+			caseList.push_back(CASE(numThreads, "compact", createCpuRange(0, numThreads - 1), std::to_string(numCpu - 1)));
+		}
+	}
+
+	/*** Run ***/
+	/* each case runs in a new thread so that affinity of the previous case is not inherited */
+	for (auto& benchCase : caseList) {
+		int32_t ret = -1;
+		std::thread th([&]() { ret = runCase(image, numFrames, benchCase); });
+		th.join();
+		if (ret != 0) {
+			printf("[ERR] %d threads, %s\n", benchCase.numThreads, benchCase.name.c_str());
+			benchCase.timeP95 = -1;
+		}
+	}
+
+	/*** Report ***/
+	/* jitter matters for control, so the best one is chosen by p95 rather than average */
+	printf("%-8s %-9s %-10s %-6s %8s %8s %8s %8s\n", "threads", "layout", "inference", "load", "avg", "stddev", "p95", "max");
+	const CASE* bestCase = nullptr;
+	for (const auto& benchCase : caseList) {
+		if (benchCase.timeP95 < 0) continue;
+		printf("%-8d %-9s %-10s %-6s %8.2f %8.2f %8.2f %8.2f\n", benchCase.numThreads, benchCase.name.c_str(),
+			benchCase.cpuInference.c_str(), benchCase.cpuLoad.c_str(), benchCase.timeAvg, benchCase.timeStddev, benchCase.timeP95, benchCase.timeMax);
+		if (!bestCase || benchCase.timeP95 < bestCase->timeP95) bestCase = &benchCase;
+	}
+	if (bestCase) {
+		printf("Best: %d threads, %s\n", bestCase->numThreads, bestCase->name.c_str());
+		if (bestCase->cpuInference.empty()) {
+			printf("  ./main -t %d\n", bestCase->numThreads);
+		} else {
+			printf("  ./main -t %d -a %s:%s:%s\n", bestCase->numThreads, bestCase->cpuLoad.c_str(), bestCase->cpuInference.c_str(), bestCase->cpuLoad.c_str());
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,348 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+
+/* for pty */
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+/* for My modules */
+#include "Config.h"
+#include "KeypointLog.h"
+#include "PoseAnalyzer.h"
+#include "GestureRecognizer.h"
+#include "CommandDecider.h"
+#include "Uart.h"
+#include "CommandProtocol.h"
+#include "RobotModel.h"
+
+/*** Macro ***/
+#define BAUDRATE              115200
+#define OSCILLATION_WINDOW    1000	// [msec] A -> B -> A within this time is regarded as oscillation
+#define UPDATE_INTERVAL       5		// [msec]
+
+/*** Global variable ***/
+static const std::chrono::steady_clock::time_point s_t0 = std::chrono::steady_clock::now();
+static std::atomic<bool> s_isRunning(true);
+
+/*** Function ***/
+static double getNowMsec()
+{
+	return static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - s_t0).count() * 1000.0;
+}
+
+static void handleSignal(int32_t)
+{
+	s_isRunning = false;
+}
+
+/* Bittle emulated on the master side of a pty */
+/* - bytes arrive at the rate of 115200 bps, and a command is processed processTime after its newline arrives */
+/* - "k" + skill and "d" (rest) move RobotModel. the token is sent back as OpenCat does */
+class SimulatedRobot {
+public:
+	typedef struct METRICS_ {
+		int32_t numLine;
+		int32_t numUnknown;
+		int32_t numMotion;		// changed to a moving skill
+		double  sumMotionLatency;	// [msec] from the first byte of the command to the start of motion
+		double  maxMotionLatency;
+		int32_t numStill;		// changed to a still skill (stop, sit, ...)
+		double  sumStillLatency;	// [msec] from the first byte of the command to stop
+		double  maxStillLatency;
+		int32_t numOscillation;
+		double  timeOscillation;	// [msec] time spent in a skill which is reverted within OSCILLATION_WINDOW
+		RobotModel::METRICS robot;
+		METRICS_()
+			: numLine(0), numUnknown(0)
+			, numMotion(0), sumMotionLatency(0), maxMotionLatency(0)
+			, numStill(0), sumStillLatency(0), maxStillLatency(0)
+			, numOscillation(0), timeOscillation(0)
+		{}
+	} METRICS;
+
+public:
+	SimulatedRobot(int32_t fd, double transitionTime, double gaitChangeTime, double processTime)
+		: m_fd(fd), m_processTime(processTime), m_robot(transitionTime, gaitChangeTime), m_isRunning(true), m_lineStartTime(-1), m_byteTime(0)
+	{
+		m_robot.reset(getNowMsec());
+		m_thread = std::thread(&SimulatedRobot::run, this);
+	}
+	~SimulatedRobot() {
+		m_isRunning = false;
+		m_thread.join();
+	}
+	METRICS getMetrics() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		METRICS metrics = m_metrics;
+		metrics.robot = m_robot.getMetrics();
+		return metrics;
+	}
+
+private:
+	typedef struct {
+		double receiveTime;	// [msec] the first byte arrived
+		double applyTime;	// [msec] processed by the robot
+		std::string line;
+	} LINE;
+
+	void run() {
+		while (m_isRunning) {
+			struct pollfd pfd = { m_fd, POLLIN, 0 };
+			if (poll(&pfd, 1, UPDATE_INTERVAL) > 0 && (pfd.revents & POLLIN)) {
+				char data[256];
+				ssize_t size = read(m_fd, data, sizeof(data));
+				for (ssize_t i = 0; i < size; i++) receive(data[i]);
+			}
+			const double now = getNowMsec();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while (!m_lineList.empty() && m_lineList.front().applyTime <= now) {
+				apply(m_lineList.front());
+				m_lineList.pop_front();
+			}
+			m_robot.update(now);
+		}
+	}
+
+	void receive(char c) {
+		/* transfer time of uart */
+		const double now = getNowMsec();
+		m_byteTime = (std::max)(m_byteTime, now) + 10.0 * 1000.0 / BAUDRATE;
+		if (m_lineStartTime < 0) m_lineStartTime = m_byteTime;
+		if (c != '\n') {
+			if (c != '\r') m_buffer.push_back(c);
+			return;
+		}
+		LINE line = { m_lineStartTime, m_byteTime + m_processTime, m_buffer };
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_lineList.push_back(line);
+		m_buffer.clear();
+		m_lineStartTime = -1;
+	}
+
+	void apply(const LINE& line) {
+		if (line.line.empty()) return;
+		m_metrics.numLine++;
+		std::string skill;
+		if (line.line[0] == 'k') {
+			skill = line.line;
+		} else if (line.line[0] == 'd') {
+			skill = "krest";
+		}
+		const std::string previousSkill = m_robot.getSkill();
+		if (skill.empty() || !m_robot.setCommand(skill, line.applyTime)) {
+			m_metrics.numUnknown++;
+		} else if (m_robot.getSkill() != previousSkill) {
+			double v, w;
+			(void)RobotModel::getSkillVelocity(skill, v, w);
+			if (v != 0 || w != 0) {
+				const double latency = m_robot.getTransitionEndTime() - line.receiveTime;
+				m_metrics.numMotion++;
+				m_metrics.sumMotionLatency += latency;
+				m_metrics.maxMotionLatency = (std::max)(m_metrics.maxMotionLatency, latency);
+			} else {
+				const double latency = line.applyTime - line.receiveTime;
+				m_metrics.numStill++;
+				m_metrics.sumStillLatency += latency;
+				m_metrics.maxStillLatency = (std::max)(m_metrics.maxStillLatency, latency);
+			}
+
+			/* A -> B -> A */
+			if (m_skillHistory.size() >= 2 && m_skillHistory[m_skillHistory.size() - 2].second == skill
+				&& line.applyTime - m_skillHistory.back().first < OSCILLATION_WINDOW) {
+				m_metrics.numOscillation++;
+				m_metrics.timeOscillation += line.applyTime - m_skillHistory.back().first;
+			}
+			m_skillHistory.push_back(std::pair<double, std::string>(line.applyTime, skill));
+			if (m_skillHistory.size() > 2) m_skillHistory.pop_front();
+		}
+
+		const std::string response = line.line.substr(0, 1) + "\r\n";
+		if (write(m_fd, response.data(), response.size()) < 0) {
+			printf("[ERR] write\n");
+		}
+	}
+
+private:
+	int32_t m_fd;
+	double  m_processTime;	// [msec]
+	RobotModel m_robot;
+	METRICS m_metrics;
+	std::atomic<bool> m_isRunning;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::string m_buffer;
+	double  m_lineStartTime;	// [msec]
+	double  m_byteTime;			// [msec] the last byte arrives at this time
+	std::deque<LINE> m_lineList;
+	std::deque<std::pair<double, std::string>> m_skillHistory;
+};
+
+static void printReport(SimulatedRobot::METRICS metrics, double duration)
+{
+	printf("=== Bittle Simulator (%.1f [sec]) ===\n", duration / 1000.0);
+	printf("commands = %d (unknown = %d), skill changes = %d\n", metrics.numLine, metrics.numUnknown, metrics.robot.numSkillChange);
+	printf("command to motion = %.1f (max %.1f) [msec], %d times\n", (metrics.numMotion > 0) ? metrics.sumMotionLatency / metrics.numMotion : 0.0, metrics.maxMotionLatency, metrics.numMotion);
+	printf("command to stop   = %.1f (max %.1f) [msec], %d times\n", (metrics.numStill > 0) ? metrics.sumStillLatency / metrics.numStill : 0.0, metrics.maxStillLatency, metrics.numStill);
+	printf("oscillation = %d times, %.1f [msec] (%.1f %%)\n", metrics.numOscillation, metrics.timeOscillation, metrics.timeOscillation / duration * 100.0);
+	printf("transition = %.1f [msec] (%.1f %%), distance = %.2f [m]\n", metrics.robot.timeTransition, metrics.robot.timeTransition / duration * 100.0, metrics.robot.distance);
+}
+
+/* Run the decision pipeline with recorded keypoints at the recorded timing, and send commands to the simulated robot */
+static int32_t runKeypointLog(const std::string& filename, const char* device)
+{
+	KeypointLog keypointLog;
+	if (keypointLog.open(filename, KeypointLog::MODE_READ) != KeypointLog::RET_OK) {
+		return -1;
+	}
+	Uart uart;
+	if (uart.initialize(device) < 0) {
+		return -1;
+	}
+	PoseAnalyzer poseAnalyzer;
+	GestureRecognizer gestureRecognizer;
+	CommandDecider commandDecider;
+	CommandProtocol protocol;
+	CommandProtocol::PARAM param;
+	param.watchdogTimeout = Config::get().watchdogTimeout;
+	protocol.initialize(param);
+
+	double timestamp;
+	double firstTimestamp = -1;
+	std::vector<std::pair<float, float>> jointList;
+	std::vector<float> scoreList;
+	std::vector<CommandProtocol::RESPONSE> responseList;
+	const double timeStart = getNowMsec();
+	while (s_isRunning && keypointLog.read(timestamp, jointList, scoreList) == KeypointLog::RET_OK) {
+		if (firstTimestamp < 0) firstTimestamp = timestamp;
+		const double frameTime = timeStart + timestamp - firstTimestamp;
+
+		/* Send and receive until the frame time */
+		do {
+			std::string frame;
+			while (protocol.getFrame(getNowMsec(), frame)) uart.send(frame.c_str());
+			char buffer[256];
+			const int32_t timeout = static_cast<int32_t>((std::max)(0.0, (std::min)(frameTime - getNowMsec(), protocol.getWaitTime(getNowMsec()))));
+			int32_t size = uart.recv(buffer, sizeof(buffer), timeout);
+			if (size > 0) protocol.parse(buffer, size, getNowMsec(), responseList);
+		} while (getNowMsec() < frameTime);
+
+		PoseAnalyzer::RESULT poseResult;
+		(void)poseAnalyzer.analyze(jointList, scoreList, timestamp, poseResult);
+		GestureRecognizer::RESULT gestureResult;
+		(void)gestureRecognizer.update(jointList, scoreList, gestureResult);
+		std::string command = commandDecider.decide(poseResult, gestureResult);
+		if (poseResult.faceScore > Config::get().faceScoreThreshold) protocol.feedWatchdog(getNowMsec());
+		if (!command.empty()) protocol.request(command, getNowMsec(), commandDecider.getPriority() == CommandDecider::PRIORITY_SAFETY);
+	}
+
+	/* Wait for the last command */
+	const double timeEnd = getNowMsec() + 1000;
+	while (getNowMsec() < timeEnd) {
+		std::string frame;
+		while (protocol.getFrame(getNowMsec(), frame)) uart.send(frame.c_str());
+		char buffer[256];
+		int32_t size = uart.recv(buffer, sizeof(buffer), 10);
+		if (size > 0) protocol.parse(buffer, size, getNowMsec(), responseList);
+	}
+	uart.finalize();
+	commandDecider.printStopStatistics();
+	protocol.printStatistics();
+	return 0;
+}
+
+/* Emulate Bittle on a pty for closed-loop tests without hardware */
+int32_t main(int32_t argc, char* argv[])
+{
+	std::string keypointLogFile;
+	std::string linkName;
+	double duration = 0;
+	double transitionTime = 300;
+	double gaitChangeTime = 100;
+	double processTime = 5;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			keypointLogFile = argv[++i];
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			linkName = argv[++i];
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			duration = atof(argv[++i]) * 1000.0;
+		} else if (strcmp(argv[i], "-t") == 0 && i + 2 < argc) {
+			transitionTime = atof(argv[++i]);
+			gaitChangeTime = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			processTime = atof(argv[++i]);
+		} else {
+			printf("usage: %s [-k keypoint_log_file] [-l link] [-d duration_sec] [-t transition_time gait_change_time] [-p process_time]\n", argv[0]);
+			printf("  -k : run the decision pipeline with the recorded keypoints and send commands to the simulator\n");
+			printf("  -l : create a symbolic link to the pty (e.g. /tmp/bittle. then ./main -u /tmp/bittle)\n");
+			printf("  -d : stop after this time (default: until Ctrl-C)\n");
+			printf("  -t : time [msec] to change the skill, and to change the direction in the same gait (default: 300 100)\n");
+			printf("  -p : time [msec] to process a command (default: 5)\n");
+			return -1;
+		}
+	}
+
+	int32_t masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+		printf("[ERR] Failed to open pty\n");
+		return -1;
+	}
+	const std::string slaveName = ptsname(masterFd);
+	if (!linkName.empty()) {
+		(void)unlink(linkName.c_str());
+		if (symlink(slaveName.c_str(), linkName.c_str()) != 0) {
+			printf("[ERR] Failed to create link: %s\n", linkName.c_str());
+		}
+	}
+	printf("Simulator: %s%s%s\n", slaveName.c_str(), linkName.empty() ? "" : " -> ", linkName.c_str());
+
+	signal(SIGINT, handleSignal);
+	int32_t ret = 0;
+	SimulatedRobot::METRICS metrics;
+	const double timeStart = getNowMsec();
+	{
+		SimulatedRobot robot(masterFd, transitionTime, gaitChangeTime, processTime);
+		if (!keypointLogFile.empty()) {
+			ret = runKeypointLog(keypointLogFile, slaveName.c_str());
+		} else {
+			while (s_isRunning && (duration <= 0 || getNowMsec() - timeStart < duration)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		metrics = robot.getMetrics();
+	}
+	printReport(metrics, getNowMsec() - timeStart);
+
+	if (!linkName.empty()) (void)unlink(linkName.c_str());
+	close(masterFd);
+	return ret;
+}
@@ -0,0 +1,76 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "PoseEngine.h"
+#include "PoseAnalyzer.h"
+
+/*** Macro ***/
+#define WORK_DIR     RESOURCE_DIR
+
+/*** Function ***/
+/* Take a picture of a person standing at the known distance with the camera used for the robot */
+int32_t main(int32_t argc, char* argv[])
+{
+	if (argc < 3) {
+		printf("usage: %s image_file distance[m] [output_file]\n", argv[0]);
+		return -1;
+	}
+	const std::string imageFile = argv[1];
+	const float distance = static_cast<float>(atof(argv[2]));
+	const std::string outputFile = (argc > 3) ? argv[3] : std::string(WORK_DIR) + "/calibration.txt";
+
+	cv::Mat image = cv::imread(imageFile);
+	if (image.empty()) {
+		printf("[ERR] Failed to read %s\n", imageFile.c_str());
+		return -1;
+	}
+
+	PoseEngine poseEngine;
+	if (poseEngine.initialize(WORK_DIR, 4) != PoseEngine::RET_OK) {
+		return -1;
+	}
+	PoseEngine::RESULT result;
+	if (poseEngine.invoke(image, result) != PoseEngine::RET_OK) {
+		poseEngine.finalize();
+		return -1;
+	}
+	poseEngine.finalize();
+
+	PoseAnalyzer poseAnalyzer;
+	PoseAnalyzer::RESULT poseResult;
+	(void)poseAnalyzer.analyze(result.poseKeypointCoords[0], result.poseKeypointScores[0], 0, poseResult);
+	if (poseResult.bodySize <= 0) {
+		printf("[ERR] Body is not found\n");
+		return -1;
+	}
+
+	if (poseAnalyzer.saveCalibration(outputFile, poseResult.bodySize, distance) != PoseAnalyzer::RET_OK) {
+		return -1;
+	}
+	printf("bodySize = %.3f at %.2f [m] is saved to %s\n", poseResult.bodySize, distance, outputFile.c_str());
+	return 0;
+}
@@ -0,0 +1,127 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+/* for My modules */
+#include "KeypointDecoder.h"
+
+/*** Macro ***/
+#define NUM_ITERATION 100000
+
+/*** Function ***/
+/* The previous implementation in PoseEngine::invoke */
+static void decodeLegacy(const float* data, int32_t personNum, int32_t stride, std::vector<std::vector<std::pair<float, float>>>& coordsList, std::vector<std::vector<float>>& scoresList)
+{
+	for (int32_t person = 0; person < personNum; person++) {
+		const float* valFloat = data + person * stride;
+		std::vector<float> poseKeypointScores;
+		std::vector<std::pair<float, float>> poseKeypointCoords;
+		for (int32_t jointIndex = 0; jointIndex < KeypointDecoder::NUM_JOINTS; jointIndex++) {
+			poseKeypointCoords.push_back(std::pair<float, float>(valFloat[1], valFloat[0]));
+			poseKeypointScores.push_back(valFloat[2]);
+			valFloat += 3;
+		}
+		scoresList.push_back(poseKeypointScores);
+		coordsList.push_back(poseKeypointCoords);
+	}
+}
+
+static double getElapsedNsec(const std::chrono::steady_clock::time_point& t0, const std::chrono::steady_clock::time_point& t1)
+{
+	return static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000000000.0;
+}
+
+static int32_t runLayout(const char* name, int32_t layout, int32_t personNum, int32_t stride)
+{
+	std::mt19937 engine(1234);
+	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	std::vector<float> data(personNum * stride);
+	for (auto& value : data) value = dist(engine);
+	const KeypointDecoder::ROI roi(0.1f, 0.2f, 0.5f, 0.6f);
+	const float thresholdScore = 0.3f;
+
+	KeypointDecoder decoderScalar;
+	KeypointDecoder decoderSimd;
+	if (decoderScalar.initialize(layout, personNum) != KeypointDecoder::RET_OK || decoderSimd.initialize(layout, personNum) != KeypointDecoder::RET_OK) {
+		return -1;
+	}
+
+	/*** Check the result ***/
+	(void)decoderScalar.decodeScalar(data.data(), personNum, roi, thresholdScore);
+	(void)decoderSimd.decode(data.data(), personNum, roi, thresholdScore);
+	float maxDiff = 0;
+	bool isMaskSame = true;
+	for (int32_t person = 0; person < personNum; person++) {
+		for (int32_t joint = 0; joint < KeypointDecoder::NUM_JOINTS; joint++) {
+			maxDiff = (std::max)(maxDiff, std::abs(decoderScalar.getX(person)[joint] - decoderSimd.getX(person)[joint]));
+			maxDiff = (std::max)(maxDiff, std::abs(decoderScalar.getY(person)[joint] - decoderSimd.getY(person)[joint]));
+			maxDiff = (std::max)(maxDiff, std::abs(decoderScalar.getScore(person)[joint] - decoderSimd.getScore(person)[joint]));
+		}
+		isMaskSame &= decoderScalar.getValidMask(person) == decoderSimd.getValidMask(person);
+	}
+
+	/*** Measure ***/
+	double sum = 0;	// to avoid optimization
+	auto t0 = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < NUM_ITERATION; i++) {
+		std::vector<std::vector<std::pair<float, float>>> coordsList;
+		std::vector<std::vector<float>> scoresList;
+		decodeLegacy(data.data(), personNum, stride, coordsList, scoresList);
+		sum += scoresList[0][0];
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	const double timeLegacy = getElapsedNsec(t0, t1) / NUM_ITERATION;
+
+	t0 = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < NUM_ITERATION; i++) {
+		(void)decoderScalar.decodeScalar(data.data(), personNum, roi, thresholdScore);
+		sum += decoderScalar.getScore(0)[0];
+	}
+	t1 = std::chrono::steady_clock::now();
+	const double timeScalar = getElapsedNsec(t0, t1) / NUM_ITERATION;
+
+	t0 = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < NUM_ITERATION; i++) {
+		(void)decoderSimd.decode(data.data(), personNum, roi, thresholdScore);
+		sum += decoderSimd.getScore(0)[0];
+	}
+	t1 = std::chrono::steady_clock::now();
+	const double timeSimd = getElapsedNsec(t0, t1) / NUM_ITERATION;
+
+	printf("%-12s: legacy = %7.1f, scalar = %7.1f, simd = %7.1f [nsec], max diff = %g, mask %s (%.0f)\n",
+		name, timeLegacy, timeScalar, timeSimd, maxDiff, isMaskSame ? "ok" : "NG", sum > 0 ? 0.0 : 1.0);
+	return (maxDiff < 1e-5f && isMaskSame) ? 0 : -1;
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	(void)argc;
+	(void)argv;
+	int32_t ret = 0;
+	ret |= runLayout("singlepose", KeypointDecoder::LAYOUT_SINGLEPOSE, 1, KeypointDecoder::SINGLEPOSE_STRIDE);	// 1x1x17x3
+	ret |= runLayout("multipose", KeypointDecoder::LAYOUT_MULTIPOSE, 6, KeypointDecoder::MULTIPOSE_STRIDE);	// 1x6x56
+	return ret;
+}
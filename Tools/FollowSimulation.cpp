@@ -0,0 +1,108 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+/* for My modules */
+#include "PoseAnalyzer.h"
+#include "CommandDecider.h"
+#include "RobotModel.h"
+
+/*** Macro ***/
+static constexpr double PI = 3.14159265358979;
+static constexpr double FPS = 15.0;
+static constexpr double DURATION = 120.0;				// [sec]
+static constexpr double HFOV = 62.2 * PI / 180.0;		// Raspberry Pi Camera v2
+static constexpr double VFOV = 48.8 * PI / 180.0;
+static constexpr double BODY_PART_LENGTH = 0.45;		// [m] average length of body parts used for PoseAnalyzer::RESULT::bodySize
+
+/*** Function ***/
+/* A person walks slowly in S-curve in front of the robot, and the robot follows the person */
+static void runSimulation(int32_t mode)
+{
+	CommandDecider commandDecider;
+	commandDecider.setMode(mode);
+	RobotModel robot;
+	std::mt19937 rand(0);
+	std::normal_distribution<float> noise(0.0f, 1.0f);
+
+	std::string lastCommand;
+	int32_t numFrame = 0;
+	int32_t numVisible = 0;
+	double sumErrorX = 0;
+	double sumErrorDistance = 0;
+	const float targetDistance = 2.0f;
+	commandDecider.setTargetDistance(targetDistance, targetDistance * 0.2f);
+
+	for (double t = 0; t < DURATION; t += 1.0 / FPS) {
+		const double timestamp = t * 1000.0;
+		robot.update(timestamp);
+
+		/* position of the person */
+		const double personX = 2.0 + 0.03 * t;
+		const double personY = 0.5 * std::sin(0.1 * t);
+
+		/* project the person to the camera */
+		const auto& state = robot.getState();
+		double bearing = std::atan2(personY - state.y, personX - state.x) - state.theta;
+		bearing = std::atan2(std::sin(bearing), std::cos(bearing));
+		const double distance = std::sqrt(std::pow(personX - state.x, 2) + std::pow(personY - state.y, 2));
+
+		PoseAnalyzer::RESULT poseResult;
+		poseResult.timestamp = timestamp;
+		const float x = static_cast<float>(-bearing / (HFOV / 2));	// image right is positive
+		if (std::abs(x) < 1.0f) {
+			poseResult.faceScore = 0.8f;
+			poseResult.isAttending = true;
+			poseResult.x = x + 0.05f * noise(rand);
+			poseResult.bodySize = static_cast<float>(BODY_PART_LENGTH / (distance * 2 * std::tan(VFOV / 2))) * (1.0f + 0.05f * noise(rand));
+			poseResult.distance = static_cast<float>(BODY_PART_LENGTH / (2 * std::tan(VFOV / 2))) / poseResult.bodySize;	// assume calibrated
+			numVisible++;
+			sumErrorX += std::abs(x);
+			sumErrorDistance += std::abs(distance - targetDistance);
+		}
+		numFrame++;
+
+		std::string command = commandDecider.decide(poseResult);
+		if (!command.empty() && command != lastCommand) {
+			(void)robot.setCommand(command, timestamp);
+			lastCommand = command;
+		}
+	}
+
+	const auto& metrics = robot.getMetrics();
+	const char* modeName[] = { "discrete", "continuous", "distance" };
+	printf("%-10s: commands/min = %6.1f, transition = %5.1f [%%], visible = %5.1f [%%], |x| = %.3f, |distance error| = %.2f [m]\n",
+		modeName[mode],
+		metrics.numSkillChange / (DURATION / 60.0), 100.0 * metrics.timeTransition / (DURATION * 1000.0), 100.0 * numVisible / numFrame,
+		(numVisible > 0) ? sumErrorX / numVisible : 0, (numVisible > 0) ? sumErrorDistance / numVisible : 0);
+}
+
+int32_t main()
+{
+	runSimulation(CommandDecider::MODE_DISCRETE);
+	runSimulation(CommandDecider::MODE_CONTINUOUS);
+	runSimulation(CommandDecider::MODE_FOLLOW_DISTANCE);
+	return 0;
+}
@@ -0,0 +1,499 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "Config.h"
+#include "PoseAnalyzer.h"
+#include "GestureRecognizer.h"
+#include "CommandDecider.h"
+#include "KeypointDecoder.h"
+#include "KeypointLog.h"
+#include "OperatorLock.h"
+#include "Tracer.h"
+
+/*** Macro ***/
+#define NUM_SYNTHETIC_FRAME  256
+#define DEFAULT_MIN_TIME     0.1	// [sec] for each repetition
+#define DEFAULT_REPETITION   5
+#define DEFAULT_THRESHOLD    5.0	// [%] for compare
+
+/* in ImageProcessor.cpp */
+void drawPose(cv::Mat& mat, const std::vector<std::pair<float, float>> jointList, std::vector<float> scoreList);
+
+/*** Global variable ***/
+typedef struct {
+	std::vector<std::pair<float, float>> jointList;
+	std::vector<float> scoreList;
+	double timestamp;
+} KEYPOINT_FRAME;
+
+typedef struct {
+	std::string name;
+	std::function<void(int64_t)> func;	// run the target numIteration times
+} BENCHMARK;
+
+typedef struct {
+	std::string name;
+	int64_t numIteration;
+	double  time;		// [nsec / iteration] median of repetitions
+	double  timeMin;
+	double  timeStddev;
+	double  timeCpu;	// [nsec / iteration] of all repetitions
+} BENCHMARK_RESULT;
+
+/*** Function ***/
+/* keep the value from being optimized out */
+template <typename T>
+static void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile char sink;
+	sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+}
+
+static double getElapsedNsec(const std::chrono::steady_clock::time_point& t0, const std::chrono::steady_clock::time_point& t1)
+{
+	return static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000000000.0;
+}
+
+/* a standing person with arms moving, plus noise and occasional low score joints */
+static std::vector<KEYPOINT_FRAME> createSyntheticFrames()
+{
+	static const std::array<std::pair<float, float>, KeypointDecoder::NUM_JOINTS> basePose = { {
+		{0.50f, 0.20f}, {0.52f, 0.18f}, {0.48f, 0.18f}, {0.54f, 0.19f}, {0.46f, 0.19f},	/* face */
+		{0.58f, 0.30f}, {0.42f, 0.30f}, {0.60f, 0.42f}, {0.40f, 0.42f}, {0.61f, 0.53f}, {0.39f, 0.53f},	/* arm */
+		{0.56f, 0.55f}, {0.44f, 0.55f}, {0.56f, 0.72f}, {0.44f, 0.72f}, {0.56f, 0.88f}, {0.44f, 0.88f},	/* leg */
+	} };
+	std::mt19937 engine(1234);
+	std::normal_distribution<float> noise(0.0f, 0.005f);
+	std::uniform_real_distribution<float> score(0.0f, 1.0f);
+
+	std::vector<KEYPOINT_FRAME> frameList(NUM_SYNTHETIC_FRAME);
+	for (int32_t i = 0; i < NUM_SYNTHETIC_FRAME; i++) {
+		KEYPOINT_FRAME& frame = frameList[i];
+		frame.timestamp = i * 33.3;
+		/* raise arms in the first quarter, spread them in the second quarter of each 64 frames */
+		const int32_t phase = (i % 64) / 16;
+		for (int32_t joint = 0; joint < KeypointDecoder::NUM_JOINTS; joint++) {
+			std::pair<float, float> point = basePose[joint];
+			if (phase == 0 && (joint == 9 || joint == 10)) point.second = 0.10f;
+			if (phase == 1 && (joint == 9 || joint == 10)) point = std::make_pair(point.first + ((joint == 9) ? 0.15f : -0.15f), 0.30f);
+			frame.jointList.push_back(std::make_pair(point.first + noise(engine), point.second + noise(engine)));
+			frame.scoreList.push_back((score(engine) < 0.1f) ? 0.1f : 0.3f + 0.6f * score(engine));
+		}
+	}
+	return frameList;
+}
+
+static std::vector<KEYPOINT_FRAME> loadRecordedFrames(const std::string& filename)
+{
+	std::vector<KEYPOINT_FRAME> frameList;
+	KeypointLog keypointLog;
+	if (keypointLog.open(filename, KeypointLog::MODE_READ) != KeypointLog::RET_OK) {
+		return frameList;
+	}
+	KEYPOINT_FRAME frame;
+	while (keypointLog.read(frame.timestamp, frame.jointList, frame.scoreList) == KeypointLog::RET_OK) {
+		frameList.push_back(frame);
+	}
+	return frameList;
+}
+
+/* Register benchmarks for a keypoint input. suffix is "synthetic" or "recorded" */
+static void addKeypointBenchmarks(std::vector<BENCHMARK>& benchmarkList, const std::string& suffix, const std::vector<KEYPOINT_FRAME>& frameList)
+{
+	if (frameList.empty()) return;
+	const size_t numFrame = frameList.size();
+
+	/* inputs of the later stages are made by running the previous stage once */
+	std::vector<PoseAnalyzer::RESULT> currentResultList;
+	std::vector<PoseAnalyzer::RESULT> poseResultList;
+	std::vector<GestureRecognizer::RESULT> gestureResultList;
+	{
+		PoseAnalyzer poseAnalyzer;
+		GestureRecognizer gestureRecognizer;
+		for (const auto& frame : frameList) {
+			PoseAnalyzer::RESULT poseResult;
+			(void)poseAnalyzer.analyze(frame.jointList, frame.scoreList, frame.timestamp, poseResult);
+			poseResultList.push_back(poseResult);
+			GestureRecognizer::RESULT gestureResult;
+			(void)gestureRecognizer.update(frame.jointList, frame.scoreList, gestureResult);
+			gestureResultList.push_back(gestureResult);
+		}
+		/* note: analyze returns the filtered result. use it as the raw input of filterResult, which is close enough for cost */
+		currentResultList = poseResultList;
+	}
+
+	benchmarkList.push_back({ "PoseAnalyzer::analyze/" + suffix, [frameList, numFrame](int64_t numIteration) {
+		PoseAnalyzer poseAnalyzer;
+		for (int64_t i = 0; i < numIteration; i++) {
+			const auto& frame = frameList[i % numFrame];
+			PoseAnalyzer::RESULT result;
+			(void)poseAnalyzer.analyze(frame.jointList, frame.scoreList, frame.timestamp, result);
+			doNotOptimize(result);
+		}
+	} });
+
+	benchmarkList.push_back({ "PoseAnalyzer::filterResult/" + suffix, [currentResultList, numFrame](int64_t numIteration) {
+		PoseAnalyzer poseAnalyzer;
+		for (int64_t i = 0; i < numIteration; i++) {
+			PoseAnalyzer::RESULT result = currentResultList[i % numFrame];
+			poseAnalyzer.filterResult(currentResultList[i % numFrame], result);
+			doNotOptimize(result);
+		}
+	} });
+
+	benchmarkList.push_back({ "GestureRecognizer::update/" + suffix, [frameList, numFrame](int64_t numIteration) {
+		GestureRecognizer gestureRecognizer;
+		for (int64_t i = 0; i < numIteration; i++) {
+			const auto& frame = frameList[i % numFrame];
+			GestureRecognizer::RESULT result;
+			(void)gestureRecognizer.update(frame.jointList, frame.scoreList, result);
+			doNotOptimize(result);
+		}
+	} });
+
+	benchmarkList.push_back({ "CommandDecider::decide/" + suffix, [poseResultList, gestureResultList, numFrame](int64_t numIteration) {
+		CommandDecider commandDecider;
+		for (int64_t i = 0; i < numIteration; i++) {
+			PoseAnalyzer::RESULT poseResult = poseResultList[i % numFrame];
+			std::string command = commandDecider.decide(poseResult, gestureResultList[i % numFrame]);
+			doNotOptimize(command);
+		}
+	} });
+
+	benchmarkList.push_back({ "drawPose/" + suffix, [frameList, numFrame](int64_t numIteration) {
+		cv::Mat mat(480, 640, CV_8UC3, cv::Scalar(128, 128, 128));
+		for (int64_t i = 0; i < numIteration; i++) {
+			const auto& frame = frameList[i % numFrame];
+			drawPose(mat, frame.jointList, frame.scoreList);
+			doNotOptimize(mat.data);
+		}
+	} });
+}
+
+/* Register benchmarks of the output tensor decode in PoseEngine::invoke */
+static void addDecodeBenchmarks(std::vector<BENCHMARK>& benchmarkList)
+{
+	typedef struct {
+		const char* name;
+		int32_t layout;
+		int32_t personNum;
+		int32_t stride;
+	} LAYOUT;
+	const std::vector<LAYOUT> layoutList = {
+		{ "singlepose", KeypointDecoder::LAYOUT_SINGLEPOSE, 1, KeypointDecoder::SINGLEPOSE_STRIDE },
+		{ "multipose", KeypointDecoder::LAYOUT_MULTIPOSE, 6, KeypointDecoder::MULTIPOSE_STRIDE },
+	};
+	for (const auto& layout : layoutList) {
+		std::mt19937 engine(1234);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		std::vector<float> data(layout.personNum * layout.stride);
+		for (auto& value : data) value = dist(engine);
+		benchmarkList.push_back({ std::string("KeypointDecoder::decode/") + layout.name, [layout, data](int64_t numIteration) {
+			KeypointDecoder decoder;
+			(void)decoder.initialize(layout.layout, layout.personNum);
+			const KeypointDecoder::ROI roi(0.1f, 0.2f, 0.5f, 0.6f);
+			for (int64_t i = 0; i < numIteration; i++) {
+				int32_t ret = decoder.decode(data.data(), layout.personNum, roi, 0.3f);
+				doNotOptimize(ret);
+				doNotOptimize(decoder.getPersonNum());
+			}
+		} });
+	}
+}
+
+/* Register benchmarks of the appearance signature in OperatorLock (torso of a near and a far person) */
+static void addSignatureBenchmarks(std::vector<BENCHMARK>& benchmarkList)
+{
+	std::mt19937 engine(1234);
+	cv::Mat mat(480, 640, CV_8UC3);
+	for (int32_t y = 0; y < mat.rows; y++) {
+		uint8_t* p = mat.ptr<uint8_t>(y);
+		for (int32_t x = 0; x < mat.cols * 3; x++) p[x] = static_cast<uint8_t>(engine());
+	}
+	const std::vector<std::pair<std::string, cv::Rect>> regionList = {
+		{ "near", cv::Rect(220, 100, 200, 300) },
+		{ "far", cv::Rect(300, 200, 40, 60) },
+	};
+	for (const auto& region : regionList) {
+		benchmarkList.push_back({ "OperatorLock::computeSignature/" + region.first, [mat, region](int64_t numIteration) {
+			OperatorLock::SIGNATURE signature;
+			for (int64_t i = 0; i < numIteration; i++) {
+				(void)OperatorLock::computeSignature(mat, region.second, signature);
+				doNotOptimize(signature.histogram[0]);
+			}
+		} });
+	}
+}
+
+/* Register the benchmark of a span of Tracer (only with ENABLE_TRACE) */
+static void addTracerBenchmarks(std::vector<BENCHMARK>& benchmarkList)
+{
+#ifdef ENABLE_TRACE
+	benchmarkList.push_back({ "Tracer::Span", [](int64_t numIteration) {
+		for (int64_t i = 0; i < numIteration; i++) {
+			TRACE_SPAN("benchmark");
+			doNotOptimize(i);
+		}
+	} });
+#else
+	(void)benchmarkList;
+#endif
+}
+
+/* Grow the number of iterations until a run takes minTime, then repeat the run */
+static BENCHMARK_RESULT runBenchmark(const BENCHMARK& benchmark, double minTime, int32_t numRepetition)
+{
+	BENCHMARK_RESULT result;
+	result.name = benchmark.name;
+
+	int64_t numIteration = 1;
+	while (true) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		benchmark.func(numIteration);
+		const double time = getElapsedNsec(t0, std::chrono::steady_clock::now());
+		if (time >= minTime * 1000000000.0 || numIteration >= (static_cast<int64_t>(1) << 40)) break;
+		/* aim at 1.4 x minTime as Google Benchmark does, but don't grow more than 10 times at once */
+		const double scale = (time > 0) ? (minTime * 1000000000.0 * 1.4 / time) : 10.0;
+		numIteration = static_cast<int64_t>(numIteration * (std::min)((std::max)(scale, 2.0), 10.0));
+	}
+	result.numIteration = numIteration;
+
+	std::vector<double> timeList;
+	const std::clock_t tCpu0 = std::clock();
+	for (int32_t repetition = 0; repetition < numRepetition; repetition++) {
+		const auto& t0 = std::chrono::steady_clock::now();
+		benchmark.func(numIteration);
+		timeList.push_back(getElapsedNsec(t0, std::chrono::steady_clock::now()) / numIteration);
+	}
+	result.timeCpu = static_cast<double>(std::clock() - tCpu0) / CLOCKS_PER_SEC * 1000000000.0 / (static_cast<double>(numIteration) * numRepetition);
+
+	std::sort(timeList.begin(), timeList.end());
+	result.time = timeList[timeList.size() / 2];
+	result.timeMin = timeList.front();
+	double sum = 0;
+	double sum2 = 0;
+	for (const auto& t : timeList) {
+		sum += t;
+		sum2 += t * t;
+	}
+	const double mean = sum / timeList.size();
+	result.timeStddev = std::sqrt((std::max)(sum2 / timeList.size() - mean * mean, 0.0));
+	return result;
+}
+
+/* in the format of Google Benchmark (--benchmark_format=json), so that its tools can read it too */
+static int32_t writeJson(const std::string& filename, const std::vector<BENCHMARK_RESULT>& resultList, const std::string& input)
+{
+	FILE* fp = fopen(filename.c_str(), "w");
+	if (!fp) {
+		printf("[ERR] Failed to open %s\n", filename.c_str());
+		return -1;
+	}
+	char date[64];
+	const std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"context\": {\n");
+	fprintf(fp, "    \"date\": \"%s\",\n", date);
+	fprintf(fp, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+	fprintf(fp, "    \"library_build_type\": \"release\",\n");
+#else
+	fprintf(fp, "    \"library_build_type\": \"debug\",\n");
+#endif
+	fprintf(fp, "    \"keypoint_log\": \"%s\"\n", input.c_str());
+	fprintf(fp, "  },\n");
+	fprintf(fp, "  \"benchmarks\": [\n");
+	for (size_t i = 0; i < resultList.size(); i++) {
+		const auto& result = resultList[i];
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", result.name.c_str());
+		fprintf(fp, "      \"iterations\": %lld,\n", static_cast<long long>(result.numIteration));
+		fprintf(fp, "      \"real_time\": %.3f,\n", result.time);
+		fprintf(fp, "      \"cpu_time\": %.3f,\n", result.timeCpu);
+		fprintf(fp, "      \"real_time_min\": %.3f,\n", result.timeMin);
+		fprintf(fp, "      \"real_time_stddev\": %.3f,\n", result.timeStddev);
+		fprintf(fp, "      \"time_unit\": \"ns\"\n");
+		fprintf(fp, "    }%s\n", (i + 1 < resultList.size()) ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+	fclose(fp);
+	return 0;
+}
+
+static int32_t readJson(const std::string& filename, std::vector<BENCHMARK_RESULT>& resultList)
+{
+	cv::FileStorage fs(filename, cv::FileStorage::READ);
+	if (!fs.isOpened()) {
+		printf("[ERR] Failed to open %s\n", filename.c_str());
+		return -1;
+	}
+	for (const auto& node : fs["benchmarks"]) {
+		BENCHMARK_RESULT result;
+		result.name = static_cast<std::string>(node["name"]);
+		result.numIteration = static_cast<int64_t>(static_cast<double>(node["iterations"]));
+		result.time = static_cast<double>(node["real_time"]);
+		result.timeCpu = static_cast<double>(node["cpu_time"]);
+		result.timeMin = node["real_time_min"].empty() ? result.time : static_cast<double>(node["real_time_min"]);
+		result.timeStddev = node["real_time_stddev"].empty() ? 0 : static_cast<double>(node["real_time_stddev"]);
+		resultList.push_back(result);
+	}
+	return 0;
+}
+
+/* Compare median time of each benchmark. returns the number of regressions */
+static int32_t compare(const std::string& baseFilename, const std::string& newFilename, double threshold)
+{
+	std::vector<BENCHMARK_RESULT> baseList;
+	std::vector<BENCHMARK_RESULT> newList;
+	if (readJson(baseFilename, baseList) != 0 || readJson(newFilename, newList) != 0) {
+		return -1;
+	}
+
+	int32_t numRegression = 0;
+	printf("%-40s %12s %12s %9s\n", "name", "base [ns]", "new [ns]", "diff");
+	for (const auto& resultNew : newList) {
+		const auto& it = std::find_if(baseList.begin(), baseList.end(), [&resultNew](const BENCHMARK_RESULT& r) { return r.name == resultNew.name; });
+		if (it == baseList.end()) {
+			printf("%-40s %12s %12.1f %9s\n", resultNew.name.c_str(), "-", resultNew.time, "new");
+			continue;
+		}
+		const double diff = (it->time > 0) ? (resultNew.time - it->time) / it->time * 100.0 : 0;
+		/* note: a difference within the noise (stddev of both) is not a regression */
+		const bool isNoise = std::abs(resultNew.time - it->time) <= (resultNew.timeStddev + it->timeStddev);
+		const char* mark = "";
+		if (diff > threshold && !isNoise) {
+			mark = "  REGRESSION";
+			numRegression++;
+		} else if (diff < -threshold && !isNoise) {
+			mark = "  improved";
+		}
+		printf("%-40s %12.1f %12.1f %+8.1f%%%s\n", resultNew.name.c_str(), it->time, resultNew.time, diff, mark);
+	}
+	for (const auto& resultBase : baseList) {
+		if (std::none_of(newList.begin(), newList.end(), [&resultBase](const BENCHMARK_RESULT& r) { return r.name == resultBase.name; })) {
+			printf("%-40s %12.1f %12s %9s\n", resultBase.name.c_str(), resultBase.time, "-", "removed");
+		}
+	}
+	printf("%d regression(s) over %.1f %%\n", numRegression, threshold);
+	return numRegression;
+}
+
+static void printUsage(const char* name)
+{
+	printf("usage: %s [-k keypoint_log_file] [-o result.json] [-f filter] [-t min_time] [-n repetition]\n", name);
+	printf("       %s -c base.json new.json [-r threshold]\n", name);
+	printf("  -k : add benchmarks with the recorded keypoints (synthetic keypoints are always used)\n");
+	printf("  -o : write the results in JSON (Google Benchmark format)\n");
+	printf("  -f : run only benchmarks whose name contains the filter\n");
+	printf("  -t : minimum time [sec] of each repetition (default: %.1f)\n", DEFAULT_MIN_TIME);
+	printf("  -n : the number of repetitions. the median is reported (default: %d)\n", DEFAULT_REPETITION);
+	printf("  -c : compare two results and report regressions. exit code is 1 if any\n");
+	printf("  -r : regression threshold [%%] (default: %.1f)\n", DEFAULT_THRESHOLD);
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	std::string keypointLogFile;
+	std::string outputFile;
+	std::string filter;
+	double minTime = DEFAULT_MIN_TIME;
+	int32_t numRepetition = DEFAULT_REPETITION;
+	std::string baseFile;
+	std::string newFile;
+	double threshold = DEFAULT_THRESHOLD;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			keypointLogFile = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			outputFile = argv[++i];
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			minTime = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			numRepetition = (std::max)(atoi(argv[++i]), 1);
+		} else if (strcmp(argv[i], "-c") == 0 && i + 2 < argc) {
+			baseFile = argv[++i];
+			newFile = argv[++i];
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			threshold = atof(argv[++i]);
+		} else {
+			printUsage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!baseFile.empty()) {
+		const int32_t numRegression = compare(baseFile, newFile, threshold);
+		return (numRegression == 0) ? 0 : 1;
+	}
+
+	std::vector<BENCHMARK> benchmarkList;
+	addKeypointBenchmarks(benchmarkList, "synthetic", createSyntheticFrames());
+	if (!keypointLogFile.empty()) {
+		const auto& frameList = loadRecordedFrames(keypointLogFile);
+		if (frameList.empty()) {
+			printf("[ERR] No keypoints in %s\n", keypointLogFile.c_str());
+			return -1;
+		}
+		addKeypointBenchmarks(benchmarkList, "recorded", frameList);
+	}
+	addDecodeBenchmarks(benchmarkList);
+	addSignatureBenchmarks(benchmarkList);
+	addTracerBenchmarks(benchmarkList);
+
+	std::vector<BENCHMARK_RESULT> resultList;
+	printf("%-40s %12s %12s %12s %12s\n", "name", "time [ns]", "min [ns]", "stddev [ns]", "iterations");
+	for (const auto& benchmark : benchmarkList) {
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+		const auto& result = runBenchmark(benchmark, minTime, numRepetition);
+		printf("%-40s %12.1f %12.1f %12.1f %12lld\n", result.name.c_str(), result.time, result.timeMin, result.timeStddev, static_cast<long long>(result.numIteration));
+		resultList.push_back(result);
+	}
+
+	if (!outputFile.empty()) {
+		if (writeJson(outputFile, resultList, keypointLogFile) != 0) {
+			return -1;
+		}
+		printf("Results are written to %s\n", outputFile.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,378 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "Config.h"
+#include "PoseEngine.h"
+#include "KeypointDecoder.h"
+
+/*** Macro ***/
+#define WORK_DIR             RESOURCE_DIR
+#define DEFAULT_ANNOTATION   "person_keypoints.json"	// in the image directory
+#define DEFAULT_NUM_INVOKE   5		// multi-scale mode needs some frames to find the person
+#define DEFAULT_PCK_ALPHA    0.1f	// correct if the error is within alpha * max(bbox width, height)
+
+/*** Global variable ***/
+static constexpr int32_t NUM_JOINTS = KeypointDecoder::NUM_JOINTS;
+
+static const std::array<const char*, NUM_JOINTS> JOINT_NAME_LIST = { {
+	"nose", "left_eye", "right_eye", "left_ear", "right_ear",
+	"left_shoulder", "right_shoulder", "left_elbow", "right_elbow", "left_wrist", "right_wrist",
+	"left_hip", "right_hip", "left_knee", "right_knee", "left_ankle", "right_ankle",
+} };
+
+/* per-keypoint constants of COCO OKS (cocoeval.py) */
+static const std::array<float, NUM_JOINTS> OKS_SIGMA_LIST = { {
+	0.026f, 0.025f, 0.025f, 0.035f, 0.035f,
+	0.079f, 0.079f, 0.072f, 0.072f, 0.062f, 0.062f,
+	0.107f, 0.107f, 0.087f, 0.087f, 0.089f, 0.089f,
+} };
+
+typedef struct {
+	std::array<float, NUM_JOINTS> x;	// [px]
+	std::array<float, NUM_JOINTS> y;
+	std::array<int32_t, NUM_JOINTS> visibility;	// 0: not labeled, 1: labeled but not visible, 2: visible
+	float area;		// [px^2] segment area. bbox area is used if not given
+	float bboxWidth;
+	float bboxHeight;
+} ANNOTATION;
+
+typedef struct {
+	std::string filename;
+	std::vector<ANNOTATION> annotationList;	// empty if not labeled (latency only)
+} SAMPLE;
+
+typedef struct {
+	std::string name;
+	int32_t model;
+	int32_t scaleMode;
+} SETTING;
+
+typedef struct SCORE_ {
+	double  oksSum;
+	int32_t numOks;
+	int32_t numOks50;
+	int32_t numOks75;
+	std::array<double, NUM_JOINTS>  ksSum;	// similarity of each joint (the term of OKS)
+	std::array<int32_t, NUM_JOINTS> numCorrect;
+	std::array<int32_t, NUM_JOINTS> numLabeled;
+	std::vector<double> timePreProcessList;
+	std::vector<double> timeInferenceList;
+	std::vector<double> timePostProcessList;
+	SCORE_() : oksSum(0), numOks(0), numOks50(0), numOks75(0)
+	{
+		ksSum.fill(0);
+		numCorrect.fill(0);
+		numLabeled.fill(0);
+	}
+} SCORE;
+
+/*** Function ***/
+/* COCO keypoint format. only "images" and "annotations" are used */
+static int32_t loadAnnotation(const std::string& filename, const std::string& imageDir, std::vector<SAMPLE>& sampleList)
+{
+	cv::FileStorage fs(filename, cv::FileStorage::READ);
+	if (!fs.isOpened()) {
+		return -1;
+	}
+
+	std::map<int32_t, size_t> imageIdToIndex;
+	for (const auto& node : fs["images"]) {
+		SAMPLE sample;
+		sample.filename = imageDir + "/" + static_cast<std::string>(node["file_name"]);
+		imageIdToIndex[static_cast<int32_t>(node["id"])] = sampleList.size();
+		sampleList.push_back(sample);
+	}
+
+	int32_t numAnnotation = 0;
+	for (const auto& node : fs["annotations"]) {
+		const auto& it = imageIdToIndex.find(static_cast<int32_t>(node["image_id"]));
+		if (it == imageIdToIndex.end()) continue;
+		if (!node["iscrowd"].empty() && static_cast<int32_t>(node["iscrowd"]) != 0) continue;
+		const cv::FileNode& keypoints = node["keypoints"];
+		if (keypoints.size() != NUM_JOINTS * 3) continue;
+
+		ANNOTATION annotation;
+		int32_t numLabeled = 0;
+		for (int32_t i = 0; i < NUM_JOINTS; i++) {
+			annotation.x[i] = static_cast<float>(keypoints[i * 3]);
+			annotation.y[i] = static_cast<float>(keypoints[i * 3 + 1]);
+			annotation.visibility[i] = static_cast<int32_t>(keypoints[i * 3 + 2]);
+			if (annotation.visibility[i] > 0) numLabeled++;
+		}
+		if (numLabeled == 0) continue;
+
+		annotation.bboxWidth = 0;
+		annotation.bboxHeight = 0;
+		const cv::FileNode& bbox = node["bbox"];
+		if (bbox.size() == 4) {
+			annotation.bboxWidth = static_cast<float>(bbox[2]);
+			annotation.bboxHeight = static_cast<float>(bbox[3]);
+		} else {
+			/* extent of labeled keypoints */
+			float xMin = 1e9f, yMin = 1e9f, xMax = -1e9f, yMax = -1e9f;
+			for (int32_t i = 0; i < NUM_JOINTS; i++) {
+				if (annotation.visibility[i] == 0) continue;
+				xMin = (std::min)(xMin, annotation.x[i]);
+				xMax = (std::max)(xMax, annotation.x[i]);
+				yMin = (std::min)(yMin, annotation.y[i]);
+				yMax = (std::max)(yMax, annotation.y[i]);
+			}
+			annotation.bboxWidth = xMax - xMin;
+			annotation.bboxHeight = yMax - yMin;
+		}
+		annotation.area = node["area"].empty() ? 0 : static_cast<float>(node["area"]);
+		if (annotation.area <= 0) annotation.area = annotation.bboxWidth * annotation.bboxHeight;
+
+		sampleList[it->second].annotationList.push_back(annotation);
+		numAnnotation++;
+	}
+	printf("Annotation: %d persons in %zu images (%s)\n", numAnnotation, sampleList.size(), filename.c_str());
+	return 0;
+}
+
+/* OKS as cocoeval.py. ksList is the similarity of each labeled joint (-1 if not labeled) */
+static float calculateOks(const ANNOTATION& annotation, const std::vector<std::pair<float, float>>& jointList, std::array<float, NUM_JOINTS>& ksList)
+{
+	double sum = 0;
+	int32_t num = 0;
+	for (int32_t i = 0; i < NUM_JOINTS; i++) {
+		ksList[i] = -1;
+		if (annotation.visibility[i] == 0) continue;
+		const float dx = jointList[i].first - annotation.x[i];
+		const float dy = jointList[i].second - annotation.y[i];
+		const float k = OKS_SIGMA_LIST[i] * 2;
+		const float e = (dx * dx + dy * dy) / (k * k) / (annotation.area + std::numeric_limits<float>::epsilon()) / 2;
+		ksList[i] = std::exp(-e);
+		sum += ksList[i];
+		num++;
+	}
+	return (num > 0) ? static_cast<float>(sum / num) : 0.0f;
+}
+
+/* The model finds one person. it's compared with the annotation of the best OKS */
+static void evaluate(const SAMPLE& sample, const std::vector<std::pair<float, float>>& jointList, float pckAlpha, SCORE& score)
+{
+	float bestOks = -1;
+	const ANNOTATION* bestAnnotation = nullptr;
+	std::array<float, NUM_JOINTS> bestKsList;
+	for (const auto& annotation : sample.annotationList) {
+		std::array<float, NUM_JOINTS> ksList;
+		const float oks = calculateOks(annotation, jointList, ksList);
+		if (oks > bestOks) {
+			bestOks = oks;
+			bestAnnotation = &annotation;
+			bestKsList = ksList;
+		}
+	}
+	if (!bestAnnotation) return;
+
+	score.oksSum += bestOks;
+	score.numOks++;
+	if (bestOks >= 0.5f) score.numOks50++;
+	if (bestOks >= 0.75f) score.numOks75++;
+
+	const float threshold = pckAlpha * (std::max)(bestAnnotation->bboxWidth, bestAnnotation->bboxHeight);
+	for (int32_t i = 0; i < NUM_JOINTS; i++) {
+		if (bestAnnotation->visibility[i] == 0) continue;
+		const float dx = jointList[i].first - bestAnnotation->x[i];
+		const float dy = jointList[i].second - bestAnnotation->y[i];
+		score.numLabeled[i]++;
+		if (std::sqrt(dx * dx + dy * dy) <= threshold) score.numCorrect[i]++;
+		score.ksSum[i] += bestKsList[i];
+	}
+}
+
+static double getMedian(std::vector<double> valueList)
+{
+	if (valueList.empty()) return 0;
+	std::nth_element(valueList.begin(), valueList.begin() + valueList.size() / 2, valueList.end());
+	return valueList[valueList.size() / 2];
+}
+
+static void printUsage(const char* name)
+{
+	printf("usage: %s [-i image_dir] [-a annotation.json] [-f filter] [-n invoke_num] [-p pck_alpha] [-t thread_num]\n", name);
+	printf("  -i : directory of images (default: resource)\n");
+	printf("  -a : COCO keypoint annotation (default: image_dir/%s). only latency is measured without it\n", DEFAULT_ANNOTATION);
+	printf("  -f : run only settings whose name contains the filter (e.g. int8, multi)\n");
+	printf("  -n : the number of inferences for each image. the last result is evaluated (default: %d)\n", DEFAULT_NUM_INVOKE);
+	printf("  -p : PCK threshold relative to max(bbox width, height) (default: %.2f)\n", DEFAULT_PCK_ALPHA);
+	printf("  -t : the number of inference threads (default: 4)\n");
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	std::string imageDir = WORK_DIR;
+	std::string annotationFile;
+	std::string filter;
+	int32_t numInvoke = DEFAULT_NUM_INVOKE;
+	float pckAlpha = DEFAULT_PCK_ALPHA;
+	int32_t numThreads = 4;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			imageDir = argv[++i];
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			annotationFile = argv[++i];
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			numInvoke = (std::max)(atoi(argv[++i]), 1);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			pckAlpha = static_cast<float>(atof(argv[++i]));
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			numThreads = atoi(argv[++i]);
+		} else {
+			printUsage(argv[0]);
+			return -1;
+		}
+	}
+	if (annotationFile.empty()) annotationFile = imageDir + "/" + DEFAULT_ANNOTATION;
+
+	/*** Load images and annotation ***/
+	std::vector<SAMPLE> sampleList;
+	if (loadAnnotation(annotationFile, imageDir, sampleList) != 0) {
+		/* note: labels are never made from predictions. without annotation, only latency is reported */
+		printf("Annotation is not found (%s). Only latency is measured\n", annotationFile.c_str());
+		for (const char* pattern : { "/*.jpg", "/*.png" }) {
+			std::vector<cv::String> filenameList;
+			cv::glob(imageDir + pattern, filenameList, false);
+			for (const auto& filename : filenameList) {
+				SAMPLE sample;
+				sample.filename = filename;
+				sampleList.push_back(sample);
+			}
+		}
+	}
+	std::vector<cv::Mat> imageList;
+	for (const auto& sample : sampleList) {
+		imageList.push_back(cv::imread(sample.filename));
+		if (imageList.back().empty()) printf("[ERR] Failed to read %s\n", sample.filename.c_str());
+	}
+	if (sampleList.empty()) {
+		printf("[ERR] No image in %s\n", imageDir.c_str());
+		return -1;
+	}
+
+	/*** Initialize all the models ***/
+	PoseEngine poseEngine;
+	if (poseEngine.initialize(WORK_DIR, numThreads, true) != PoseEngine::RET_OK) {
+		return -1;
+	}
+	if (poseEngine.warmup(2) != PoseEngine::RET_OK) {
+		return -1;
+	}
+
+	std::vector<SETTING> settingList;
+	for (int32_t model = 0; model < PoseEngine::MODEL_NUM; model++) {
+		settingList.push_back({ std::string(PoseEngine::getModelName(model)) + "/full", model, PoseEngine::SCALE_MODE_FULL });
+		settingList.push_back({ std::string(PoseEngine::getModelName(model)) + "/multi", model, PoseEngine::SCALE_MODE_MULTI });
+	}
+
+	/*** Run each setting ***/
+	std::vector<SETTING> evaluatedSettingList;
+	std::vector<SCORE> scoreList;
+	for (const auto& setting : settingList) {
+		if (!filter.empty() && setting.name.find(filter) == std::string::npos) continue;
+		if (poseEngine.setModel(setting.model) != PoseEngine::RET_OK) {
+			printf("%s is skipped\n", setting.name.c_str());
+			continue;
+		}
+		SCORE score;
+		for (size_t i = 0; i < sampleList.size(); i++) {
+			if (imageList[i].empty()) continue;
+			/* each image is an independent scene. reset tracking */
+			poseEngine.setScaleMode(setting.scaleMode);
+			PoseEngine::RESULT result;
+			for (int32_t n = 0; n < numInvoke; n++) {
+				if (poseEngine.invoke(imageList[i], result) != PoseEngine::RET_OK) {
+					return -1;
+				}
+				score.timePreProcessList.push_back(result.timePreProcess);
+				score.timeInferenceList.push_back(result.timeInference);
+				score.timePostProcessList.push_back(result.timePostProcess);
+			}
+
+			std::vector<std::pair<float, float>> jointList;
+			for (const auto& joint : result.poseKeypointCoords[0]) {
+				jointList.push_back(std::make_pair(joint.first * imageList[i].cols, joint.second * imageList[i].rows));
+			}
+			evaluate(sampleList[i], jointList, pckAlpha, score);
+		}
+		evaluatedSettingList.push_back(setting);
+		scoreList.push_back(score);
+	}
+	poseEngine.finalize();
+
+	/*** Report ***/
+	printf("\n%-22s %8s %8s %8s | %6s %8s %8s %8s %6s\n", "setting", "pre", "infer", "post", "OKS", "OKS>=.5", "OKS>=.75", "PCK", "images");
+	for (size_t s = 0; s < evaluatedSettingList.size(); s++) {
+		const SCORE& score = scoreList[s];
+		printf("%-22s %8.2f %8.2f %8.2f | ", evaluatedSettingList[s].name.c_str(),
+			getMedian(score.timePreProcessList), getMedian(score.timeInferenceList), getMedian(score.timePostProcessList));
+		if (score.numOks == 0) {
+			printf("%6s %8s %8s %8s %6d\n", "-", "-", "-", "-", 0);
+			continue;
+		}
+		int32_t numCorrect = 0;
+		int32_t numLabeled = 0;
+		for (int32_t i = 0; i < NUM_JOINTS; i++) {
+			numCorrect += score.numCorrect[i];
+			numLabeled += score.numLabeled[i];
+		}
+		printf("%6.3f %7.1f%% %7.1f%% %7.1f%% %6d\n", score.oksSum / score.numOks, 100.0 * score.numOks50 / score.numOks, 100.0 * score.numOks75 / score.numOks,
+			(numLabeled > 0) ? 100.0 * numCorrect / numLabeled : 0.0, score.numOks);
+	}
+	printf("(latency is the median [msec], PCK@%.2f)\n", pckAlpha);
+
+	/* per joint: PCK [%] / mean similarity of OKS */
+	if (std::none_of(scoreList.begin(), scoreList.end(), [](const SCORE& score) { return score.numOks > 0; })) {
+		return 0;
+	}
+	printf("\nPCK [%%] / OKS similarity of each joint\n%-16s", "joint");
+	for (size_t s = 0; s < evaluatedSettingList.size(); s++) printf(" %14s", ("[" + std::to_string(s) + "]").c_str());
+	printf("\n");
+	for (int32_t i = 0; i < NUM_JOINTS; i++) {
+		printf("%-16s", JOINT_NAME_LIST[i]);
+		for (const auto& score : scoreList) {
+			if (score.numLabeled[i] == 0) {
+				printf(" %14s", "-");
+			} else {
+				printf("  %5.1f / %.3f", 100.0 * score.numCorrect[i] / score.numLabeled[i], score.ksSum[i] / score.numLabeled[i]);
+			}
+		}
+		printf("\n");
+	}
+	for (size_t s = 0; s < evaluatedSettingList.size(); s++) printf("[%zu] %s\n", s, evaluatedSettingList[s].name.c_str());
+
+	return 0;
+}
@@ -0,0 +1,219 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cmath>
+
+/* for socket */
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "PreviewServer.h"
+
+/*** Macro ***/
+#define TEST_FPS  30
+
+/*** Function ***/
+static double getNowMsec()
+{
+	return static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count() * 1000.0;
+}
+
+static int32_t connectStream(int32_t port, const char* path)
+{
+	int32_t fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<uint16_t>(port));
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+		printf("[ERR] Failed to connect to port %d\n", port);
+		if (fd >= 0) close(fd);
+		return -1;
+	}
+	std::string request = std::string("GET ") + path + " HTTP/1.0\r\n\r\n";
+	if (send(fd, request.data(), request.size(), 0) != static_cast<ssize_t>(request.size())) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Publish a synthetic frame (a moving person) to test without camera and model */
+static void testServerThread(int32_t port, std::atomic<bool>* isRunning)
+{
+	PreviewServer server;
+	PreviewServer::PARAM param;
+	param.port = port;
+	if (server.initialize(param) != PreviewServer::RET_OK) {
+		*isRunning = false;
+		return;
+	}
+	cv::Mat image(480, 640, CV_8UC3, cv::Scalar(64, 64, 64));
+	std::vector<std::pair<float, float>> jointList(17);
+	std::vector<float> scoreList(17, 0.8f);
+	for (int32_t frame = 0; *isRunning; frame++) {
+		const float x = 0.5f + 0.3f * std::sin(frame * 0.05f);
+		for (int32_t i = 0; i < 17; i++) jointList[i] = std::pair<float, float>(x, 0.2f + i * 0.04f);
+		image.setTo(cv::Scalar(64, 64, 64));
+		cv::circle(image, cv::Point(static_cast<int32_t>(x * image.cols), 200), 40, cv::Scalar(0, 200, 255), -1);
+		server.publish(getNowMsec(), image, jointList, scoreList, (frame % 60 == 0) ? "kwkF" : "");
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000 / TEST_FPS));
+	}
+	server.finalize();
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	int32_t port = 8080;
+	int32_t duration = 10;
+	bool isTest = false;
+	bool showImage = false;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			port = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			duration = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0) {
+			isTest = true;
+		} else if (strcmp(argv[i], "-i") == 0) {
+			showImage = true;
+		} else {
+			printf("usage: %s [-p port] [-d duration_sec] [-t] [-i]\n", argv[0]);
+			printf("  -t : run a preview server with synthetic frames in this process (loopback test)\n");
+			printf("  -i : show the image with keypoints drawn by this client\n");
+			return -1;
+		}
+	}
+
+	std::atomic<bool> isRunning(true);
+	std::thread testServer;
+	if (isTest) {
+		testServer = std::thread(testServerThread, port, &isRunning);
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	int32_t keypointFd = connectStream(port, "/keypoints");
+	int32_t imageFd = connectStream(port, "/stream.mjpg");
+	if (keypointFd < 0 || imageFd < 0) {
+		isRunning = false;
+		if (testServer.joinable()) testServer.join();
+		return -1;
+	}
+
+	std::string keypointBuffer;
+	std::string imageBuffer;
+	bool isKeypointHeaderSkipped = false;
+	bool isImageHeaderSkipped = false;
+	std::vector<std::pair<float, float>> jointList;
+	int64_t keypointBytes = 0, imageBytes = 0;
+	int32_t numKeypoint = 0, numImage = 0;
+	double sumLatency = 0;
+	const double timeStart = getNowMsec();
+	while (getNowMsec() - timeStart < duration * 1000.0 && isRunning) {
+		struct pollfd pollList[2] = { { keypointFd, POLLIN, 0 }, { imageFd, POLLIN, 0 } };
+		if (poll(pollList, 2, 100) <= 0) continue;
+		char buffer[16384];
+		for (int32_t i = 0; i < 2; i++) {
+			if (!(pollList[i].revents & POLLIN)) continue;
+			ssize_t size = recv(pollList[i].fd, buffer, sizeof(buffer), 0);
+			if (size <= 0) {
+				isRunning = false;
+				break;
+			}
+			(i == 0 ? keypointBuffer : imageBuffer).append(buffer, size);
+			(i == 0 ? keypointBytes : imageBytes) += size;
+		}
+
+		/* Keypoint stream: "frameId timestamp command x0 y0 score0 ..." */
+		if (!isKeypointHeaderSkipped && keypointBuffer.find("\r\n\r\n") != std::string::npos) {
+			keypointBuffer.erase(0, keypointBuffer.find("\r\n\r\n") + 4);
+			isKeypointHeaderSkipped = true;
+		}
+		size_t pos;
+		while (isKeypointHeaderSkipped && (pos = keypointBuffer.find('\n')) != std::string::npos) {
+			const std::string line = keypointBuffer.substr(0, pos);
+			keypointBuffer.erase(0, pos + 1);
+			double timestamp;
+			unsigned frameId;
+			char command[32];
+			int32_t offset = 0;
+			if (sscanf(line.c_str(), "%u %lf %31s%n", &frameId, &timestamp, command, &offset) < 3) continue;
+			sumLatency += getNowMsec() - timestamp;
+			numKeypoint++;
+			jointList.clear();
+			float x, y, score;
+			int32_t length;
+			const char* p = line.c_str() + offset;
+			while (sscanf(p, "%f %f %f%n", &x, &y, &score, &length) == 3) {
+				jointList.push_back(std::pair<float, float>(x, score > 0.2f ? y : -1));
+				p += length;
+			}
+		}
+
+		/* MJPEG stream: "--frame\r\n headers \r\n\r\n jpeg \r\n" */
+		if (!isImageHeaderSkipped && imageBuffer.find("\r\n\r\n") != std::string::npos) {
+			imageBuffer.erase(0, imageBuffer.find("\r\n\r\n") + 4);
+			isImageHeaderSkipped = true;
+		}
+		while (isImageHeaderSkipped) {
+			size_t headerEnd = imageBuffer.find("\r\n\r\n");
+			size_t lengthPos = imageBuffer.find("Content-Length: ");
+			if (headerEnd == std::string::npos || lengthPos == std::string::npos || lengthPos > headerEnd) break;
+			size_t length = strtoul(imageBuffer.c_str() + lengthPos + 16, nullptr, 10);
+			if (imageBuffer.size() < headerEnd + 4 + length + 2) break;
+			if (showImage) {
+				std::vector<uint8_t> jpeg(imageBuffer.begin() + headerEnd + 4, imageBuffer.begin() + headerEnd + 4 + length);
+				cv::Mat image = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+				for (const auto& joint : jointList) {
+					if (joint.second < 0) continue;
+					cv::circle(image, cv::Point(static_cast<int32_t>(joint.first * image.cols), static_cast<int32_t>(joint.second * image.rows)), 3, cv::Scalar(0, 255, 0), -1);
+				}
+				cv::imshow("PreviewClient", image);
+				cv::waitKey(1);
+			}
+			imageBuffer.erase(0, headerEnd + 4 + length + 2);
+			numImage++;
+		}
+	}
+	const double elapsed = (getNowMsec() - timeStart) / 1000.0;
+
+	close(keypointFd);
+	close(imageFd);
+	isRunning = false;
+	if (testServer.joinable()) testServer.join();
+
+	printf("keypoints: %.1f [lines/sec], %.1f [KB/sec], latency = %.2f [msec]\n", numKeypoint / elapsed, keypointBytes / elapsed / 1024, (numKeypoint > 0) ? sumLatency / numKeypoint : 0.0);
+	printf("image    : %.1f [frames/sec], %.1f [KB/sec]\n", numImage / elapsed, imageBytes / elapsed / 1024);
+	return (numKeypoint > 0 && numImage > 0) ? 0 : -1;
+}
@@ -0,0 +1,244 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+/* for pty */
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+/* for My modules */
+#include "Uart.h"
+#include "CommandProtocol.h"
+
+/*** Macro ***/
+#define BAUDRATE         115200
+#define BURST_LENGTH     50		// [request]
+#define BURST_INTERVAL   2		// [msec] interval of requests in a burst
+#define IDLE_TIME        500	// [msec] between bursts
+#define STOP_COMMAND     "kbalance"	// every other burst ends with stop (urgent)
+
+/*** Global variable ***/
+static const std::chrono::steady_clock::time_point s_t0 = std::chrono::steady_clock::now();
+
+/* a flickering decision, as CommandDecider outputs around a threshold */
+static const std::vector<std::string> COMMAND_LIST = { "kwkF", "kwkF", "kwkF", "kwkL", "kwkR", "kbalance", "kcrF", "ksit" };
+
+/*** Function ***/
+static double getNowMsec()
+{
+	return static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - s_t0).count() * 1000.0;
+}
+
+/* Pseudo robot on the master side of the pty. It logs received frames and responds with the token like OpenCat */
+class PseudoRobot {
+public:
+	PseudoRobot(int32_t fd, double processTime) : m_fd(fd), m_processTime(processTime), m_isRunning(true) {
+		m_thread = std::thread(&PseudoRobot::run, this);
+	}
+	~PseudoRobot() {
+		m_isRunning = false;
+		m_thread.join();
+	}
+	std::vector<std::pair<double, std::string>> getLog() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_log;
+	}
+
+private:
+	void run() {
+		std::string buffer;
+		while (m_isRunning) {
+			struct pollfd pfd = { m_fd, POLLIN, 0 };
+			if (poll(&pfd, 1, 10) <= 0) continue;
+			char data[256];
+			ssize_t size = read(m_fd, data, sizeof(data));
+			if (size <= 0) continue;
+			buffer.append(data, size);
+			size_t pos;
+			while ((pos = buffer.find('\n')) != std::string::npos) {
+				std::string line = buffer.substr(0, pos);
+				buffer.erase(0, pos + 1);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_log.push_back(std::pair<double, std::string>(getNowMsec(), line));
+				}
+				if (m_processTime > 0) std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(m_processTime * 1000)));
+				std::string response = line.substr(0, 1) + "\r\n";
+				if (write(m_fd, response.data(), response.size()) < 0) break;
+			}
+		}
+	}
+
+private:
+	int32_t m_fd;
+	double  m_processTime;
+	std::atomic<bool> m_isRunning;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::vector<std::pair<double, std::string>> m_log;
+};
+
+static int32_t runCase(const char* slaveName, int32_t masterFd, bool useProtocol, int32_t numBurst, double processTime)
+{
+	/* Flush the data left by the previous case */
+	char dummy[256];
+	while (read(masterFd, dummy, sizeof(dummy)) > 0) {}
+
+	Uart uart;
+	if (uart.initialize(slaveName) < 0) return -1;
+	PseudoRobot robot(masterFd, processTime);
+	CommandProtocol protocol;
+	protocol.initialize(CommandProtocol::PARAM());
+
+	/* Requests: bursts of a flickering decision, and the final command of each burst */
+	std::mt19937 engine(0);
+	std::vector<double> burstEndList;
+	std::vector<std::string> finalCommandList;
+	int32_t numRequest = 0;
+	int32_t numFrame = 0;
+	int64_t numBytes = 0;
+	std::vector<CommandProtocol::RESPONSE> responseList;
+	for (int32_t burst = 0; burst < numBurst; burst++) {
+		std::string command;
+		double timeLastRequest = 0;
+		const double timeStart = getNowMsec();
+		for (int32_t i = 0; i < BURST_LENGTH; i++) {
+			/* same loop as the uart thread in Main.cpp */
+			command = COMMAND_LIST[engine() % COMMAND_LIST.size()];
+			const bool isUrgent = (burst % 2 == 1) && (i == BURST_LENGTH - 1);
+			if (isUrgent) command = STOP_COMMAND;
+			numRequest++;
+			timeLastRequest = getNowMsec();
+			if (useProtocol) {
+				protocol.request(command, getNowMsec(), isUrgent);
+				std::string frame;
+				while (protocol.getFrame(getNowMsec(), frame)) uart.send(frame.c_str());
+				char buffer[256];
+				int32_t size = uart.recv(buffer, sizeof(buffer), 0);
+				if (size > 0) protocol.parse(buffer, size, getNowMsec(), responseList);
+			} else {
+				uart.send(CommandProtocol::encode(command).c_str());
+				numFrame++;
+				numBytes += CommandProtocol::encode(command).size();
+			}
+			std::this_thread::sleep_until(s_t0 + std::chrono::microseconds(static_cast<int64_t>((timeStart + (i + 1) * BURST_INTERVAL) * 1000)));
+		}
+		burstEndList.push_back(timeLastRequest);
+		finalCommandList.push_back(command);
+
+		/* Idle: send the held command and read responses */
+		while (getNowMsec() - burstEndList.back() < IDLE_TIME) {
+			std::string frame;
+			while (useProtocol && protocol.getFrame(getNowMsec(), frame)) uart.send(frame.c_str());
+			char buffer[256];
+			int32_t size = uart.recv(buffer, sizeof(buffer), 1);
+			if (size > 0 && useProtocol) protocol.parse(buffer, size, getNowMsec(), responseList);
+		}
+	}
+	const double timeEnd = getNowMsec();
+	const auto& log = robot.getLog();
+	uart.finalize();
+
+	/* Time until the robot reaches the final command of each burst */
+	int32_t numMismatch = 0;
+	std::array<int32_t, 2> numLatencyList = { { 0, 0 } };	// normal, stop
+	std::array<double, 2> sumLatencyList = { { 0, 0 } };
+	std::array<double, 2> maxLatencyList = { { 0, 0 } };
+	size_t index = 0;
+	std::string state;
+	double stateTime = 0;
+	for (size_t burst = 0; burst < burstEndList.size(); burst++) {
+		const double nextBurstStart = burstEndList[burst] + IDLE_TIME;
+		for (; index < log.size() && log[index].first < nextBurstStart; index++) {
+			if (log[index].second != state) {
+				state = log[index].second;
+				stateTime = log[index].first;
+			}
+		}
+		if (state != finalCommandList[burst]) {
+			numMismatch++;
+			continue;
+		}
+		const double latency = (std::max)(0.0, stateTime - burstEndList[burst]);
+		const int32_t type = burst % 2;
+		numLatencyList[type]++;
+		sumLatencyList[type] += latency;
+		maxLatencyList[type] = (std::max)(maxLatencyList[type], latency);
+	}
+
+	if (useProtocol) {
+		numFrame = protocol.getStatistics().numSent;
+		numBytes = protocol.getStatistics().numBytes;
+	}
+	const double duration = (timeEnd - burstEndList[0] + BURST_LENGTH * BURST_INTERVAL) / 1000.0;
+	printf("=== %s ===\n", useProtocol ? "CommandProtocol" : "raw (every request)");
+	printf("requests = %d, frames = %d (%.1f [frames/sec]), received = %d\n", numRequest, numFrame, numFrame / duration, static_cast<int32_t>(log.size()));
+	printf("bytes = %lld, uart busy at %d bps = %.1f [msec] (%.1f %%)\n", static_cast<long long>(numBytes), BAUDRATE, numBytes * 10.0 / BAUDRATE * 1000.0, numBytes * 10.0 / BAUDRATE / duration * 100.0);
+	printf("final state: mismatch = %d / %d\n", numMismatch, numBurst);
+	for (int32_t type = 0; type < 2; type++) {
+		printf("  %s: latency = %.1f (max %.1f) [msec]\n", (type == 0) ? "normal" : "stop  ", (numLatencyList[type] > 0) ? sumLatencyList[type] / numLatencyList[type] : 0.0, maxLatencyList[type]);
+	}
+	if (useProtocol) protocol.printStatistics();
+	return 0;
+}
+
+/* Send bursts of commands to a pseudo robot through a pty, and compare raw sending and CommandProtocol */
+int32_t main(int32_t argc, char* argv[])
+{
+	int32_t numBurst = 10;
+	double processTime = 2.0;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			numBurst = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			processTime = atof(argv[++i]);
+		} else {
+			printf("usage: %s [-n burst_num] [-p process_time]\n", argv[0]);
+			printf("  -p : time [msec] for the pseudo robot to process a command (default: 2.0)\n");
+			return -1;
+		}
+	}
+
+	int32_t masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+		printf("[ERR] Failed to open pty\n");
+		return -1;
+	}
+	const std::string slaveName = ptsname(masterFd);
+	fcntl(masterFd, F_SETFL, O_NONBLOCK);
+	printf("pty: %s, %d bursts of %d requests (every %d msec)\n", slaveName.c_str(), numBurst, BURST_LENGTH, BURST_INTERVAL);
+
+	runCase(slaveName.c_str(), masterFd, false, numBurst, processTime);
+	runCase(slaveName.c_str(), masterFd, true, numBurst, processTime);
+
+	close(masterFd);
+	return 0;
+}
@@ -0,0 +1,353 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "Config.h"
+#include "PoseEngine.h"
+#include "PoseAnalyzer.h"
+#include "GestureRecognizer.h"
+#include "CommandDecider.h"
+#include "KeypointLog.h"
+
+/*** Macro ***/
+#define WORK_DIR     RESOURCE_DIR
+#define MIN_PRESENCE_JOINTS 6
+#define STABLE_FRAMES       3		// a change of the unfiltered pose is regarded as a real change if it lasts this number of frames
+#define MATCH_WINDOW_BEFORE 300.0	// [msec] a change of the output is matched with the real change in this window
+#define MATCH_WINDOW_AFTER  1500.0	// [msec]
+
+/*** Function ***/
+static double getElapsedUsec(const std::chrono::steady_clock::time_point& t0, const std::chrono::steady_clock::time_point& t1)
+{
+	return static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000000.0;
+}
+
+static void printStatistics(const char* name, std::vector<double> timeList)
+{
+	if (timeList.empty()) return;
+	std::sort(timeList.begin(), timeList.end());
+	double sum = 0;
+	for (const auto& t : timeList) sum += t;
+	printf("%-20s: avg = %8.2f, p95 = %8.2f, max = %8.2f [usec]\n", name, sum / timeList.size(), timeList[timeList.size() * 95 / 100], timeList.back());
+}
+
+/* Run pose estimation on a video (or an image) with each setting, and compare detection and cost */
+/* note: there is no ground truth. the number of detected joints and their scores are used to see accuracy */
+static int32_t runVideo(const char* filename, int32_t maxFrameNum)
+{
+	typedef struct {
+		const char* name;
+		int32_t     scaleMode;
+		bool        usePersonDetector;
+	} SETTING;
+	const std::vector<SETTING> settingList = {
+		{ "full", PoseEngine::SCALE_MODE_FULL, false },
+		{ "multi", PoseEngine::SCALE_MODE_MULTI, false },
+		{ "full + detector", PoseEngine::SCALE_MODE_FULL, true },
+		{ "multi + detector", PoseEngine::SCALE_MODE_MULTI, true },
+	};
+	const float thresholdScore = Config::get().thresholdScore;
+
+	for (const auto& setting : settingList) {
+		PoseEngine poseEngine;
+		if (poseEngine.initialize(WORK_DIR, 4) != PoseEngine::RET_OK) {
+			return -1;
+		}
+		poseEngine.setScaleMode(setting.scaleMode);
+		if (poseEngine.setPersonDetector(setting.usePersonDetector) != PoseEngine::RET_OK) {
+			poseEngine.finalize();
+			return -1;
+		}
+		(void)poseEngine.warmup(2);
+
+		cv::VideoCapture cap(filename);
+		cv::Mat image = cv::imread(filename);	// an image is processed as a still video
+		if (!cap.isOpened() && image.empty()) {
+			printf("[ERR] Failed to open %s\n", filename);
+			poseEngine.finalize();
+			return -1;
+		}
+
+		std::vector<double> timeList;
+		std::vector<double> timeDetectionList;
+		std::vector<double> timePoseList;
+		std::array<int32_t, 3> numRegionList = { 0, 0, 0 };
+		int32_t numFrame = 0;
+		int32_t numPresence = 0;
+		int32_t numSkipped = 0;
+		int32_t numJoint = 0;
+		double sumScore = 0;
+		for (; numFrame < maxFrameNum; numFrame++) {
+			cv::Mat frame;
+			if (!image.empty()) {
+				frame = image;
+			} else if (!cap.read(frame) || frame.empty()) {
+				break;
+			}
+			PoseEngine::RESULT result;
+			if (poseEngine.invoke(frame, result) != PoseEngine::RET_OK) break;
+			timeList.push_back((result.timeDetection + result.timePreProcess + result.timeInference + result.timePostProcess) * 1000.0);
+			if (result.timeDetection > 0) timeDetectionList.push_back(result.timeDetection * 1000.0);
+			if (!result.isSkipped) timePoseList.push_back((result.timePreProcess + result.timeInference + result.timePostProcess) * 1000.0);
+			if (result.isSkipped) {
+				numSkipped++;
+			} else {
+				numRegionList[result.regionType]++;
+			}
+
+			int32_t numDetected = 0;
+			for (const auto& score : result.poseKeypointScores[0]) {
+				if (score > thresholdScore) {
+					numDetected++;
+					sumScore += score;
+				}
+			}
+			numJoint += numDetected;
+			if (numDetected >= MIN_PRESENCE_JOINTS) numPresence++;
+		}
+		poseEngine.finalize();
+		if (numFrame == 0) continue;
+
+		printf("=== %s ===\n", setting.name);
+		printf("frames = %d, presence = %.1f %%, joints = %.2f / frame, score = %.3f\n", numFrame,
+			numPresence * 100.0 / numFrame, static_cast<double>(numJoint) / numFrame, (numJoint > 0) ? sumScore / numJoint : 0.0);
+		printf("region: full = %d, tile = %d, track = %d, skipped = %d\n", numRegionList[PoseEngine::REGION_FULL], numRegionList[PoseEngine::REGION_TILE], numRegionList[PoseEngine::REGION_TRACK], numSkipped);
+		printStatistics("PoseEngine", timeList);
+		printStatistics("  PersonDetector", timeDetectionList);
+		printStatistics("  pose estimation", timePoseList);
+	}
+	return 0;
+}
+
+static std::vector<bool> getPoseList(const PoseAnalyzer::RESULT& result)
+{
+	return { result.armLeftRaised, result.armRightRaised, result.armLeftSpread, result.armRightSpread, result.armLeftForward, result.armRightForward, result.crunching };
+}
+
+/* Analyze the keypoint log with the current config, and return the pose flags (armLeftRaised, ..., crunching) of each frame */
+static int32_t replayPose(const char* filename, float latency, std::vector<double>& timestampList, std::vector<std::vector<bool>>& poseListList)
+{
+	KeypointLog keypointLog;
+	if (keypointLog.open(filename, KeypointLog::MODE_READ) != KeypointLog::RET_OK) {
+		return -1;
+	}
+	PoseAnalyzer poseAnalyzer;
+	poseAnalyzer.setLatency(latency);
+
+	double timestamp;
+	std::vector<std::pair<float, float>> jointList;
+	std::vector<float> scoreList;
+	timestampList.clear();
+	poseListList.clear();
+	while (keypointLog.read(timestamp, jointList, scoreList) == KeypointLog::RET_OK) {
+		PoseAnalyzer::RESULT poseResult;
+		(void)poseAnalyzer.analyze(jointList, scoreList, timestamp, poseResult);
+		timestampList.push_back(timestamp);
+		poseListList.push_back(getPoseList(poseResult));
+	}
+	return 0;
+}
+
+/* Compare the perceived latency of pose changes with each filtering / prediction setting */
+/* The reference is the unfiltered pose in the frame. The output of a frame is regarded to reach the robot after the latency */
+/* so, delay = (timestamp of the frame where the output changes + latency) - (timestamp of the frame where the person changes the pose) */
+static int32_t runLatency(const char* filename, float latency)
+{
+	typedef struct {
+		const char* name;
+		int32_t     poseFilteringNum;
+		float       predictionGain;
+	} SETTING;
+	const std::vector<SETTING> settingList = {
+		{ "filter 6", 6, 0.0f },
+		{ "filter 6 + predict", 6, 1.0f },
+		{ "filter 3", 3, 0.0f },
+		{ "filter 3 + predict", 3, 1.0f },
+		{ "filter 2", 2, 0.0f },
+		{ "filter 2 + predict", 2, 1.0f },
+	};
+	const CONFIG baseConfig = Config::get();
+	CONFIG config = baseConfig;
+	config.predictionLatency = 0;	// the whole latency is given
+
+	/*** Reference: the pose in the current frame ***/
+	typedef struct {
+		size_t  poseIndex;
+		bool    value;
+		double  timestamp;
+	} CHANGE;
+	std::vector<double> timestampList;
+	std::vector<std::vector<bool>> poseListList;
+	config.poseFilteringNum = 1;
+	config.predictionGain = 0;
+	Config::set(config);
+	if (replayPose(filename, latency, timestampList, poseListList) != 0) {
+		Config::set(baseConfig);
+		return -1;
+	}
+	std::vector<CHANGE> referenceList;
+	for (size_t frame = 1; frame + STABLE_FRAMES <= poseListList.size(); frame++) {
+		for (size_t pose = 0; pose < poseListList[frame].size(); pose++) {
+			const bool value = poseListList[frame][pose];
+			if (value == poseListList[frame - 1][pose]) continue;
+			bool isStable = true;
+			for (size_t i = 1; i < STABLE_FRAMES; i++) {
+				if (poseListList[frame + i][pose] != value) isStable = false;
+			}
+			if (isStable) referenceList.push_back({ pose, value, timestampList[frame] });
+		}
+	}
+	printf("frames = %d, pose changes = %d, latency = %.1f [msec]\n", static_cast<int32_t>(poseListList.size()), static_cast<int32_t>(referenceList.size()), latency);
+
+	for (const auto& setting : settingList) {
+		config.poseFilteringNum = setting.poseFilteringNum;
+		config.predictionGain = setting.predictionGain;
+		Config::set(config);
+		if (replayPose(filename, latency, timestampList, poseListList) != 0) break;
+
+		std::vector<CHANGE> outputList;
+		for (size_t frame = 1; frame < poseListList.size(); frame++) {
+			for (size_t pose = 0; pose < poseListList[frame].size(); pose++) {
+				const bool value = poseListList[frame][pose];
+				if (value != poseListList[frame - 1][pose]) outputList.push_back({ pose, value, timestampList[frame] + latency });
+			}
+		}
+
+		/* match each reference change with the first output change of the same pose in the window */
+		std::vector<bool> isMatchedList(outputList.size(), false);
+		std::vector<double> delayList;
+		int32_t numMissed = 0;
+		for (const auto& reference : referenceList) {
+			bool isMatched = false;
+			for (size_t i = 0; i < outputList.size(); i++) {
+				const auto& output = outputList[i];
+				if (isMatchedList[i] || output.poseIndex != reference.poseIndex || output.value != reference.value) continue;
+				if (output.timestamp < reference.timestamp - MATCH_WINDOW_BEFORE) continue;
+				if (output.timestamp > reference.timestamp + MATCH_WINDOW_AFTER) break;
+				isMatchedList[i] = true;
+				delayList.push_back(output.timestamp - reference.timestamp);
+				isMatched = true;
+				break;
+			}
+			if (!isMatched) numMissed++;
+		}
+		const int32_t numSpurious = static_cast<int32_t>(std::count(isMatchedList.begin(), isMatchedList.end(), false));
+
+		printf("%-20s: ", setting.name);
+		if (delayList.empty()) {
+			printf("delay = -");
+		} else {
+			std::sort(delayList.begin(), delayList.end());
+			double sum = 0;
+			for (const auto& delay : delayList) sum += delay;
+			printf("delay avg = %6.1f, median = %6.1f [msec]", sum / delayList.size(), delayList[delayList.size() / 2]);
+		}
+		printf(", missed = %d, spurious = %d\n", numMissed, numSpurious);
+	}
+
+	Config::set(baseConfig);
+	return 0;
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+	if (argc < 2) {
+		printf("usage: %s keypoint_log_file [repeat_num]\n", argv[0]);
+		printf("       %s -v video_or_image_file [frame_num]\n", argv[0]);
+		printf("       %s -l keypoint_log_file [latency_msec]\n", argv[0]);
+		return -1;
+	}
+	if (strcmp(argv[1], "-l") == 0) {
+		if (argc < 3) {
+			printf("usage: %s -l keypoint_log_file [latency_msec]\n", argv[0]);
+			return -1;
+		}
+		return runLatency(argv[2], (argc > 3) ? static_cast<float>(atof(argv[3])) : 150.0f);
+	}
+	if (strcmp(argv[1], "-v") == 0) {
+		if (argc < 3) {
+			printf("usage: %s -v video_or_image_file [frame_num]\n", argv[0]);
+			return -1;
+		}
+		return runVideo(argv[2], (argc > 3) ? atoi(argv[3]) : 300);
+	}
+	const int32_t repeatNum = (argc > 2) ? atoi(argv[2]) : 1;
+
+	std::vector<double> timeAnalyzeList;
+	std::vector<double> timeGestureList;
+	std::vector<double> timeDecideList;
+	int32_t numFrame = 0;
+	int32_t numCommand = 0;
+
+	for (int32_t repeat = 0; repeat < repeatNum; repeat++) {
+		KeypointLog keypointLog;
+		if (keypointLog.open(argv[1], KeypointLog::MODE_READ) != KeypointLog::RET_OK) {
+			return -1;
+		}
+		PoseAnalyzer poseAnalyzer;
+		GestureRecognizer gestureRecognizer;
+		CommandDecider commandDecider;
+		int32_t previousGesture = GestureRecognizer::GESTURE_NONE;
+
+		double timestamp;
+		std::vector<std::pair<float, float>> jointList;
+		std::vector<float> scoreList;
+		while (keypointLog.read(timestamp, jointList, scoreList) == KeypointLog::RET_OK) {
+			const auto& t0 = std::chrono::steady_clock::now();
+			PoseAnalyzer::RESULT poseResult;
+			(void)poseAnalyzer.analyze(jointList, scoreList, timestamp, poseResult);
+			const auto& t1 = std::chrono::steady_clock::now();
+			GestureRecognizer::RESULT gestureResult;
+			(void)gestureRecognizer.update(jointList, scoreList, gestureResult);
+			const auto& t2 = std::chrono::steady_clock::now();
+			std::string command = commandDecider.decide(poseResult, gestureResult);
+			const auto& t3 = std::chrono::steady_clock::now();
+
+			timeAnalyzeList.push_back(getElapsedUsec(t0, t1));
+			timeGestureList.push_back(getElapsedUsec(t1, t2));
+			timeDecideList.push_back(getElapsedUsec(t2, t3));
+			numFrame++;
+			if (!command.empty()) numCommand++;
+
+			if (repeat == 0 && gestureResult.gesture != previousGesture) {
+				printf("[%10.1f] gesture = %s\n", timestamp, GestureRecognizer::getName(gestureResult.gesture));
+			}
+			previousGesture = gestureResult.gesture;
+		}
+		if (repeat == 0) commandDecider.printStopStatistics();
+	}
+
+	printf("frames = %d, commands = %d\n", numFrame, numCommand);
+	printStatistics("PoseAnalyzer", timeAnalyzeList);
+	printStatistics("GestureRecognizer", timeGestureList);
+	printStatistics("CommandDecider", timeDecideList);
+
+	return 0;
+}
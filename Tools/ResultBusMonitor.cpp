@@ -0,0 +1,111 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "ResultBus.h"
+#include "GestureRecognizer.h"
+
+/*** Macro ***/
+#define REPORT_INTERVAL 100	// [frame]
+
+/*** Function ***/
+/* Example of a consumer of the result bus. Run it while ./main -b is running */
+int32_t main(int32_t argc, char* argv[])
+{
+	std::string name = ResultBus::DEFAULT_NAME;
+	bool readAll = false;
+	bool showImage = false;
+	for (int32_t i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			name = argv[++i];
+		} else if (strcmp(argv[i], "-a") == 0) {
+			readAll = true;
+		} else if (strcmp(argv[i], "-i") == 0) {
+			showImage = true;
+		} else {
+			printf("usage: %s [-n name] [-a] [-i]\n", argv[0]);
+			printf("  -a : read every frame (default: only the latest frame)\n");
+			printf("  -i : show the published image\n");
+			return -1;
+		}
+	}
+
+	ResultBus resultBus;
+	while (resultBus.open(name, ResultBus::MODE_READ) != ResultBus::RET_OK) {
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	int32_t numFrame = 0;
+	int32_t numOverrun = 0;
+	double sumLatency = 0;
+	uint32_t lastFrameId = 0;
+	int32_t numSkipped = 0;
+	std::vector<uint8_t> image;
+	while (1) {
+		ResultBus::FRAME frame;
+		int32_t ret = readAll ? resultBus.readNext(frame, showImage ? &image : nullptr) : resultBus.readLatest(frame, showImage ? &image : nullptr);
+		if (ret == ResultBus::RET_NO_DATA) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		} else if (ret == ResultBus::RET_OVERRUN) {
+			numOverrun++;
+			continue;
+		} else if (ret != ResultBus::RET_OK) {
+			break;
+		}
+
+		/* both processes use steady clock (CLOCK_MONOTONIC), so the timestamp can be compared */
+		const double now = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now().time_since_epoch()).count() * 1000.0;
+		sumLatency += now - frame.timestamp;
+		if (numFrame > 0) numSkipped += frame.frameId - lastFrameId - 1;
+		lastFrameId = frame.frameId;
+		numFrame++;
+
+		if (frame.command[0] != '\0') {
+			printf("[%u] command = %s, x = %.2f, distance = %.2f, gesture = %s\n", frame.frameId, frame.command,
+				frame.poseResult.x, frame.poseResult.distance, GestureRecognizer::getName(frame.gesture));
+		}
+		if (numFrame % REPORT_INTERVAL == 0) {
+			printf("frames = %d, skipped = %d, overrun = %d, latency = %.2f [msec]\n", numFrame, numSkipped, numOverrun, sumLatency / REPORT_INTERVAL);
+			sumLatency = 0;
+		}
+
+		if (showImage && !image.empty()) {
+			cv::Mat mat(frame.imageHeight, frame.imageWidth, CV_8UC3, image.data());
+			for (int32_t i = 0; i < ResultBus::NUM_JOINTS; i++) {
+				if (frame.jointScore[i] < 0.2f) continue;
+				cv::circle(mat, cv::Point(static_cast<int32_t>(frame.jointX[i] * mat.cols), static_cast<int32_t>(frame.jointY[i] * mat.rows)), 2, cv::Scalar(0, 255, 0), -1);
+			}
+			cv::imshow("ResultBusMonitor", mat);
+			if (cv::waitKey(1) == 'q') break;
+		}
+	}
+
+	resultBus.close();
+	return 0;
+}
@@ -0,0 +1,147 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "RobotModel.h"
+
+/*** Macro ***/
+
+typedef struct {
+	const char* skill;
+	double v;	// [m/s]
+	double w;	// [rad/s]
+} SKILL_VELOCITY;
+
+static const std::vector<SKILL_VELOCITY> SKILL_VELOCITY_LIST = {
+	{ "kbalance", 0, 0 },
+	{ "ksit",     0, 0 },
+	{ "khi",      0, 0 },
+	{ "krest",    0, 0 },
+	{ "kstr",     0, 0 },
+	{ "kpu",      0, 0 },
+	{ "kcrF",  0.06,  0.0 },
+	{ "kcrL",  0.05,  0.4 },
+	{ "kcrR",  0.05, -0.4 },
+	{ "kwkF",  0.12,  0.0 },
+	{ "kwkL",  0.10,  0.6 },
+	{ "kwkR",  0.10, -0.6 },
+	{ "ktrF",  0.20,  0.0 },
+	{ "ktrL",  0.16,  0.7 },
+	{ "ktrR",  0.16, -0.7 },
+	{ "kbk",  -0.06,  0.0 },
+	{ "kbkL", -0.05, -0.3 },
+	{ "kbkR", -0.05,  0.3 },
+};
+
+/*** Function ***/
+RobotModel::RobotModel(double transitionTime, double gaitChangeTime)
+	: m_transitionTime(transitionTime)
+	, m_gaitChangeTime((gaitChangeTime < 0) ? transitionTime : gaitChangeTime)
+{
+	reset();
+}
+
+void RobotModel::reset(double timestamp)
+{
+	m_state = STATE();
+	m_metrics = METRICS();
+	m_skill = "kbalance";
+	m_targetV = 0;
+	m_targetW = 0;
+	m_transitionEndTime = timestamp;
+	m_lastTime = timestamp;
+}
+
+bool RobotModel::getSkillVelocity(const std::string& skill, double& v, double& w)
+{
+	for (const auto& s : SKILL_VELOCITY_LIST) {
+		if (skill == s.skill) {
+			v = s.v;
+			w = s.w;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool RobotModel::isSameGait(const std::string& skill0, const std::string& skill1)
+{
+	/* e.g. kwkF and kwkL. kbk and kbkL */
+	double v0, w0, v1, w1;
+	if (!getSkillVelocity(skill0, v0, w0) || !getSkillVelocity(skill1, v1, w1)) return false;
+	if (v0 == 0 || v1 == 0) return false;
+	return skill0.compare(0, 3, skill1, 0, 3) == 0;
+}
+
+bool RobotModel::setCommand(const std::string& command, double timestamp)
+{
+	update(timestamp);
+	m_metrics.numCommand++;
+
+	double v, w;
+	if (!getSkillVelocity(command, v, w)) {
+		return false;
+	}
+	if (command != m_skill) {
+		m_metrics.numSkillChange++;
+		const double transitionTime = isSameGait(m_skill, command) ? m_gaitChangeTime : m_transitionTime;
+		m_skill = command;
+		m_targetV = v;
+		m_targetW = w;
+		/* the robot stops while changing the posture */
+		m_state.v = 0;
+		m_state.w = 0;
+		m_transitionEndTime = timestamp + transitionTime;
+	}
+	return true;
+}
+
+void RobotModel::update(double timestamp)
+{
+	if (timestamp <= m_lastTime) return;
+
+	/* split the period at the end of transition */
+	if (m_lastTime < m_transitionEndTime) {
+		double t = (std::min)(timestamp, m_transitionEndTime);
+		m_metrics.timeTransition += t - m_lastTime;
+		m_lastTime = t;
+		if (timestamp < m_transitionEndTime) return;
+		m_state.v = m_targetV;
+		m_state.w = m_targetW;
+	}
+
+	const double dt = (timestamp - m_lastTime) / 1000.0;
+	if (std::abs(m_state.w) < 1e-6) {
+		m_state.x += m_state.v * dt * std::cos(m_state.theta);
+		m_state.y += m_state.v * dt * std::sin(m_state.theta);
+	} else {
+		/* move on an arc */
+		const double theta1 = m_state.theta + m_state.w * dt;
+		const double r = m_state.v / m_state.w;
+		m_state.x += r * (std::sin(theta1) - std::sin(m_state.theta));
+		m_state.y -= r * (std::cos(theta1) - std::cos(m_state.theta));
+		m_state.theta = theta1;
+	}
+	m_metrics.distance += std::abs(m_state.v) * dt;
+	m_lastTime = timestamp;
+}
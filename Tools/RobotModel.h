@@ -0,0 +1,71 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef ROBOT_MODEL_
+#define ROBOT_MODEL_
+
+/* for general */
+#include <cstdint>
+#include <string>
+
+/* Simple kinematic model of Bittle driven by OpenCat skill commands (e.g. "kwkF") */
+/* note: velocities are rough values measured by eye. the robot stands still while it changes the skill */
+/* note: changing direction in the same gait (e.g. kwkF -> kwkL) takes gaitChangeTime instead of transitionTime */
+class RobotModel {
+public:
+	typedef struct STATE_ {
+		double x;		// [m]
+		double y;		// [m]
+		double theta;	// [rad] 0 = x axis, counterclockwise
+		double v;		// [m/s]
+		double w;		// [rad/s]
+		STATE_() : x(0), y(0), theta(0), v(0), w(0) {}
+	} STATE;
+
+	typedef struct METRICS_ {
+		int32_t numCommand;			// the number of received commands
+		int32_t numSkillChange;		// the number of commands which changed the skill
+		double  timeTransition;		// [msec] total time spent to change the skill
+		double  distance;			// [m] total distance moved
+		METRICS_() : numCommand(0), numSkillChange(0), timeTransition(0), distance(0) {}
+	} METRICS;
+
+public:
+	RobotModel(double transitionTime = 300, double gaitChangeTime = -1);	// gaitChangeTime < 0: same as transitionTime
+	~RobotModel() {}
+	void   reset(double timestamp = 0);
+	bool   setCommand(const std::string& command, double timestamp);	// return false if the command is unknown
+	void   update(double timestamp);
+	const  STATE& getState() const { return m_state; }
+	const  METRICS& getMetrics() const { return m_metrics; }
+	const  std::string& getSkill() const { return m_skill; }
+	bool   isInTransition(double timestamp) const { return timestamp < m_transitionEndTime; }
+	double getTransitionEndTime() const { return m_transitionEndTime; }	// [msec] the robot starts moving with the current skill
+	static bool getSkillVelocity(const std::string& skill, double& v, double& w);
+	static bool isSameGait(const std::string& skill0, const std::string& skill1);
+
+private:
+	const double m_transitionTime;	// [msec]
+	const double m_gaitChangeTime;	// [msec]
+	STATE   m_state;
+	METRICS m_metrics;
+	std::string m_skill;
+	double  m_targetV;
+	double  m_targetW;
+	double  m_transitionEndTime;	// [msec]
+	double  m_lastTime;				// [msec]
+};
+
+#endif
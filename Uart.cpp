@@ -26,6 +26,7 @@ limitations under the License.
 #include <sys/stat.h>
 #include <fcntl.h> 
 #include <termios.h>
+#include <poll.h>
 #include <iostream>
 #endif
 
@@ -92,7 +93,8 @@ void Uart::finalize()
 #ifdef _WIN32
 	return;
 #else
-	close(fd);
+	if (fd >= 0) close(fd);
+	fd = -1;
 #endif
 }
 
@@ -115,3 +117,15 @@ int32_t Uart::recv(char* buffer, int32_t len)
 #endif
 }
 
+int32_t Uart::recv(char* buffer, int32_t len, int32_t timeoutMsec)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	/* note: poll just waits for the timeout if the device is not opened (fd < 0) */
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	int32_t ret = poll(&pfd, 1, timeoutMsec);
+	if (ret <= 0 || !(pfd.revents & POLLIN)) return ret < 0 ? -1 : 0;
+	return read(fd, buffer, len);
+#endif
+}
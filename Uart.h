@@ -23,12 +23,13 @@ limitations under the License.
 class Uart
 {
 public:
-	Uart() {}
+	Uart() : fd(-1) {}
 	~Uart() {}
 	int32_t initialize(const char* device);
 	void finalize();
 	int32_t send(const char* buffer);
 	int32_t recv(char* buffer, int32_t len);
+	int32_t recv(char* buffer, int32_t len, int32_t timeoutMsec);	// returns 0 if no data within the timeout
 
 private:
 	int32_t fd;